@@ -1,10 +1,27 @@
 #include <asset_loader.h>
+#include <asset_archive.h>
 #include <texture_asset.h>
 #include <mesh_asset.h>
+#include <job_system.h>
+#include <texture_mips.h>
+#include <texture_compressor.h>
+#include <meshlet_builder.h>
+#include <mesh_optimizer.h>
+#include <mesh_simplifier.h>
+#include <bake_manifest.h>
+#include <geometry_bench.h>
+#include <geometry.h>
 
 #include <iostream>
 #include <fstream>
 #include <filesystem>
+#include <algorithm>
+#include <sstream>
+#include <unordered_set>
+#include <cmath>
+#include <cstdlib>
+
+#include <json.hpp>
 
 #include <glm/glm.hpp>
 #include<glm/gtx/transform.hpp>
@@ -20,6 +37,233 @@
 namespace fs = std::filesystem;
 
 #define OUTDIR "assets_export"
+#define ARCHIVE_NAME "assets.pak"
+#define MANIFEST_NAME "bake_manifest.json"
+
+//in degrees, faces meeting at a sharper angle get separate normals
+constexpr float NormalCreaseAngle = 60.f;
+
+struct BakerOptions
+{
+	//threads used for the files, meshes and texture blocks, 0 uses every hardware thread
+	uint32_t threadCount = 0;
+
+	//rebakes every source even when the manifest says it is up to date
+	bool force = false;
+
+	assets::CompressionMode meshCompression = assets::CompressionMode::LZ4;
+	assets::CompressionMode textureCompression = assets::CompressionMode::LZ4;
+
+	assets::VertexFormat vertexFormat = assets::VertexFormat::P32N8C8V16;
+
+	//how the per corner vertices are merged back after the normals are regenerated
+	WeldMode weldMode = WeldMode::Exact;
+	float weldEpsilon = 1e-5f;
+
+	//index and vertex reordering passes, run in this order before the meshlets are built
+	bool optimizeVertexCache = false;
+	bool optimizeOverdraw = false;
+	bool optimizeVertexFetch = false;
+
+	//number of levels of detail including the full mesh, each one keeps lodRatio of the triangles of the previous
+	uint32_t lodCount = 1;
+	float lodRatio = 0.5f;
+
+	//splits the meshes into meshlets for per cluster culling
+	bool meshlets = false;
+	MeshletSettings meshletSettings;
+
+	MipFilter mipFilter = MipFilter::Box;
+
+	//RGBA8 keeps the textures uncompressed on the gpu
+	assets::TextureFormat textureFormat = assets::TextureFormat::BC7;
+	BlockQuality blockQuality = BlockQuality::Normal;
+
+	//keeps the json metadata at the end of each asset for debugging, the loaders never read it
+	bool jsonSidecar = false;
+
+	//packs every baked file into a single archive next to the loose files
+	bool archive = false;
+	//optional list of asset names, one per line, that go first in the archive in that order
+	fs::path archiveOrder;
+};
+
+void print_usage()
+{
+	std::cout << "usage: Asset-Baker <asset directory> [options]" << std::endl;
+	std::cout << "       Asset-Baker --bench <mesh file>  time the geometry kernels at every simd level" << std::endl;
+	std::cout << "  -j <n>                         bake with n threads, every hardware thread by default" << std::endl;
+	std::cout << "  --force                        rebake every source, even the unchanged ones" << std::endl;
+	std::cout << "  --compression none|lz4|lz4hc   compression for every asset" << std::endl;
+	std::cout << "  --mesh-compression mode        compression for meshes" << std::endl;
+	std::cout << "  --texture-compression mode     compression for textures" << std::endl;
+	std::cout << "  --vertex-format packed|f32     packed P32N8C8V16 (default) or full precision vertices" << std::endl;
+	std::cout << "  --weld exact|epsilon           vertex welding, bit exact (default) or on a grid of --weld-epsilon" << std::endl;
+	std::cout << "  --weld-epsilon <e>             grid size for epsilon welding, 1e-5 by default, implies --weld epsilon" << std::endl;
+	std::cout << "  --optimize                     run every mesh optimization below" << std::endl;
+	std::cout << "  --optimize-cache               reorder triangles for the post transform vertex cache" << std::endl;
+	std::cout << "  --optimize-overdraw            sort triangle clusters to reduce overdraw, implies --optimize-cache" << std::endl;
+	std::cout << "  --optimize-fetch               reorder vertices in the order the indices use them" << std::endl;
+	std::cout << "  --lods <n>                     levels of detail per mesh including the full one, up to " << assets::MaxMeshLods << std::endl;
+	std::cout << "  --lod-ratio <r>                triangle ratio between two levels of detail, 0.5 by default" << std::endl;
+	std::cout << "  --meshlets                     store meshlets in the meshes" << std::endl;
+	std::cout << "  --meshlet-vertices <n>         maximum vertices per meshlet, 64 by default, up to " << MaxMeshletVertices << std::endl;
+	std::cout << "  --meshlet-triangles <n>        maximum triangles per meshlet, 124 by default, up to " << MaxMeshletTriangles << std::endl;
+	std::cout << "  --mip-filter none|box|tent     filter used to build the texture mip chain" << std::endl;
+	std::cout << "  --texture-format rgba8|bc1|bc3|bc7  gpu format of the textures, bc7 by default" << std::endl;
+	std::cout << "  --bc-quality fast|normal|high  block compression quality" << std::endl;
+	std::cout << "  a <texture>.png.json file next to a texture overrides format, quality and mip_filter for it" << std::endl;
+	std::cout << "  --json-sidecar                 keep the json metadata in the assets" << std::endl;
+	std::cout << "  --archive                      pack the baked assets into " << ARCHIVE_NAME << std::endl;
+	std::cout << "  --archive-order <file>         asset names in load order for the archive" << std::endl;
+}
+
+bool parse_compression_option(const char* value, assets::CompressionMode& outMode)
+{
+	std::string mode{ value };
+	for (auto& c : mode)
+		c = toupper(c);
+
+	if (mode != "NONE" && mode != "LZ4" && mode != "LZ4HC")
+	{
+		std::cout << "unknown compression mode " << value << ", use none, lz4 or lz4hc" << std::endl;
+		return false;
+	}
+
+	outMode = assets::parse_compression(mode.c_str());
+	return true;
+}
+
+bool parse_thread_count_option(const char* value, uint32_t& outCount)
+{
+	//only digits, 0 keeps every hardware thread
+	std::string count{ value };
+	if (count.empty() || count.size() > 4 || !std::all_of(count.begin(), count.end(), [](char c) { return c >= '0' && c <= '9'; }))
+	{
+		std::cout << "thread count " << value << " has to be a number" << std::endl;
+		return false;
+	}
+
+	outCount = uint32_t(std::stoul(count));
+	return true;
+}
+
+bool parse_count_option(const char* name, const char* value, uint32_t min, uint32_t max, uint32_t& outCount)
+{
+	std::string count{ value };
+	if (count.empty() || count.size() > 9 || !std::all_of(count.begin(), count.end(), [](char c) { return c >= '0' && c <= '9'; }))
+	{
+		std::cout << name << " " << value << " has to be a number" << std::endl;
+		return false;
+	}
+
+	uint32_t parsed = uint32_t(std::stoul(count));
+	if (parsed < min || parsed > max)
+	{
+		std::cout << name << " has to be between " << min << " and " << max << std::endl;
+		return false;
+	}
+
+	outCount = parsed;
+	return true;
+}
+
+//the whole value has to be a finite number, strtof alone stops at the first character it can not read
+bool parse_float_option(const char* name, const char* value, float& outValue)
+{
+	char* end = nullptr;
+	float parsed = std::strtof(value, &end);
+	if (end == value || *end != '\0' || !std::isfinite(parsed))
+	{
+		std::cout << name << " " << value << " has to be a number" << std::endl;
+		return false;
+	}
+
+	outValue = parsed;
+	return true;
+}
+
+bool parse_texture_format_option(const char* value, assets::TextureFormat& outFormat, std::ostream& log)
+{
+	std::string format{ value };
+	for (auto& c : format)
+		c = char(toupper(c));
+
+	assets::TextureFormat parsed = assets::parse_format(format.c_str());
+	if (parsed == assets::TextureFormat::Unknown)
+	{
+		log << "unknown texture format " << value << ", use rgba8, bc1, bc3 or bc7" << std::endl;
+		return false;
+	}
+
+	outFormat = parsed;
+	return true;
+}
+
+bool parse_mip_filter_option(const char* value, MipFilter& outFilter, std::ostream& log)
+{
+	std::string filter{ value };
+	if (filter == "none")
+		outFilter = MipFilter::None;
+	else if (filter == "box")
+		outFilter = MipFilter::Box;
+	else if (filter == "tent")
+		outFilter = MipFilter::Tent;
+	else
+	{
+		log << "unknown mip filter " << filter << ", use none, box or tent" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+//per texture overrides read from a json file next to the source image
+BakerOptions read_texture_settings(const fs::path& input, const BakerOptions& options, std::ostream& log)
+{
+	BakerOptions textureOptions = options;
+
+	fs::path settingsPath = input;
+	settingsPath += ".json";
+
+	std::ifstream settingsFile{ settingsPath };
+	if (!settingsFile.is_open())
+		return textureOptions;
+
+	nlohmann::json settings = nlohmann::json::parse(settingsFile, nullptr, false);
+	if (settings.is_discarded())
+	{
+		log << "Invalid texture settings " << settingsPath << std::endl;
+		return textureOptions;
+	}
+
+	//a bad value keeps the option the texture would have had without the file
+	if (settings.contains("format"))
+	{
+		const nlohmann::json& format = settings["format"];
+		if (!format.is_string())
+			log << "format in " << settingsPath << " has to be a string" << std::endl;
+		else
+			parse_texture_format_option(format.get<std::string>().c_str(), textureOptions.textureFormat, log);
+	}
+
+	if (settings.contains("quality"))
+	{
+		const nlohmann::json& quality = settings["quality"];
+		if (!quality.is_string() || !parse_block_quality(quality.get<std::string>().c_str(), textureOptions.blockQuality))
+			log << "unknown quality in " << settingsPath << ", use fast, normal or high" << std::endl;
+	}
+
+	if (settings.contains("mip_filter"))
+	{
+		const nlohmann::json& filter = settings["mip_filter"];
+		if (!filter.is_string())
+			log << "mip_filter in " << settingsPath << " has to be a string" << std::endl;
+		else
+			parse_mip_filter_option(filter.get<std::string>().c_str(), textureOptions.mipFilter, log);
+	}
+
+	return textureOptions;
+}
 
 std::string calculate_assimp_mesh_name(const aiScene* scene, int meshIndex)
 {
@@ -30,157 +274,498 @@ std::string calculate_assimp_mesh_name(const aiScene* scene, int meshIndex)
 	return matname;
 }
 
-bool convert_image(const fs::path& input, const fs::path& output)
+bool convert_image(const fs::path& input, const fs::path& output, const BakerOptions& bakerOptions, assets::JobSystem& jobs, std::ostream& log, std::vector<fs::path>& outputs)
 {
+	BakerOptions options = read_texture_settings(input, bakerOptions, log);
+
 	int texWidth, texHeight, texChannels;
 
 	stbi_uc* pixels = stbi_load(input.u8string().c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
 
 	if (!pixels)
   {
-		std::cout << "Failed to load texture file " << input << std::endl;
+		log << "Failed to load texture file " << input << std::endl;
 		return false;
 	}
 
-	int texture_size = texWidth * texHeight * 4;
-
-	assets::TextureInfo texinfo;
-	texinfo.textureSize = texture_size;
+	assets::TextureInfo texinfo = {};
 	texinfo.pixelsize[0] = texWidth;
 	texinfo.pixelsize[1] = texHeight;
 	texinfo.textureFormat = assets::TextureFormat::RGBA8;
+	texinfo.compressionMode = options.textureCompression;
 	texinfo.originalFile = input.string();
-	assets::AssetFile newImage = assets::pack_texture(&texinfo, pixels);
+
+	//color textures are sampled as srgb, so the chain is filtered in linear space
+	std::vector<uint8_t> levels;
+	generate_mips(pixels, texWidth, texHeight, options.mipFilter, true, levels, texinfo);
 
 	stbi_image_free(pixels);
 
-	save_binaryfile(output.string().c_str(), newImage);
+	if (assets::is_block_compressed(options.textureFormat))
+	{
+		BlockCompressionSettings settings;
+		settings.format = options.textureFormat;
+		settings.quality = options.blockQuality;
+		settings.jobs = &jobs;
+
+		compress_texture_levels(levels, texinfo, settings);
+	}
+
+	assets::AssetFile newImage = assets::pack_texture(&texinfo, levels.data());
+	if (!options.jsonSidecar)
+		newImage.json.clear();
+
+	if (!save_binaryfile(output.string().c_str(), newImage))
+		return false;
+
+	outputs.push_back(output);
 
 	return true;
 }
 
-void extract_assimp_meshes(const aiScene* scene, const fs::path& input, const fs::path& outputFolder)
+//cache and overdraw passes over the triangles of one level of detail
+void optimize_lod_indices(const std::vector<assets::Vertex_f32_PNCV>& vertices, uint32_t* indices, size_t indexCount, const BakerOptions& options)
 {
-	if(!scene)
-	{
-		std::cout << "invalid file for assimp"<< std::endl;
+	if (!options.optimizeVertexCache && !options.optimizeOverdraw)
 		return;
+
+	std::vector<uint32_t> clusters;
+	optimize_vertex_cache(indices, indexCount, vertices.size(), &clusters);
+
+	if (options.optimizeOverdraw)
+		optimize_overdraw(indices, indexCount, vertices.data(), vertices.size(), clusters);
+}
+
+//appends the simplified levels after the full mesh, they all index the same vertices
+void build_lods(const std::vector<assets::Vertex_f32_PNCV>& vertices, std::vector<uint32_t>& indices, const BakerOptions& options, assets::MeshInfo& info)
+{
+	size_t baseIndexCount = indices.size();
+	float targetRatio = 1.f;
+	float error = 0.f;
+
+	SimplifySettings settings;
+
+	for (uint32_t lod = 1; lod < options.lodCount; lod++)
+	{
+		targetRatio *= options.lodRatio;
+		size_t targetIndexCount = size_t(baseIndexCount / 3 * targetRatio) * 3;
+
+		//always simplify from the full mesh so the error does not pile up over the chain
+		std::vector<uint32_t> simplified;
+		float lodError = simplify_mesh(vertices.data(), vertices.size(), indices.data(), baseIndexCount, targetIndexCount, settings, simplified);
+
+		//stop once the simplifier can not make meaningful progress
+		const assets::MeshLod& previous = info.lods[info.lodCount - 1];
+		if (simplified.empty() || simplified.size() > previous.indexCount * 9 / 10)
+			break;
+
+		optimize_lod_indices(vertices, simplified.data(), simplified.size(), options);
+
+		error = std::max(error, lodError);
+
+		assets::MeshLod& newLod = info.lods[info.lodCount++];
+		newLod.indexOffset = uint32_t(indices.size());
+		newLod.indexCount = uint32_t(simplified.size());
+		newLod.error = error;
+
+		indices.insert(indices.end(), simplified.begin(), simplified.end());
+	}
+}
+
+void optimize_mesh(std::vector<assets::Vertex_f32_PNCV>& vertices, std::vector<uint32_t>& indices, const std::string& name, const BakerOptions& options, std::ostream& log, assets::MeshInfo& info)
+{
+	VertexCacheStats before = analyze_vertex_cache(indices.data(), indices.size(), vertices.size());
+
+	optimize_lod_indices(vertices, indices.data(), indices.size(), options);
+
+	info.lodCount = 1;
+	info.lods[0].indexOffset = 0;
+	info.lods[0].indexCount = uint32_t(indices.size());
+	info.lods[0].error = 0.f;
+
+	if (options.lodCount > 1)
+		build_lods(vertices, indices, options, info);
+
+	//after the lods so the vertices follow the full mesh first, the simplified levels only use a subset of them
+	if (options.optimizeVertexFetch)
+		optimize_vertex_fetch(vertices, indices);
+
+	char line[256];
+	if (options.optimizeVertexCache || options.optimizeOverdraw || options.optimizeVertexFetch)
+	{
+		VertexCacheStats after = analyze_vertex_cache(indices.data(), info.lods[0].indexCount, vertices.size());
+		snprintf(line, sizeof(line), "%s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", name.c_str(), before.acmr, after.acmr, before.atvr, after.atvr);
+		log << line;
+	}
+
+	for (uint32_t i = 1; i < info.lodCount; i++)
+	{
+		snprintf(line, sizeof(line), "%s: lod %u has %u triangles, error %f\n", name.c_str(), i, info.lods[i].indexCount / 3, info.lods[i].error);
+		log << line;
 	}
 
+	//curved meshes always have room to simplify, a short chain on one of them means collapses were refused
+	if (info.lodCount < options.lodCount && info.lods[info.lodCount - 1].indexCount >= 3 * 64)
+	{
+		snprintf(line, sizeof(line), "%s: warning, only %u of %u lods, the simplifier stopped at %u triangles\n", name.c_str(),
+			info.lodCount, options.lodCount, info.lods[info.lodCount - 1].indexCount / 3);
+		log << line;
+	}
+}
+
+bool extract_assimp_mesh(const aiScene* scene, size_t meshindex, const fs::path& input, const fs::path& outputFolder, const BakerOptions& options, std::ostream& log, fs::path& outputPath)
+{
+	//meshes are processed at full precision and quantized right before packing
 	using VertexFormat = assets::Vertex_f32_PNCV;
-	auto VertexFormatEnum = assets::VertexFormat::PNCV_F32;
+	auto VertexFormatEnum = options.vertexFormat;
 
-	for (size_t meshindex = 0; meshindex < scene->mNumMeshes; meshindex++)
+	const aiMesh* mesh = scene->mMeshes[meshindex];
+
+	std::vector<VertexFormat> _vertices;
+	std::vector<uint32_t> _indices;
+
+	_vertices.resize(mesh->mNumVertices);
+	for (size_t v = 0; v < mesh->mNumVertices; v++)
 	{
-		const aiMesh* mesh = scene->mMeshes[meshindex];
+		VertexFormat vert;
+
+		vert.position[0] = mesh->mVertices[v][0];
+		vert.position[1] = mesh->mVertices[v][1];
+		vert.position[2] = mesh->mVertices[v][2];
+		vert.position[3] = 0;
 
-		std::vector<VertexFormat> _vertices;
-		std::vector<uint32_t> _indices;
+		//assimp fbx creates bad normals, they are regenerated below. left empty so they do not keep the
+		//welding from sharing the vertices that only differ by them
+		vert.normal[0] = 0;
+		vert.normal[1] = 0;
+		vert.normal[2] = 0;
+		vert.normal[3] = 0;
 
-		_vertices.resize(mesh->mNumVertices);
-		for (size_t v = 0; v < mesh->mNumVertices; v++)
+		if (mesh->GetNumUVChannels() >= 1)
+		{
+			vert.uv[0] = mesh->mTextureCoords[0][v].x;
+			vert.uv[1] = mesh->mTextureCoords[0][v].y;
+			vert.uv[2] = 0;
+			vert.uv[3] = 0;
+		}
+		else
 		{
-			VertexFormat vert;
+			vert.uv[0] = 0;
+			vert.uv[1] = 0;
+			vert.uv[2] = 0;
+			vert.uv[3] = 0;
+		}
 
-			vert.position[0] = mesh->mVertices[v][0];
-			vert.position[1] = mesh->mVertices[v][1];
-			vert.position[2] = mesh->mVertices[v][2];
-			vert.position[3] = 0;
+		if (mesh->HasVertexColors(0))
+		{
+			vert.color[0] = mesh->mColors[0][v].r;
+			vert.color[1] = mesh->mColors[0][v].g;
+			vert.color[2] = mesh->mColors[0][v].b;
+			vert.color[3] = 0;
+		}
+		else
+		{
+			vert.color[0] = 1;
+			vert.color[1] = 1;
+			vert.color[2] = 1;
+			vert.color[3] = 0;
+		}
 
-			vert.normal[0] = mesh->mNormals[v].x;
-			vert.normal[1] = mesh->mNormals[v].y;
-			vert.normal[2] = mesh->mNormals[v].z;
-			vert.normal[3] = 0;
+		_vertices[v] = vert;
+	}
 
-			if (mesh->GetNumUVChannels() >= 1)
-			{
-				vert.uv[0] = mesh->mTextureCoords[0][v].x;
-				vert.uv[1] = mesh->mTextureCoords[0][v].y;
-				vert.uv[2] = 0;
-				vert.uv[3] = 0;
-			}
-			else
-			{
-				vert.uv[0] = 0;
-				vert.uv[1] = 0;
-				vert.uv[2] = 0;
-				vert.uv[3] = 0;
-			}
+	_indices.resize(mesh->mNumFaces * 3);
+	for (size_t f = 0; f < mesh->mNumFaces; f++)
+	{
+		_indices[f * 3 + 0] = mesh->mFaces[f].mIndices[0];
+		_indices[f * 3 + 1] = mesh->mFaces[f].mIndices[1];
+		_indices[f * 3 + 2] = mesh->mFaces[f].mIndices[2];
+	}
 
-			if (mesh->HasVertexColors(0))
-			{
-				vert.color[0] = mesh->mColors[0][v].r;
-				vert.color[1] = mesh->mColors[0][v].g;
-				vert.color[2] = mesh->mColors[0][v].b;
-				vert.color[3] = 0;
-			}
-			else
-			{
-				vert.color[0] = 1;
-				vert.color[1] = 1;
-				vert.color[2] = 1;
-				vert.color[3] = 0;
-			}
+	std::string meshname = calculate_assimp_mesh_name(scene, meshindex);
+
+	size_t importedCount = _vertices.size();
+	weld_vertices(_vertices, _indices, options.weldMode, options.weldEpsilon);
+	size_t weldedCount = _vertices.size();
 
-			_vertices[v] = vert;
-			printf("vert: %f %f %f %f\n", vert.position[0], vert.position[1], vert.position[2], vert.position[3]);
+	//smooth across curved surfaces, hard edges like the ones of a box keep a normal per side
+	if (!_indices.empty())
+		generate_crease_normals(_vertices, _indices, glm::radians(NormalCreaseAngle));
+
+	log << meshname << ": welded " << importedCount << " vertices into " << weldedCount << ", " << _vertices.size() << " with creases split" << std::endl;
+
+	assets::MeshInfo info;
+	optimize_mesh(_vertices, _indices, meshname, options, log, info);
+
+	//16 bit indices whenever they can address every vertex, the meshlets below follow the same size
+	info.indexSize = assets::index_size_for(_vertices.size());
+
+	std::vector<assets::Vertex_P32N8C8V16> _packedVertices;
+	char* vertexData = (char*)_vertices.data();
+	size_t vertexSize = sizeof(VertexFormat);
+
+	if (VertexFormatEnum == assets::VertexFormat::P32N8C8V16)
+	{
+		_packedVertices.resize(_vertices.size());
+		assets::pack_vertices(_vertices.data(), _vertices.size(), _packedVertices.data());
+
+		vertexData = (char*)_packedVertices.data();
+		vertexSize = sizeof(assets::Vertex_P32N8C8V16);
+	}
+
+	info.vertexBuferSize = _vertices.size() * vertexSize;
+	info.vertexCount = _vertices.size();
+	info.faceCount = mesh->mNumFaces;
+
+	std::vector<uint16_t> _shortIndices;
+	char* indexData = (char*)_indices.data();
+	if (info.indexSize == 2)
+	{
+		_shortIndices.assign(_indices.begin(), _indices.end());
+		indexData = (char*)_shortIndices.data();
+	}
+
+	info.indexBuferSize =  _indices.size() * info.indexSize;
+	info.indexCount = _indices.size();
+
+	info.bounds = assets::calculateBounds(_vertices.data(), _vertices.size());
+	info.vertexFormat = VertexFormatEnum;
+	info.compressionMode = options.meshCompression;
+	info.originalFile = input.string();
+
+	std::vector<char> meshletData;
+	if (options.meshlets)
+	{
+		//meshlets cover the full detail level
+		build_meshlets(_vertices.data(), _vertices.size(), _indices.data(), info.lods[0].indexCount, options.meshletSettings, info, meshletData);
+		log << "built " << info.meshletCount << " meshlets" << std::endl;
+	}
+
+	assets::AssetFile newFile = assets::pack_mesh(&info, vertexData, indexData, options.meshlets ? meshletData.data() : nullptr);
+	if (!options.jsonSidecar)
+		newFile.json.clear();
+
+	fs::path meshpath = outputFolder.parent_path() / (meshname + ".mesh");
+	log << "/* message */" <<meshpath.string().c_str()<< '\n';
+	if (!save_binaryfile(meshpath.string().c_str(), newFile))
+		return false;
+
+	outputPath = meshpath;
+	return true;
+}
+
+bool extract_assimp_meshes(const aiScene* scene, const fs::path& input, const fs::path& outputFolder, const BakerOptions& options, assets::JobSystem& jobs, std::ostream& log, std::vector<fs::path>& outputs)
+{
+	if(!scene)
+	{
+		log << "invalid file for assimp"<< std::endl;
+		return false;
+	}
+
+	//every mesh bakes in its own job, the logs and outputs are gathered in mesh order afterwards
+	struct MeshBake
+	{
+		std::ostringstream log;
+		fs::path output;
+		bool saved = false;
+	};
+
+	std::vector<MeshBake> bakes(scene->mNumMeshes);
+
+	assets::JobGroup group;
+	for (size_t meshindex = 0; meshindex < scene->mNumMeshes; meshindex++)
+	{
+		jobs.run(group, [&, meshindex]() {
+			MeshBake& bake = bakes[meshindex];
+			bake.saved = extract_assimp_mesh(scene, meshindex, input, outputFolder, options, bake.log, bake.output);
+		});
+	}
+	jobs.wait(group);
+
+	bool saved = true;
+	for (const MeshBake& bake : bakes)
+	{
+		log << bake.log.str();
+		if (bake.saved)
+			outputs.push_back(bake.output);
+		saved &= bake.saved;
+	}
+	return saved;
+}
+
+bool write_archive(const fs::path& archivePath, std::vector<fs::path> outputs, const BakerOptions& options)
+{
+	//names listed in the order file go first, everything else keeps the bake order
+	std::vector<std::string> loadOrder;
+	if (!options.archiveOrder.empty())
+	{
+		std::ifstream orderFile{ options.archiveOrder };
+		if (!orderFile.is_open())
+		{
+			std::cout << "Failed to open archive order file " << options.archiveOrder << std::endl;
+			return false;
 		}
 
-		_indices.resize(mesh->mNumFaces * 3);
-		for (size_t f = 0; f < mesh->mNumFaces; f++)
+		std::string line;
+		while (std::getline(orderFile, line))
 		{
-			_indices[f * 3 + 0] = mesh->mFaces[f].mIndices[0];
-			_indices[f * 3 + 1] = mesh->mFaces[f].mIndices[1];
-			_indices[f * 3 + 2] = mesh->mFaces[f].mIndices[2];
+			if (!line.empty())
+				loadOrder.push_back(line);
+		}
+	}
 
-			//TODO check if this still valid
-			//assimp fbx creates bad normals, just regen them
-			if (true)
-			{
-				int v0 = _indices[f * 3 + 0];
-				int v1 = _indices[f * 3 + 1];
-				int v2 = _indices[f * 3 + 2];
-				glm::vec3 p0{ _vertices[v0].position[0],
-					 _vertices[v0].position[1],
-					 _vertices[v0].position[2]
-				};
-				glm::vec3 p1{ _vertices[v1].position[0],
-					 _vertices[v1].position[1],
-					 _vertices[v1].position[2]
-				};
-				glm::vec3 p2{ _vertices[v2].position[0],
-					 _vertices[v2].position[1],
-					 _vertices[v2].position[2]
-				};
-
-				glm::vec3 normal =  glm::normalize(glm::cross(p2 - p0, p1 - p0));
-
-				memcpy(_vertices[v0].normal, &normal, sizeof(float) * 3);
-				memcpy(_vertices[v1].normal, &normal, sizeof(float) * 3);
-				memcpy(_vertices[v2].normal, &normal, sizeof(float) * 3);
-			}
+	std::stable_sort(outputs.begin(), outputs.end(), [&](const fs::path& a, const fs::path& b) {
+		size_t orderA = std::find(loadOrder.begin(), loadOrder.end(), a.filename().string()) - loadOrder.begin();
+		size_t orderB = std::find(loadOrder.begin(), loadOrder.end(), b.filename().string()) - loadOrder.begin();
+		return orderA < orderB;
+	});
+
+	assets::ArchiveBuilder builder;
+	for (const auto& output : outputs)
+	{
+		assets::add_archive_file(builder, output.filename().string(), output.string());
+	}
+
+	std::cout << "writing archive " << archivePath << " with " << outputs.size() << " assets" << std::endl;
+	return assets::save_archive(archivePath.string().c_str(), builder);
+}
+
+bool is_bake_source(const fs::path& input)
+{
+	return input.extension() == ".png" || input.extension() == ".obj" || input.extension() == ".glb";
+}
+
+bool bake_file(const fs::path& input, const fs::path& output_directory, const BakerOptions& options, assets::JobSystem& jobs, std::ostream& log, std::vector<fs::path>& outputs)
+{
+	log << "File: " << input << std::endl;
+
+	if (input.extension() == ".png")
+	{
+		log << "found a texture" << std::endl;
+
+		fs::path newpath = output_directory / input.filename();
+		newpath.replace_extension(".tx");
+		return convert_image(input, newpath, options, jobs, log, outputs);
+	}
+
+	if (input.extension() == ".obj" || input.extension() == ".glb")
+	{
+		log << "found a mesh" << std::endl;
+
+		Assimp::Importer importer;
+		const aiScene* scene = importer.ReadFile( input.string(),
+				aiProcess_CalcTangentSpace       |
+				aiProcess_Triangulate            |
+				aiProcess_JoinIdenticalVertices  |
+				aiProcess_FlipUVs                |
+				aiProcess_SortByPType);
+
+		fs::path newpath = output_directory / input.filename();
+		newpath.replace_extension(".mesh");
+		return extract_assimp_meshes(scene, input, newpath, options, jobs, log, outputs);
+	}
+
+	return false;
+}
+
+//every option that changes the baked bytes, the thread count and the archive settings do not
+uint64_t hash_bake_settings(const BakerOptions& options)
+{
+	char settings[512];
+	snprintf(settings, sizeof(settings), "version %u mesh %d texture %d vertex %d weld %d %g cache %d overdraw %d fetch %d lods %u %f meshlets %d %u %u mips %d format %d quality %d json %d",
+		BakerVersion, int(options.meshCompression), int(options.textureCompression), int(options.vertexFormat),
+		int(options.weldMode), options.weldEpsilon,
+		options.optimizeVertexCache, options.optimizeOverdraw, options.optimizeVertexFetch,
+		options.lodCount, options.lodRatio,
+		options.meshlets, options.meshletSettings.maxVertices, options.meshletSettings.maxTriangles,
+		int(options.mipFilter), int(options.textureFormat), int(options.blockQuality), options.jsonSidecar);
+
+	return hash_bytes(settings, strlen(settings));
+}
+
+//the source itself and the files next to it that change how it bakes
+std::vector<FileStamp> read_input_stamps(const fs::path& input)
+{
+	std::vector<FileStamp> stamps;
+
+	FileStamp stamp;
+	if (read_file_stamp(input, stamp))
+		stamps.push_back(stamp);
+
+	if (input.extension() == ".png")
+	{
+		fs::path settingsPath = input;
+		settingsPath += ".json";
+		if (read_file_stamp(settingsPath, stamp))
+			stamps.push_back(stamp);
+	}
+
+	return stamps;
+}
+
+struct SourceBake
+{
+	assets::JobGroup group;
+	std::ostringstream log;
+	std::vector<fs::path> outputs;
+
+	BakeRecord record;
+	bool rebaked = false;
+	bool failed = false;
+};
+
+//bakes one source unless the manifest has it with the same content and settings and its outputs are still there
+void bake_source(const fs::path& input, const fs::path& output_directory, const BakerOptions& options, const BakeManifest& manifest, uint64_t settingsHash, assets::JobSystem& jobs, SourceBake& bake)
+{
+	BakeRecord& record = bake.record;
+	record.inputs = read_input_stamps(input);
+	record.settingsHash = settingsHash;
+
+	const BakeRecord* previous = nullptr;
+	auto found = manifest.records.find(input.filename().string());
+	if (!options.force && found != manifest.records.end() && found->second.settingsHash == settingsHash)
+	{
+		previous = &found->second;
+		for (const std::string& output : previous->outputs)
+		{
+			if (!fs::exists(output_directory / output))
+				previous = nullptr;
 		}
+	}
 
-		assets::MeshInfo info;
-		info.vertexBuferSize = _vertices.size() * sizeof(VertexFormat);
-		info.vertexCount = mesh->mNumVertices;
-		info.faceCount = mesh->mNumFaces;
+	auto reuse_previous = [&]() {
+		record.contentHash = previous->contentHash;
+		record.outputs = previous->outputs;
+		for (const std::string& output : previous->outputs)
+			bake.outputs.push_back(output_directory / output);
 
-		info.indexBuferSize =  _indices.size() * sizeof(uint32_t);
-		info.indexCount = mesh->mNumFaces * 3;
+		bake.log << "File: " << input << " is up to date" << std::endl;
+	};
 
-		info.bounds = assets::calculateBounds(_vertices.data(), _vertices.size());
-		info.vertexFormat = VertexFormatEnum;
-		info.indexSize = sizeof(uint32_t);
-		info.originalFile = input.string();
+	//same sizes and times, the sources are not even read
+	if (previous && stamps_match(previous->inputs, record.inputs))
+	{
+		reuse_previous();
+		return;
+	}
 
-		assets::AssetFile newFile = assets::pack_mesh(&info, (char*)_vertices.data(), (char*)_indices.data());
+	uint64_t contentHash = 0;
+	for (const FileStamp& stamp : record.inputs)
+		hash_file(stamp.path, contentHash, contentHash);
+	record.contentHash = contentHash;
 
-		std::string meshname = calculate_assimp_mesh_name(scene, meshindex);
-		fs::path meshpath = outputFolder.parent_path() / (meshname + ".mesh");
-		std::cout << "/* message */" <<meshpath.string().c_str()<< '\n';
-		save_binaryfile(meshpath.string().c_str(), newFile);
+	//touched but not changed
+	if (previous && previous->contentHash == contentHash)
+	{
+		reuse_previous();
+		return;
 	}
+
+	bake.rebaked = true;
+	bake.failed = !bake_file(input, output_directory, options, jobs, bake.log, bake.outputs);
+
+	for (const fs::path& output : bake.outputs)
+		record.outputs.push_back(output.filename().string());
 }
 
 int main(int argc, char const *argv[])
@@ -188,9 +773,179 @@ int main(int argc, char const *argv[])
   if (argc < 2)
 	{
 		std::cout << "You need to put the path to the info file"<< std::endl;
+		print_usage();
 		return -1;
 	}
 
+	if (std::string{ argv[1] } == "--bench")
+	{
+		if (argc < 3)
+		{
+			print_usage();
+			return -1;
+		}
+		return run_geometry_bench(argv[2]) ? 0 : -1;
+	}
+
+	BakerOptions options;
+	for (int i = 2; i < argc; i++)
+	{
+		std::string arg{ argv[i] };
+		bool hasValue = i + 1 < argc;
+
+		if ((arg == "-j" || arg == "--jobs") && hasValue)
+		{
+			if (!parse_thread_count_option(argv[++i], options.threadCount))
+			{
+				print_usage();
+				return -1;
+			}
+		}
+		else if (arg == "--force")
+		{
+			options.force = true;
+		}
+		else if (arg == "--compression" && hasValue)
+		{
+			if (!parse_compression_option(argv[++i], options.meshCompression))
+				return -1;
+			options.textureCompression = options.meshCompression;
+		}
+		else if (arg == "--mesh-compression" && hasValue)
+		{
+			if (!parse_compression_option(argv[++i], options.meshCompression))
+				return -1;
+		}
+		else if (arg == "--texture-compression" && hasValue)
+		{
+			if (!parse_compression_option(argv[++i], options.textureCompression))
+				return -1;
+		}
+		else if (arg == "--vertex-format" && hasValue)
+		{
+			std::string format{ argv[++i] };
+			if (format == "packed")
+				options.vertexFormat = assets::VertexFormat::P32N8C8V16;
+			else if (format == "f32")
+				options.vertexFormat = assets::VertexFormat::PNCV_F32;
+			else
+			{
+				std::cout << "unknown vertex format " << format << ", use packed or f32" << std::endl;
+				return -1;
+			}
+		}
+		else if (arg == "--weld" && hasValue)
+		{
+			std::string mode{ argv[++i] };
+			if (mode == "exact")
+				options.weldMode = WeldMode::Exact;
+			else if (mode == "epsilon")
+				options.weldMode = WeldMode::Epsilon;
+			else
+			{
+				std::cout << "unknown weld mode " << mode << ", use exact or epsilon" << std::endl;
+				return -1;
+			}
+		}
+		else if (arg == "--weld-epsilon" && hasValue)
+		{
+			options.weldMode = WeldMode::Epsilon;
+			if (!parse_float_option("weld epsilon", argv[++i], options.weldEpsilon))
+				return -1;
+			if (options.weldEpsilon <= 0.f)
+			{
+				std::cout << "weld epsilon has to be positive" << std::endl;
+				return -1;
+			}
+		}
+		else if (arg == "--optimize")
+		{
+			options.optimizeVertexCache = true;
+			options.optimizeOverdraw = true;
+			options.optimizeVertexFetch = true;
+		}
+		else if (arg == "--optimize-cache")
+		{
+			options.optimizeVertexCache = true;
+		}
+		else if (arg == "--optimize-overdraw")
+		{
+			options.optimizeOverdraw = true;
+		}
+		else if (arg == "--optimize-fetch")
+		{
+			options.optimizeVertexFetch = true;
+		}
+		else if (arg == "--lods" && hasValue)
+		{
+			if (!parse_count_option("lod count", argv[++i], 1, assets::MaxMeshLods, options.lodCount))
+				return -1;
+		}
+		else if (arg == "--lod-ratio" && hasValue)
+		{
+			if (!parse_float_option("lod ratio", argv[++i], options.lodRatio))
+				return -1;
+			if (options.lodRatio <= 0.f || options.lodRatio >= 1.f)
+			{
+				std::cout << "lod ratio has to be between 0 and 1" << std::endl;
+				return -1;
+			}
+		}
+		else if (arg == "--meshlets")
+		{
+			options.meshlets = true;
+		}
+		else if (arg == "--meshlet-vertices" && hasValue)
+		{
+			options.meshlets = true;
+			if (!parse_count_option("meshlet vertices", argv[++i], 3, MaxMeshletVertices, options.meshletSettings.maxVertices))
+				return -1;
+		}
+		else if (arg == "--meshlet-triangles" && hasValue)
+		{
+			options.meshlets = true;
+			if (!parse_count_option("meshlet triangles", argv[++i], 1, MaxMeshletTriangles, options.meshletSettings.maxTriangles))
+				return -1;
+		}
+		else if (arg == "--mip-filter" && hasValue)
+		{
+			if (!parse_mip_filter_option(argv[++i], options.mipFilter, std::cout))
+				return -1;
+		}
+		else if (arg == "--texture-format" && hasValue)
+		{
+			if (!parse_texture_format_option(argv[++i], options.textureFormat, std::cout))
+				return -1;
+		}
+		else if (arg == "--bc-quality" && hasValue)
+		{
+			if (!parse_block_quality(argv[++i], options.blockQuality))
+			{
+				std::cout << "unknown quality " << argv[i] << ", use fast, normal or high" << std::endl;
+				return -1;
+			}
+		}
+		else if (arg == "--json-sidecar")
+		{
+			options.jsonSidecar = true;
+		}
+		else if (arg == "--archive")
+		{
+			options.archive = true;
+		}
+		else if (arg == "--archive-order" && hasValue)
+		{
+			options.archive = true;
+			options.archiveOrder = argv[++i];
+		}
+		else
+		{
+			std::cout << "unknown option " << arg << std::endl;
+			print_usage();
+			return -1;
+		}
+	}
+
   fs::path path{ argv[1] };
   fs::path input_directory = path;
 	fs::path output_directory = path / OUTDIR;
@@ -199,36 +954,114 @@ int main(int argc, char const *argv[])
 
   std::cout << "loading asset directory at " << input_directory << std::endl;
 
-  for (auto& p : fs::directory_iterator(input_directory))
-  {
-  	std::cout << "File: " << p << std::endl;
+	//sorted so the bake order, the console output and the archive do not depend on the file system
+	std::vector<fs::path> inputs;
+	for (auto& p : fs::directory_iterator(input_directory))
+	{
+		if (is_bake_source(p.path()))
+			inputs.push_back(p.path());
+	}
+	std::sort(inputs.begin(), inputs.end());
+
+	fs::path manifestPath = output_directory / MANIFEST_NAME;
+	BakeManifest previousManifest;
+	load_manifest(manifestPath, previousManifest);
+
+	uint64_t settingsHash = hash_bake_settings(options);
+
+	std::vector<SourceBake> bakes(inputs.size());
+
+	assets::JobSystem jobs{ options.threadCount };
+	for (size_t i = 0; i < inputs.size(); i++)
+	{
+		jobs.run(bakes[i].group, [&, i]() {
+			bake_source(inputs[i], output_directory, options, previousManifest, settingsHash, jobs, bakes[i]);
+		});
+	}
+
+	//every file is printed once it and the ones before it are done, this thread helps with the jobs while it waits
+	BakeManifest manifest;
+	std::vector<fs::path> outputs;
+	bool rebaked = false;
+	for (size_t i = 0; i < inputs.size(); i++)
+	{
+		SourceBake& bake = bakes[i];
+		jobs.wait(bake.group);
 
-  	if (p.path().extension() == ".png")
-    {
-			std::cout << "found a texture" << std::endl;
+		std::cout << bake.log.str();
+		outputs.insert(outputs.end(), bake.outputs.begin(), bake.outputs.end());
+		rebaked |= bake.rebaked;
 
-			fs::path newpath = output_directory / p.path().filename();
-			newpath.replace_extension(".tx");
-			convert_image(p.path(), newpath);
-  	}
+		std::string source = inputs[i].filename().string();
+		if (!bake.failed)
+		{
+			manifest.records[source] = bake.record;
+			continue;
+		}
 
-  	if (p.path().extension() == ".obj" || p.path().extension() == ".glb")
-    {
-			std::cout << "found a mesh" << std::endl;
+		//a failed source keeps what it baked last time. its record only lists the outputs, so they are not
+		//stale and still get removed with the source, and it has no settings hash so the next run tries again
+		BakeRecord kept;
+		kept.outputs = bake.record.outputs;
+		auto previous = previousManifest.records.find(source);
+		if (previous != previousManifest.records.end())
+		{
+			for (const std::string& output : previous->second.outputs)
+			{
+				if (std::find(kept.outputs.begin(), kept.outputs.end(), output) == kept.outputs.end() && fs::exists(output_directory / output))
+				{
+					kept.outputs.push_back(output);
+					outputs.push_back(output_directory / output);
+				}
+			}
+		}
+		manifest.records[source] = std::move(kept);
+	}
+
+	//outputs a source no longer produces, like the meshes of a removed scene node or of a deleted source
+	std::unordered_set<std::string> outputNames;
+	for (const fs::path& output : outputs)
+		outputNames.insert(output.filename().string());
+
+	for (const auto& [source, record] : previousManifest.records)
+	{
+		for (const std::string& output : record.outputs)
+		{
+			if (outputNames.count(output) == 0)
+			{
+				std::cout << "removing stale " << output << std::endl;
+				fs::remove(output_directory / output);
+			}
+		}
+	}
 
-			Assimp::Importer importer;
-			const aiScene* scene = importer.ReadFile( p.path(),
-					aiProcess_CalcTangentSpace       |
-				 	aiProcess_Triangulate            |
-				 	aiProcess_JoinIdenticalVertices  |
-				 	aiProcess_FlipUVs								 |
-				 	aiProcess_SortByPType);
+	if (options.archive)
+	{
+		//the archive only changes with its content and its order
+		uint64_t archiveHash = 0;
+		for (const fs::path& output : outputs)
+		{
+			std::string name = output.filename().string();
+			archiveHash = hash_bytes(name.data(), name.size(), archiveHash);
+		}
+		if (!options.archiveOrder.empty())
+			hash_file(options.archiveOrder, archiveHash, archiveHash);
 
-			fs::path newpath = output_directory / p.path().filename();
-    	newpath.replace_extension(".mesh");
-			extract_assimp_meshes(scene, p.path(), newpath);
+		fs::path archivePath = output_directory / ARCHIVE_NAME;
+		if (rebaked || archiveHash != previousManifest.archiveHash || !fs::exists(archivePath))
+		{
+			if (write_archive(archivePath, outputs, options))
+				manifest.archiveHash = archiveHash;
+		}
+		else
+		{
+			std::cout << "archive is up to date" << std::endl;
+			manifest.archiveHash = archiveHash;
 		}
 	}
 
+	if (!save_manifest(manifestPath, manifest))
+		std::cout << "Failed to write the bake manifest " << manifestPath << std::endl;
+
   return 0;
 }
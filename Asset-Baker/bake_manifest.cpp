@@ -0,0 +1,296 @@
+#include <bake_manifest.h>
+
+#include <asset_loader.h>
+
+#include <cstring>
+#include <fstream>
+
+#include <json.hpp>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+	constexpr uint64_t Prime1 = 11400714785074694791ull;
+	constexpr uint64_t Prime2 = 14029467366897019727ull;
+	constexpr uint64_t Prime3 = 1609587929392839161ull;
+	constexpr uint64_t Prime4 = 9650029242287828579ull;
+	constexpr uint64_t Prime5 = 2870177450012600261ull;
+
+	uint64_t rotate_left(uint64_t value, int bits)
+	{
+		return (value << bits) | (value >> (64 - bits));
+	}
+
+	uint64_t read64(const uint8_t* data)
+	{
+		uint64_t value;
+		memcpy(&value, data, sizeof(value));
+		return value;
+	}
+
+	uint32_t read32(const uint8_t* data)
+	{
+		uint32_t value;
+		memcpy(&value, data, sizeof(value));
+		return value;
+	}
+
+	uint64_t hash_round(uint64_t accumulator, uint64_t input)
+	{
+		accumulator += input * Prime2;
+		accumulator = rotate_left(accumulator, 31);
+		return accumulator * Prime1;
+	}
+
+	uint64_t merge_round(uint64_t accumulator, uint64_t value)
+	{
+		accumulator ^= hash_round(0, value);
+		return accumulator * Prime1 + Prime4;
+	}
+
+	//the manifest is only read back through these, a key of the wrong type fails the load instead of throwing
+	bool read_unsigned(const nlohmann::json& object, const char* key, uint64_t& outValue)
+	{
+		auto value = object.find(key);
+		if (value == object.end() || !value->is_number_unsigned())
+			return false;
+
+		outValue = value->get<uint64_t>();
+		return true;
+	}
+
+	bool read_integer(const nlohmann::json& object, const char* key, int64_t& outValue)
+	{
+		auto value = object.find(key);
+		if (value == object.end() || !value->is_number_integer())
+			return false;
+
+		outValue = value->get<int64_t>();
+		return true;
+	}
+
+	bool read_string(const nlohmann::json& object, const char* key, std::string& outValue)
+	{
+		auto value = object.find(key);
+		if (value == object.end() || !value->is_string())
+			return false;
+
+		outValue = value->get<std::string>();
+		return true;
+	}
+
+	bool read_record(const nlohmann::json& entry, BakeRecord& outRecord)
+	{
+		if (!entry.is_object() || !read_unsigned(entry, "content_hash", outRecord.contentHash) || !read_unsigned(entry, "settings_hash", outRecord.settingsHash))
+			return false;
+
+		auto inputs = entry.find("inputs");
+		auto outputs = entry.find("outputs");
+		if (inputs == entry.end() || !inputs->is_array() || outputs == entry.end() || !outputs->is_array())
+			return false;
+
+		for (const nlohmann::json& input : *inputs)
+		{
+			FileStamp stamp;
+			if (!input.is_object() || !read_string(input, "path", stamp.path) || !read_unsigned(input, "size", stamp.size) || !read_integer(input, "write_time", stamp.writeTime))
+				return false;
+			outRecord.inputs.push_back(stamp);
+		}
+
+		for (const nlohmann::json& output : *outputs)
+		{
+			if (!output.is_string())
+				return false;
+			outRecord.outputs.push_back(output.get<std::string>());
+		}
+		return true;
+	}
+}
+
+uint64_t hash_bytes(const void* data, size_t size, uint64_t seed)
+{
+	const uint8_t* input = (const uint8_t*)data;
+	const uint8_t* end = input + size;
+
+	uint64_t hash;
+	if (size >= 32)
+	{
+		uint64_t v1 = seed + Prime1 + Prime2;
+		uint64_t v2 = seed + Prime2;
+		uint64_t v3 = seed;
+		uint64_t v4 = seed - Prime1;
+
+		//four independent lanes keep the multipliers busy
+		const uint8_t* limit = end - 32;
+		do
+		{
+			v1 = hash_round(v1, read64(input));
+			v2 = hash_round(v2, read64(input + 8));
+			v3 = hash_round(v3, read64(input + 16));
+			v4 = hash_round(v4, read64(input + 24));
+			input += 32;
+		} while (input <= limit);
+
+		hash = rotate_left(v1, 1) + rotate_left(v2, 7) + rotate_left(v3, 12) + rotate_left(v4, 18);
+		hash = merge_round(hash, v1);
+		hash = merge_round(hash, v2);
+		hash = merge_round(hash, v3);
+		hash = merge_round(hash, v4);
+	}
+	else
+	{
+		hash = seed + Prime5;
+	}
+
+	hash += uint64_t(size);
+
+	for (; input + 8 <= end; input += 8)
+	{
+		hash ^= hash_round(0, read64(input));
+		hash = rotate_left(hash, 27) * Prime1 + Prime4;
+	}
+
+	if (input + 4 <= end)
+	{
+		hash ^= uint64_t(read32(input)) * Prime1;
+		hash = rotate_left(hash, 23) * Prime2 + Prime3;
+		input += 4;
+	}
+
+	for (; input < end; input++)
+	{
+		hash ^= (*input) * Prime5;
+		hash = rotate_left(hash, 11) * Prime1;
+	}
+
+	hash ^= hash >> 33;
+	hash *= Prime2;
+	hash ^= hash >> 29;
+	hash *= Prime3;
+	hash ^= hash >> 32;
+	return hash;
+}
+
+bool hash_file(const fs::path& path, uint64_t& outHash, uint64_t seed)
+{
+	std::error_code error;
+	if (fs::file_size(path, error) == 0 && !error)
+	{
+		outHash = hash_bytes(nullptr, 0, seed);
+		return true;
+	}
+
+	assets::MappedFile file;
+	if (!assets::map_file(path.string().c_str(), file))
+		return false;
+
+	outHash = hash_bytes(file.data, file.size, seed);
+	assets::unmap_file(file);
+	return true;
+}
+
+bool read_file_stamp(const fs::path& path, FileStamp& outStamp)
+{
+	std::error_code error;
+	uint64_t size = fs::file_size(path, error);
+	if (error)
+		return false;
+
+	auto writeTime = fs::last_write_time(path, error);
+	if (error)
+		return false;
+
+	outStamp.path = path.string();
+	outStamp.size = size;
+	outStamp.writeTime = int64_t(writeTime.time_since_epoch().count());
+	return true;
+}
+
+bool stamps_match(const std::vector<FileStamp>& a, const std::vector<FileStamp>& b)
+{
+	if (a.size() != b.size())
+		return false;
+
+	for (size_t i = 0; i < a.size(); i++)
+	{
+		if (a[i].path != b[i].path || a[i].size != b[i].size || a[i].writeTime != b[i].writeTime)
+			return false;
+	}
+	return true;
+}
+
+bool load_manifest(const fs::path& path, BakeManifest& outManifest)
+{
+	std::ifstream file{ path };
+	if (!file.is_open())
+		return false;
+
+	//anything but what save_manifest writes is ignored as a whole, every source is baked again
+	nlohmann::json manifest = nlohmann::json::parse(file, nullptr, false);
+	uint64_t version = 0;
+	if (!manifest.is_object() || !read_unsigned(manifest, "version", version) || version != BakerVersion)
+		return false;
+
+	BakeManifest loaded;
+	if (!read_unsigned(manifest, "archive_hash", loaded.archiveHash))
+		return false;
+
+	auto sources = manifest.find("sources");
+	if (sources == manifest.end() || !sources->is_object())
+		return false;
+
+	for (const auto& [source, entry] : sources->items())
+	{
+		BakeRecord record;
+		if (!read_record(entry, record))
+			return false;
+		loaded.records[source] = std::move(record);
+	}
+
+	outManifest = std::move(loaded);
+	return true;
+}
+
+bool save_manifest(const fs::path& path, const BakeManifest& manifest)
+{
+	nlohmann::json sources = nlohmann::json::object();
+	for (const auto& [source, record] : manifest.records)
+	{
+		nlohmann::json entry;
+		entry["content_hash"] = record.contentHash;
+		entry["settings_hash"] = record.settingsHash;
+
+		entry["inputs"] = nlohmann::json::array();
+		for (const FileStamp& stamp : record.inputs)
+		{
+			nlohmann::json input;
+			input["path"] = stamp.path;
+			input["size"] = stamp.size;
+			input["write_time"] = stamp.writeTime;
+			entry["inputs"].push_back(input);
+		}
+
+		entry["outputs"] = record.outputs;
+		sources[source] = entry;
+	}
+
+	nlohmann::json root;
+	root["version"] = BakerVersion;
+	root["archive_hash"] = manifest.archiveHash;
+	root["sources"] = sources;
+
+	//written next to the old one and swapped in, a bake that dies halfway keeps the last good manifest
+	fs::path tempPath = path;
+	tempPath += ".tmp";
+	{
+		std::ofstream file{ tempPath };
+		if (!file.is_open())
+			return false;
+		file << root.dump(1, '\t');
+	}
+
+	std::error_code error;
+	fs::rename(tempPath, path, error);
+	return !error;
+}
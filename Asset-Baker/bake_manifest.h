@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+//bump whenever the baked output changes for the same input and options, every asset is rebaked once
+constexpr uint32_t BakerVersion = 3;
+
+//size and modification time of a file, a match skips hashing its content
+struct FileStamp
+{
+	std::string path;
+	uint64_t size = 0;
+	int64_t writeTime = 0;
+};
+
+//what one source file was baked from and into. inputs holds the source first and then the files
+//that change how it bakes, like the texture settings next to an image
+struct BakeRecord
+{
+	std::vector<FileStamp> inputs;
+	uint64_t contentHash = 0;
+	uint64_t settingsHash = 0;
+	//file names inside the output directory, one source can bake into many assets
+	std::vector<std::string> outputs;
+};
+
+//persistent record of the last bake, keyed by source file name
+struct BakeManifest
+{
+	std::unordered_map<std::string, BakeRecord> records;
+	//outputs and load order the archive was last written with
+	uint64_t archiveHash = 0;
+};
+
+//xxHash64, fast enough that hashing is bound by reading the files
+uint64_t hash_bytes(const void* data, size_t size, uint64_t seed = 0);
+
+bool hash_file(const std::filesystem::path& path, uint64_t& outHash, uint64_t seed = 0);
+
+bool read_file_stamp(const std::filesystem::path& path, FileStamp& outStamp);
+
+bool stamps_match(const std::vector<FileStamp>& a, const std::vector<FileStamp>& b);
+
+bool load_manifest(const std::filesystem::path& path, BakeManifest& outManifest);
+
+bool save_manifest(const std::filesystem::path& path, const BakeManifest& manifest);
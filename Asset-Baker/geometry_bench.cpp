@@ -0,0 +1,172 @@
+#include <geometry_bench.h>
+
+#include <geometry.h>
+#include <mesh_asset.h>
+
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+namespace {
+
+	//runs after a warm up run, best of the rest so the numbers do not depend on what else the machine does
+	constexpr int BenchRuns = 10;
+
+	double time_kernel(const std::function<void()>& kernel)
+	{
+		kernel();
+
+		double best = 1e30;
+		for (int run = 0; run < BenchRuns; run++)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			kernel();
+			auto end = std::chrono::high_resolution_clock::now();
+
+			best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+		}
+		return best;
+	}
+
+	struct KernelResults
+	{
+		assets::Aabb box;
+		float radius;
+		std::vector<float> faceNormals;
+		std::vector<float> vertexNormals;
+		std::vector<float> transformed;
+
+		bool operator==(const KernelResults& other) const
+		{
+			return memcmp(&box, &other.box, sizeof(box)) == 0 && radius == other.radius && faceNormals == other.faceNormals
+				&& vertexNormals == other.vertexNormals && transformed == other.transformed;
+		}
+	};
+}
+
+bool run_geometry_bench(const std::filesystem::path& meshPath)
+{
+	Assimp::Importer importer;
+	const aiScene* scene = importer.ReadFile(meshPath.string(), aiProcess_Triangulate | aiProcess_JoinIdenticalVertices | aiProcess_SortByPType);
+	if (!scene)
+	{
+		std::cout << "failed to load " << meshPath << std::endl;
+		return false;
+	}
+
+	//every mesh of the scene in one buffer, the same layout the baker runs the kernels on
+	std::vector<assets::Vertex_f32_PNCV> vertices;
+	std::vector<uint32_t> indices;
+	for (unsigned int m = 0; m < scene->mNumMeshes; m++)
+	{
+		const aiMesh* mesh = scene->mMeshes[m];
+		uint32_t baseVertex = uint32_t(vertices.size());
+
+		for (unsigned int v = 0; v < mesh->mNumVertices; v++)
+		{
+			assets::Vertex_f32_PNCV vertex = {};
+			vertex.position[0] = mesh->mVertices[v].x;
+			vertex.position[1] = mesh->mVertices[v].y;
+			vertex.position[2] = mesh->mVertices[v].z;
+			vertices.push_back(vertex);
+		}
+
+		for (unsigned int f = 0; f < mesh->mNumFaces; f++)
+		{
+			if (mesh->mFaces[f].mNumIndices != 3)
+				continue;
+
+			for (int corner = 0; corner < 3; corner++)
+				indices.push_back(baseVertex + mesh->mFaces[f].mIndices[corner]);
+		}
+	}
+
+	if (vertices.empty() || indices.empty())
+	{
+		std::cout << meshPath << " has no triangles" << std::endl;
+		return false;
+	}
+
+	const size_t stride = sizeof(assets::Vertex_f32_PNCV);
+	const float* positions = vertices[0].position;
+	const float center[3] = { 0, 0, 0 };
+	const float matrix[16] = {
+		0.f, 0.f, -1.f, 0.f,
+		0.f, 2.f, 0.f, 0.f,
+		1.f, 0.f, 0.f, 0.f,
+		5.f, -10.f, 3.f, 1.f
+	};
+
+	std::cout << "geometry kernels on " << meshPath.filename() << ", " << vertices.size() << " vertices, " << indices.size() / 3 << " triangles" << std::endl;
+
+	const char* kernelNames[] = { "aabb", "bounding radius", "face normals", "vertex normals", "transform points" };
+	constexpr int KernelCount = 5;
+
+	const assets::SimdLevel supported = assets::supported_simd_level();
+	std::vector<std::vector<double>> times;
+	KernelResults reference;
+	bool match = true;
+
+	for (uint32_t level = 0; level <= uint32_t(supported); level++)
+	{
+		assets::set_simd_level(assets::SimdLevel(level));
+
+		KernelResults results;
+		results.faceNormals.resize(indices.size());
+		results.vertexNormals.resize(vertices.size() * 3);
+		results.transformed.resize(vertices.size() * 3);
+
+		std::vector<double> levelTimes(KernelCount);
+		levelTimes[0] = time_kernel([&]() { results.box = assets::compute_aabb(positions, vertices.size(), stride); });
+		levelTimes[1] = time_kernel([&]() { results.radius = assets::compute_bounding_radius(positions, vertices.size(), stride, center); });
+		levelTimes[2] = time_kernel([&]() { assets::compute_face_normals(positions, stride, indices.data(), indices.size(), results.faceNormals.data()); });
+		levelTimes[3] = time_kernel([&]() {
+			assets::compute_vertex_normals(positions, stride, indices.data(), indices.size(), vertices.size(), results.vertexNormals.data(), sizeof(float) * 3);
+		});
+		levelTimes[4] = time_kernel([&]() {
+			assets::transform_points(matrix, positions, vertices.size(), stride, results.transformed.data(), sizeof(float) * 3);
+		});
+		times.push_back(levelTimes);
+
+		if (level == 0)
+			reference = std::move(results);
+		else if (!(results == reference))
+		{
+			std::cout << assets::simd_level_name(assets::SimdLevel(level)) << " results differ from the scalar ones" << std::endl;
+			match = false;
+		}
+	}
+
+	//back to the default for anything that runs after
+	assets::set_simd_level(supported);
+
+	char line[256];
+	snprintf(line, sizeof(line), "%-18s", "kernel");
+	std::cout << line;
+	for (uint32_t level = 0; level < times.size(); level++)
+	{
+		snprintf(line, sizeof(line), "%20s", assets::simd_level_name(assets::SimdLevel(level)));
+		std::cout << line;
+	}
+	std::cout << std::endl;
+
+	for (int k = 0; k < KernelCount; k++)
+	{
+		snprintf(line, sizeof(line), "%-18s", kernelNames[k]);
+		std::cout << line;
+		for (uint32_t level = 0; level < times.size(); level++)
+		{
+			snprintf(line, sizeof(line), "%11.3f ms %5.2fx", times[level][k], times[0][k] / times[level][k]);
+			std::cout << line;
+		}
+		std::cout << std::endl;
+	}
+
+	return match;
+}
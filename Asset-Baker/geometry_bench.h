@@ -0,0 +1,7 @@
+#pragma once
+
+#include <filesystem>
+
+//times the Asset-Lib geometry kernels on every mesh of a model at each simd level the cpu supports,
+//and checks every level gives the same results as the scalar one
+bool run_geometry_bench(const std::filesystem::path& meshPath);
@@ -0,0 +1,526 @@
+#include <mesh_optimizer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <glm/glm.hpp>
+
+namespace {
+
+	//fifo cache simulated with time stamps, a vertex is cached while fewer than cacheSize misses happened since it was loaded
+	struct CacheSimulation
+	{
+		std::vector<uint32_t> timestamps;
+		uint32_t time;
+		uint32_t cacheSize;
+
+		CacheSimulation(size_t vertexCount, uint32_t size) : timestamps(vertexCount, 0), time(size + 1), cacheSize(size) {}
+
+		uint32_t add_triangle(const uint32_t* triangle)
+		{
+			uint32_t misses = 0;
+			for (int c = 0; c < 3; c++)
+			{
+				uint32_t vertex = triangle[c];
+				if (time - timestamps[vertex] > cacheSize)
+				{
+					timestamps[vertex] = time++;
+					misses++;
+				}
+			}
+			return misses;
+		}
+
+		void flush()
+		{
+			time += cacheSize + 1;
+		}
+	};
+
+	struct Adjacency
+	{
+		std::vector<uint32_t> offsets;
+		std::vector<uint32_t> triangles;
+	};
+
+	void build_adjacency(const uint32_t* indices, size_t indexCount, size_t vertexCount, Adjacency& adjacency)
+	{
+		adjacency.offsets.assign(vertexCount + 1, 0);
+		for (size_t i = 0; i < indexCount; i++)
+			adjacency.offsets[indices[i] + 1]++;
+		for (size_t v = 0; v < vertexCount; v++)
+			adjacency.offsets[v + 1] += adjacency.offsets[v];
+
+		adjacency.triangles.resize(indexCount);
+		std::vector<uint32_t> fill(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+		for (size_t i = 0; i < indexCount; i++)
+			adjacency.triangles[fill[indices[i]]++] = uint32_t(i / 3);
+	}
+
+	glm::vec3 vertex_position(const assets::Vertex_f32_PNCV* vertices, uint32_t index)
+	{
+		return glm::vec3{ vertices[index].position[0], vertices[index].position[1], vertices[index].position[2] };
+	}
+}
+
+VertexCacheStats analyze_vertex_cache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize)
+{
+	CacheSimulation cache{ vertexCount, cacheSize };
+
+	size_t misses = 0;
+	for (size_t i = 0; i + 2 < indexCount; i += 3)
+		misses += cache.add_triangle(indices + i);
+
+	std::vector<bool> referenced(vertexCount, false);
+	size_t uniqueVertices = 0;
+	for (size_t i = 0; i < indexCount; i++)
+	{
+		if (!referenced[indices[i]])
+		{
+			referenced[indices[i]] = true;
+			uniqueVertices++;
+		}
+	}
+
+	VertexCacheStats stats;
+	stats.acmr = indexCount ? float(misses) / float(indexCount / 3) : 0.f;
+	stats.atvr = uniqueVertices ? float(misses) / float(uniqueVertices) : 0.f;
+	return stats;
+}
+
+void optimize_vertex_cache(uint32_t* indices, size_t indexCount, size_t vertexCount, std::vector<uint32_t>* clusters, uint32_t cacheSize)
+{
+	size_t triangleCount = indexCount / 3;
+
+	Adjacency adjacency;
+	build_adjacency(indices, triangleCount * 3, vertexCount, adjacency);
+
+	//triangles still to be emitted around every vertex
+	std::vector<uint32_t> liveTriangles(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+		liveTriangles[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+
+	std::vector<uint32_t> cacheTime(vertexCount, 0);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<uint32_t> deadEnd;
+	std::vector<uint32_t> candidates;
+
+	std::vector<uint32_t> output;
+	output.reserve(triangleCount * 3);
+
+	if (clusters)
+		clusters->clear();
+
+	uint32_t time = cacheSize + 1;
+	size_t cursor = 0;
+
+	//finds a vertex with live triangles once the fan ran out of options, from the dead end stack and then in input order
+	auto skip_dead_end = [&]() -> int64_t {
+		while (!deadEnd.empty())
+		{
+			uint32_t vertex = deadEnd.back();
+			deadEnd.pop_back();
+			if (liveTriangles[vertex] > 0)
+				return vertex;
+		}
+
+		for (; cursor < vertexCount; cursor++)
+		{
+			if (liveTriangles[cursor] > 0)
+				return int64_t(cursor);
+		}
+
+		return -1;
+	};
+
+	int64_t fanning = triangleCount > 0 ? skip_dead_end() : -1;
+	if (clusters && fanning >= 0)
+		clusters->push_back(0);
+
+	while (fanning >= 0)
+	{
+		candidates.clear();
+
+		//emit every remaining triangle around the fanning vertex
+		for (uint32_t a = adjacency.offsets[fanning]; a < adjacency.offsets[fanning + 1]; a++)
+		{
+			uint32_t triangle = adjacency.triangles[a];
+			if (emitted[triangle])
+				continue;
+
+			for (int c = 0; c < 3; c++)
+			{
+				uint32_t vertex = indices[triangle * 3 + c];
+				output.push_back(vertex);
+
+				deadEnd.push_back(vertex);
+				candidates.push_back(vertex);
+				liveTriangles[vertex]--;
+
+				if (time - cacheTime[vertex] > cacheSize)
+					cacheTime[vertex] = time++;
+			}
+
+			emitted[triangle] = true;
+		}
+
+		//next fan from the candidate that stays in the cache longest while it gets its triangles emitted
+		int64_t next = -1;
+		int64_t bestPriority = -1;
+		for (uint32_t vertex : candidates)
+		{
+			if (liveTriangles[vertex] == 0)
+				continue;
+
+			int64_t priority = 0;
+			if (int64_t(time - cacheTime[vertex]) + 2 * int64_t(liveTriangles[vertex]) <= int64_t(cacheSize))
+				priority = time - cacheTime[vertex];
+
+			if (priority > bestPriority)
+			{
+				bestPriority = priority;
+				next = vertex;
+			}
+		}
+
+		if (next == -1)
+		{
+			next = skip_dead_end();
+			if (clusters && next >= 0)
+				clusters->push_back(uint32_t(output.size() / 3));
+		}
+
+		fanning = next;
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+void optimize_overdraw(uint32_t* indices, size_t indexCount, const assets::Vertex_f32_PNCV* vertices, size_t vertexCount,
+	const std::vector<uint32_t>& hardClusters, float threshold, uint32_t cacheSize)
+{
+	size_t triangleCount = indexCount / 3;
+	if (triangleCount == 0)
+		return;
+
+	float meshAcmr = analyze_vertex_cache(indices, triangleCount * 3, vertexCount, cacheSize).acmr;
+
+	//split the dead end runs further wherever the cache already did as well as on the whole mesh,
+	//breaking there costs little cache efficiency but gives the sort small clusters to work with
+	std::vector<uint32_t> clusters;
+	CacheSimulation cache{ vertexCount, cacheSize };
+
+	for (size_t h = 0; h < hardClusters.size(); h++)
+	{
+		size_t start = hardClusters[h];
+		size_t end = h + 1 < hardClusters.size() ? hardClusters[h + 1] : triangleCount;
+
+		cache.flush();
+
+		size_t clusterStart = start;
+		size_t clusterMisses = 0;
+		clusters.push_back(uint32_t(start));
+
+		for (size_t t = start; t < end; t++)
+		{
+			clusterMisses += cache.add_triangle(indices + t * 3);
+
+			bool lastTriangle = t + 1 == end;
+			if (!lastTriangle && float(clusterMisses) / float(t - clusterStart + 1) <= meshAcmr * threshold)
+			{
+				clusters.push_back(uint32_t(t + 1));
+				clusterStart = t + 1;
+				clusterMisses = 0;
+				cache.flush();
+			}
+		}
+	}
+
+	if (clusters.empty())
+		clusters.push_back(0);
+
+	struct ClusterSort
+	{
+		float key;
+		uint32_t cluster;
+	};
+
+	std::vector<glm::vec3> centroids(clusters.size());
+	std::vector<glm::vec3> normals(clusters.size());
+
+	glm::vec3 meshCentroid{ 0.f };
+	float meshArea = 0.f;
+
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		size_t start = clusters[c];
+		size_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+
+		glm::vec3 centroid{ 0.f };
+		glm::vec3 normal{ 0.f };
+		float area = 0.f;
+
+		for (size_t t = start; t < end; t++)
+		{
+			glm::vec3 p0 = vertex_position(vertices, indices[t * 3 + 0]);
+			glm::vec3 p1 = vertex_position(vertices, indices[t * 3 + 1]);
+			glm::vec3 p2 = vertex_position(vertices, indices[t * 3 + 2]);
+
+			//same winding as the normals the baker generates for the vertices, the length is twice the area
+			glm::vec3 triangleNormal = glm::cross(p2 - p0, p1 - p0);
+			float triangleArea = glm::length(triangleNormal);
+
+			centroid += (p0 + p1 + p2) * (triangleArea / 3.f);
+			normal += triangleNormal;
+			area += triangleArea;
+		}
+
+		meshCentroid += centroid;
+		meshArea += area;
+
+		centroids[c] = area > 0.f ? centroid / area : centroid;
+		float normalLength = glm::length(normal);
+		normals[c] = normalLength > 0.f ? normal / normalLength : normal;
+	}
+
+	if (meshArea > 0.f)
+		meshCentroid /= meshArea;
+
+	//clusters far out along their own normal are likely to occlude the rest, they go first
+	std::vector<ClusterSort> order(clusters.size());
+	for (size_t c = 0; c < clusters.size(); c++)
+	{
+		order[c].key = glm::dot(centroids[c] - meshCentroid, normals[c]);
+		order[c].cluster = uint32_t(c);
+	}
+
+	std::stable_sort(order.begin(), order.end(), [](const ClusterSort& a, const ClusterSort& b) {
+		return a.key > b.key;
+	});
+
+	std::vector<uint32_t> output;
+	output.reserve(triangleCount * 3);
+	for (const ClusterSort& sorted : order)
+	{
+		size_t start = clusters[sorted.cluster];
+		size_t end = sorted.cluster + 1 < clusters.size() ? clusters[sorted.cluster + 1] : triangleCount;
+		output.insert(output.end(), indices + start * 3, indices + end * 3);
+	}
+
+	std::copy(output.begin(), output.end(), indices);
+}
+
+void optimize_vertex_fetch(std::vector<assets::Vertex_f32_PNCV>& vertices, std::vector<uint32_t>& indices)
+{
+	constexpr uint32_t Unused = ~0u;
+
+	std::vector<uint32_t> remap(vertices.size(), Unused);
+	std::vector<assets::Vertex_f32_PNCV> reordered;
+	reordered.reserve(vertices.size());
+
+	for (uint32_t& index : indices)
+	{
+		if (remap[index] == Unused)
+		{
+			remap[index] = uint32_t(reordered.size());
+			reordered.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+
+	vertices.swap(reordered);
+}
+
+namespace {
+
+	constexpr size_t WeldKeyWords = sizeof(assets::Vertex_f32_PNCV) / sizeof(uint32_t);
+
+	//what two vertices have to share to be welded
+	struct WeldKey
+	{
+		uint32_t words[WeldKeyWords];
+
+		bool operator==(const WeldKey& other) const
+		{
+			return memcmp(words, other.words, sizeof(words)) == 0;
+		}
+	};
+
+	WeldKey make_weld_key(const assets::Vertex_f32_PNCV& vertex, WeldMode mode, float epsilon)
+	{
+		WeldKey key;
+		const float* attributes = (const float*)&vertex;
+
+		for (size_t i = 0; i < WeldKeyWords; i++)
+		{
+			if (mode == WeldMode::Exact)
+			{
+				memcpy(&key.words[i], &attributes[i], sizeof(uint32_t));
+			}
+			else
+			{
+				//grid cell of the attribute, neighbours that straddle a cell border stay apart
+				float cell = std::floor(attributes[i] / epsilon + 0.5f);
+				cell = std::min(std::max(cell, -2147483648.f), 2147483520.f);
+				key.words[i] = uint32_t(int32_t(cell));
+			}
+		}
+		return key;
+	}
+
+	uint64_t hash_weld_key(const WeldKey& key)
+	{
+		//fnv-1a over the words, with a final mix so the low bits pick the bucket well
+		uint64_t hash = 14695981039346656037ull;
+		for (uint32_t word : key.words)
+		{
+			hash ^= word;
+			hash *= 1099511628211ull;
+		}
+		hash ^= hash >> 29;
+		hash *= 0xbf58476d1ce4e5b9ull;
+		hash ^= hash >> 32;
+		return hash;
+	}
+}
+
+size_t weld_vertices(std::vector<assets::Vertex_f32_PNCV>& vertices, std::vector<uint32_t>& indices, WeldMode mode, float epsilon)
+{
+	constexpr uint32_t Empty = ~0u;
+
+	std::vector<WeldKey> keys(vertices.size());
+	for (size_t v = 0; v < vertices.size(); v++)
+		keys[v] = make_weld_key(vertices[v], mode, epsilon);
+
+	//open addressing table of the first vertex found for each key, kept under half full
+	size_t tableSize = 1;
+	while (tableSize < vertices.size() * 2)
+		tableSize *= 2;
+	std::vector<uint32_t> table(tableSize, Empty);
+
+	std::vector<uint32_t> remap(vertices.size());
+	for (size_t v = 0; v < vertices.size(); v++)
+	{
+		size_t bucket = hash_weld_key(keys[v]) & (tableSize - 1);
+		while (table[bucket] != Empty && !(keys[table[bucket]] == keys[v]))
+			bucket = (bucket + 1) & (tableSize - 1);
+
+		if (table[bucket] == Empty)
+			table[bucket] = uint32_t(v);
+		remap[v] = table[bucket];
+	}
+
+	for (uint32_t& index : indices)
+		index = remap[index];
+
+	size_t before = vertices.size();
+	optimize_vertex_fetch(vertices, indices);
+	return before - vertices.size();
+}
+
+void generate_crease_normals(std::vector<assets::Vertex_f32_PNCV>& vertices, std::vector<uint32_t>& indices, float creaseAngle)
+{
+	const size_t faceCount = indices.size() / 3;
+	const float creaseCos = std::cos(creaseAngle);
+
+	auto position = [&](uint32_t v) {
+		return glm::vec3(vertices[v].position[0], vertices[v].position[1], vertices[v].position[2]);
+	};
+
+	//unnormalized for the area weighting, same winding as assets::compute_face_normals
+	std::vector<glm::vec3> areaNormals(faceCount);
+	std::vector<glm::vec3> unitNormals(faceCount);
+	for (size_t f = 0; f < faceCount; f++)
+	{
+		glm::vec3 p0 = position(indices[f * 3 + 0]);
+		glm::vec3 p1 = position(indices[f * 3 + 1]);
+		glm::vec3 p2 = position(indices[f * 3 + 2]);
+
+		areaNormals[f] = glm::cross(p2 - p0, p1 - p0);
+		float length = glm::length(areaNormals[f]);
+		unitNormals[f] = length > 0.f ? areaNormals[f] / length : glm::vec3(0.f);
+	}
+
+	//vertices with the same position share their faces, sorted so equal positions are next to each other
+	std::vector<uint32_t> order(vertices.size());
+	for (uint32_t v = 0; v < order.size(); v++)
+		order[v] = v;
+	std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+		return std::lexicographical_compare(vertices[a].position, vertices[a].position + 3, vertices[b].position, vertices[b].position + 3);
+	});
+
+	std::vector<uint32_t> group(vertices.size());
+	uint32_t groupCount = 0;
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		//compared as values, -0 and 0 are the same position
+		if (i > 0 && position(order[i]) != position(order[i - 1]))
+			groupCount++;
+		group[order[i]] = groupCount;
+	}
+	if (!order.empty())
+		groupCount++;
+
+	//corners of every position group, packed by group
+	std::vector<uint32_t> groupStart(groupCount + 1, 0);
+	for (uint32_t index : indices)
+		groupStart[group[index] + 1]++;
+	for (uint32_t g = 0; g < groupCount; g++)
+		groupStart[g + 1] += groupStart[g];
+
+	std::vector<uint32_t> groupCorners(indices.size());
+	std::vector<uint32_t> fill(groupStart.begin(), groupStart.end() - 1);
+	for (uint32_t c = 0; c < indices.size(); c++)
+		groupCorners[fill[group[indices[c]]]++] = c;
+
+	//corners of a vertex that end up with the same normal keep sharing one vertex
+	constexpr uint32_t None = ~0u;
+	std::vector<assets::Vertex_f32_PNCV> result;
+	result.reserve(vertices.size());
+	//list of the vertices each input vertex was split into, chained through nextSplit
+	std::vector<uint32_t> firstSplit(vertices.size(), None);
+	std::vector<uint32_t> nextSplit;
+	nextSplit.reserve(vertices.size());
+
+	for (uint32_t c = 0; c < indices.size(); c++)
+	{
+		uint32_t v = indices[c];
+		const glm::vec3& faceNormal = unitNormals[c / 3];
+
+		//degenerate faces have no direction of their own and take the smooth normal of the position
+		bool degenerate = faceNormal == glm::vec3(0.f);
+
+		glm::vec3 normal(0.f);
+		uint32_t g = group[v];
+		for (uint32_t i = groupStart[g]; i < groupStart[g + 1]; i++)
+		{
+			uint32_t other = groupCorners[i] / 3;
+			if (degenerate || glm::dot(faceNormal, unitNormals[other]) >= creaseCos)
+				normal += areaNormals[other];
+		}
+
+		float length = glm::length(normal);
+		normal = length > 0.f ? normal / length : faceNormal;
+
+		uint32_t target = firstSplit[v];
+		while (target != None && memcmp(result[target].normal, &normal, sizeof(float) * 3) != 0)
+			target = nextSplit[target];
+
+		if (target == None)
+		{
+			target = uint32_t(result.size());
+			assets::Vertex_f32_PNCV vertex = vertices[v];
+			memcpy(vertex.normal, &normal, sizeof(float) * 3);
+			vertex.normal[3] = 0;
+			result.push_back(vertex);
+
+			nextSplit.push_back(firstSplit[v]);
+			firstSplit[v] = target;
+		}
+
+		indices[c] = target;
+	}
+
+	vertices.swap(result);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <mesh_asset.h>
+
+#include <cstdint>
+#include <vector>
+
+//post transform cache used for the reordering and the statistics, matches a typical fifo on current gpus
+constexpr uint32_t VertexCacheSize = 16;
+
+struct VertexCacheStats
+{
+	//transformed vertices per triangle, 0.5 is the best possible on a regular grid and 3 the worst
+	float acmr;
+	//transformed vertices per referenced vertex, 1 means every vertex is shaded once
+	float atvr;
+};
+
+VertexCacheStats analyze_vertex_cache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize = VertexCacheSize);
+
+//reorders the triangles for the post transform cache with Tipsify (Sander et al. 2007).
+//when clusters is not null it receives the first triangle of every run that ended in a dead end
+void optimize_vertex_cache(uint32_t* indices, size_t indexCount, size_t vertexCount, std::vector<uint32_t>* clusters = nullptr, uint32_t cacheSize = VertexCacheSize);
+
+//splits the cache optimized triangles into clusters and sorts them so outward facing ones near the hull draw first.
+//threshold is how much worse than the whole mesh a cluster ACMR can get, indices have to be cache optimized already
+void optimize_overdraw(uint32_t* indices, size_t indexCount, const assets::Vertex_f32_PNCV* vertices, size_t vertexCount,
+	const std::vector<uint32_t>& hardClusters, float threshold = 1.05f, uint32_t cacheSize = VertexCacheSize);
+
+enum class WeldMode
+{
+	Exact,  //every attribute has to be bit identical
+	Epsilon //attributes are compared once snapped to a grid of epsilon
+};
+
+//merges duplicated vertices with a hash of their attributes and points the indices at the kept ones.
+//the first vertex of each group is kept, the vertices end up in the order the indices use them and the
+//unreferenced ones are dropped. returns how many vertices were removed
+size_t weld_vertices(std::vector<assets::Vertex_f32_PNCV>& vertices, std::vector<uint32_t>& indices, WeldMode mode, float epsilon = 1e-5f);
+
+//replaces the normals with the area weighted normal of the faces around each position. faces meeting at more
+//than creaseAngle radians stay apart, a vertex shared by both sides of a crease is split. vertices have to be
+//welded first, a position split by uv or color seams still gets one normal on either side of the seam
+void generate_crease_normals(std::vector<assets::Vertex_f32_PNCV>& vertices, std::vector<uint32_t>& indices, float creaseAngle);
+
+//reorders the vertices to match their first use in the index buffer, unreferenced vertices are dropped
+void optimize_vertex_fetch(std::vector<assets::Vertex_f32_PNCV>& vertices, std::vector<uint32_t>& indices);
@@ -0,0 +1,448 @@
+#include <mesh_simplifier.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <utility>
+
+#include <glm/glm.hpp>
+
+namespace {
+
+	//area weighted sum of plane equations, evaluates to the mean squared distance to the planes
+	struct Quadric
+	{
+		double xx, xy, xz, xw;
+		double yy, yz, yw;
+		double zz, zw;
+		double ww;
+		double weight;
+	};
+
+	void add_plane(Quadric& q, const glm::dvec3& normal, double distance, double weight)
+	{
+		q.xx += weight * normal.x * normal.x;
+		q.xy += weight * normal.x * normal.y;
+		q.xz += weight * normal.x * normal.z;
+		q.xw += weight * normal.x * distance;
+		q.yy += weight * normal.y * normal.y;
+		q.yz += weight * normal.y * normal.z;
+		q.yw += weight * normal.y * distance;
+		q.zz += weight * normal.z * normal.z;
+		q.zw += weight * normal.z * distance;
+		q.ww += weight * distance * distance;
+		q.weight += weight;
+	}
+
+	void add_quadric(Quadric& q, const Quadric& other)
+	{
+		q.xx += other.xx; q.xy += other.xy; q.xz += other.xz; q.xw += other.xw;
+		q.yy += other.yy; q.yz += other.yz; q.yw += other.yw;
+		q.zz += other.zz; q.zw += other.zw;
+		q.ww += other.ww;
+		q.weight += other.weight;
+	}
+
+	double evaluate_quadric(const Quadric& q, const glm::dvec3& p)
+	{
+		double error = q.xx * p.x * p.x + 2 * q.xy * p.x * p.y + 2 * q.xz * p.x * p.z + 2 * q.xw * p.x
+			+ q.yy * p.y * p.y + 2 * q.yz * p.y * p.z + 2 * q.yw * p.y
+			+ q.zz * p.z * p.z + 2 * q.zw * p.z
+			+ q.ww;
+
+		return q.weight > 0 ? std::max(error / q.weight, 0.0) : 0.0;
+	}
+
+	struct Collapse
+	{
+		uint32_t from;
+		uint32_t to;
+		double cost;
+		double positionError;
+	};
+
+	//mesh state at the position level, vertices with the same position are wedges of one position
+	struct SimplifyMesh
+	{
+		const assets::Vertex_f32_PNCV* vertices;
+
+		std::vector<uint32_t> positionOf;
+		std::vector<glm::dvec3> positions;
+		std::vector<bool> locked;
+		std::vector<Quadric> quadrics;
+
+		std::vector<uint32_t> triangles;
+
+		//triangles around every position, rebuilt every pass
+		std::vector<uint32_t> triangleOffsets;
+		std::vector<uint32_t> positionTriangles;
+
+		double attributeScale;
+	};
+
+	glm::dvec3 triangle_normal(const glm::dvec3& a, const glm::dvec3& b, const glm::dvec3& c)
+	{
+		return glm::cross(b - a, c - a);
+	}
+
+	void build_position_triangles(SimplifyMesh& mesh)
+	{
+		size_t positionCount = mesh.positions.size();
+		size_t triangleCount = mesh.triangles.size() / 3;
+
+		mesh.triangleOffsets.assign(positionCount + 1, 0);
+		for (uint32_t index : mesh.triangles)
+			mesh.triangleOffsets[mesh.positionOf[index] + 1]++;
+		for (size_t p = 0; p < positionCount; p++)
+			mesh.triangleOffsets[p + 1] += mesh.triangleOffsets[p];
+
+		mesh.positionTriangles.resize(mesh.triangles.size());
+		std::vector<uint32_t> fill(mesh.triangleOffsets.begin(), mesh.triangleOffsets.end() - 1);
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			for (int c = 0; c < 3; c++)
+				mesh.positionTriangles[fill[mesh.positionOf[mesh.triangles[t * 3 + c]]]++] = uint32_t(t);
+		}
+	}
+
+	//squared uv distance under which two wedges are on the same side of a uv seam
+	constexpr float UvSeamTolerance = 1e-8f;
+
+	float uv_distance(const assets::Vertex_f32_PNCV& a, const assets::Vertex_f32_PNCV& b)
+	{
+		return (a.uv[0] - b.uv[0]) * (a.uv[0] - b.uv[0]) + (a.uv[1] - b.uv[1]) * (a.uv[1] - b.uv[1]);
+	}
+
+	float attribute_distance(const assets::Vertex_f32_PNCV& a, const assets::Vertex_f32_PNCV& b)
+	{
+		float distance = 0.f;
+		for (int i = 0; i < 3; i++)
+			distance += (a.normal[i] - b.normal[i]) * (a.normal[i] - b.normal[i]);
+		for (int i = 0; i < 2; i++)
+			distance += (a.uv[i] - b.uv[i]) * (a.uv[i] - b.uv[i]);
+		return distance;
+	}
+
+	//checks that from can move onto to and pairs every wedge of from with the wedge of to it collapses into
+	bool evaluate_collapse(const SimplifyMesh& mesh, uint32_t from, uint32_t to, Collapse& collapse, std::vector<std::pair<uint32_t, uint32_t>>& wedgePairs)
+	{
+		if (mesh.locked[from])
+			return false;
+
+		wedgePairs.clear();
+		std::vector<uint32_t> fromWedges;
+
+		const glm::dvec3& target = mesh.positions[to];
+
+		for (uint32_t a = mesh.triangleOffsets[from]; a < mesh.triangleOffsets[from + 1]; a++)
+		{
+			const uint32_t* triangle = &mesh.triangles[mesh.positionTriangles[a] * 3];
+
+			uint32_t fromWedge = ~0u, toWedge = ~0u;
+			for (int c = 0; c < 3; c++)
+			{
+				uint32_t position = mesh.positionOf[triangle[c]];
+				if (position == from)
+					fromWedge = triangle[c];
+				else if (position == to)
+					toWedge = triangle[c];
+			}
+
+			if (std::find(fromWedges.begin(), fromWedges.end(), fromWedge) == fromWedges.end())
+				fromWedges.push_back(fromWedge);
+
+			if (toWedge != ~0u)
+			{
+				//triangle collapses away, it tells which wedges go together
+				auto pair = std::find_if(wedgePairs.begin(), wedgePairs.end(), [&](const std::pair<uint32_t, uint32_t>& p) { return p.first == fromWedge; });
+				if (pair == wedgePairs.end())
+					wedgePairs.push_back({ fromWedge, toWedge });
+				else if (pair->second != toWedge)
+					return false;
+
+				continue;
+			}
+
+			//triangle stays, it must not flip or fold over
+			glm::dvec3 corners[3];
+			glm::dvec3 moved[3];
+			for (int c = 0; c < 3; c++)
+			{
+				uint32_t position = mesh.positionOf[triangle[c]];
+				corners[c] = mesh.positions[position];
+				moved[c] = position == from ? target : corners[c];
+			}
+
+			glm::dvec3 before = triangle_normal(corners[0], corners[1], corners[2]);
+			glm::dvec3 after = triangle_normal(moved[0], moved[1], moved[2]);
+
+			double beforeLength = glm::length(before);
+			double afterLength = glm::length(after);
+			if (beforeLength > 0.0 && glm::dot(before, after) < 0.25 * beforeLength * afterLength)
+				return false;
+		}
+
+		//a wedge whose triangles all stay has no partner yet. when another wedge of from has the same uv, only the
+		//normal differs and it is a normal seam: it moves onto the wedge of to with the uv of that wedge's partner and
+		//the closest normal, and the normal change is paid for in the cost. otherwise it is a uv seam that would tear
+		size_t pairedCount = wedgePairs.size();
+		for (uint32_t fromWedge : fromWedges)
+		{
+			auto paired = [&](const std::pair<uint32_t, uint32_t>& p) { return p.first == fromWedge; };
+			if (std::find_if(wedgePairs.begin(), wedgePairs.begin() + pairedCount, paired) != wedgePairs.begin() + pairedCount)
+				continue;
+
+			auto sibling = std::find_if(wedgePairs.begin(), wedgePairs.begin() + pairedCount, [&](const std::pair<uint32_t, uint32_t>& p) {
+				return uv_distance(mesh.vertices[p.first], mesh.vertices[fromWedge]) <= UvSeamTolerance;
+			});
+			if (sibling == wedgePairs.begin() + pairedCount)
+				return false;
+
+			const assets::Vertex_f32_PNCV& targetUv = mesh.vertices[sibling->second];
+
+			uint32_t closest = ~0u;
+			float closestDistance = FLT_MAX;
+			for (uint32_t a = mesh.triangleOffsets[to]; a < mesh.triangleOffsets[to + 1]; a++)
+			{
+				const uint32_t* triangle = &mesh.triangles[mesh.positionTriangles[a] * 3];
+				for (int c = 0; c < 3; c++)
+				{
+					uint32_t wedge = triangle[c];
+					if (mesh.positionOf[wedge] != to || uv_distance(targetUv, mesh.vertices[wedge]) > UvSeamTolerance)
+						continue;
+
+					float distance = attribute_distance(mesh.vertices[fromWedge], mesh.vertices[wedge]);
+					if (distance < closestDistance)
+					{
+						closest = wedge;
+						closestDistance = distance;
+					}
+				}
+			}
+
+			wedgePairs.push_back({ fromWedge, closest == ~0u ? sibling->second : closest });
+		}
+
+		Quadric quadric = mesh.quadrics[from];
+		add_quadric(quadric, mesh.quadrics[to]);
+
+		float attributeError = 0.f;
+		for (const auto& pair : wedgePairs)
+			attributeError = std::max(attributeError, attribute_distance(mesh.vertices[pair.first], mesh.vertices[pair.second]));
+
+		collapse.from = from;
+		collapse.to = to;
+		collapse.positionError = evaluate_quadric(quadric, target);
+		collapse.cost = collapse.positionError + mesh.attributeScale * attributeError;
+		return true;
+	}
+}
+
+float simplify_mesh(const assets::Vertex_f32_PNCV* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount,
+	size_t targetIndexCount, const SimplifySettings& settings, std::vector<uint32_t>& outIndices)
+{
+	SimplifyMesh mesh;
+	mesh.vertices = vertices;
+	mesh.triangles.assign(indices, indices + indexCount - indexCount % 3);
+
+	//wedges with the exact same position share one position id
+	std::vector<uint32_t> sorted(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+		sorted[v] = uint32_t(v);
+
+	auto position_less = [&](uint32_t a, uint32_t b) {
+		const float* pa = vertices[a].position;
+		const float* pb = vertices[b].position;
+		return std::lexicographical_compare(pa, pa + 3, pb, pb + 3);
+	};
+	std::sort(sorted.begin(), sorted.end(), position_less);
+
+	mesh.positionOf.resize(vertexCount);
+	for (size_t i = 0; i < vertexCount; i++)
+	{
+		if (i == 0 || position_less(sorted[i - 1], sorted[i]))
+		{
+			const float* p = vertices[sorted[i]].position;
+			mesh.positions.push_back(glm::dvec3{ p[0], p[1], p[2] });
+		}
+		mesh.positionOf[sorted[i]] = uint32_t(mesh.positions.size() - 1);
+	}
+
+	size_t positionCount = mesh.positions.size();
+
+	glm::dvec3 minimum{ DBL_MAX }, maximum{ -DBL_MAX };
+	for (const glm::dvec3& p : mesh.positions)
+	{
+		minimum = glm::min(minimum, p);
+		maximum = glm::max(maximum, p);
+	}
+	double radius = positionCount ? glm::length(maximum - minimum) * 0.5 : 0.0;
+	mesh.attributeScale = (settings.attributeWeight * radius) * (settings.attributeWeight * radius);
+
+	//plane quadrics from the original surface
+	mesh.quadrics.assign(positionCount, Quadric{});
+	for (size_t t = 0; t < mesh.triangles.size(); t += 3)
+	{
+		const glm::dvec3& a = mesh.positions[mesh.positionOf[mesh.triangles[t + 0]]];
+		const glm::dvec3& b = mesh.positions[mesh.positionOf[mesh.triangles[t + 1]]];
+		const glm::dvec3& c = mesh.positions[mesh.positionOf[mesh.triangles[t + 2]]];
+
+		glm::dvec3 normal = triangle_normal(a, b, c);
+		double area = glm::length(normal);
+		if (area <= 0.0)
+			continue;
+
+		normal /= area;
+		double distance = -glm::dot(normal, a);
+
+		for (int corner = 0; corner < 3; corner++)
+			add_plane(mesh.quadrics[mesh.positionOf[mesh.triangles[t + corner]]], normal, distance, area * 0.5);
+	}
+
+	//edges used by one triangle are open borders and edges used by more than two are non manifold, both stay in place
+	std::vector<std::pair<uint32_t, uint32_t>> edges;
+	for (size_t t = 0; t < mesh.triangles.size(); t += 3)
+	{
+		for (int c = 0; c < 3; c++)
+		{
+			uint32_t a = mesh.positionOf[mesh.triangles[t + c]];
+			uint32_t b = mesh.positionOf[mesh.triangles[t + (c + 1) % 3]];
+			if (a != b)
+				edges.push_back({ std::min(a, b), std::max(a, b) });
+		}
+	}
+	std::sort(edges.begin(), edges.end());
+
+	mesh.locked.assign(positionCount, false);
+	for (size_t i = 0; i < edges.size();)
+	{
+		size_t j = i;
+		while (j < edges.size() && edges[j] == edges[i])
+			j++;
+
+		if (j - i != 2)
+		{
+			mesh.locked[edges[i].first] = true;
+			mesh.locked[edges[i].second] = true;
+		}
+		i = j;
+	}
+
+	double maxError = 0.0;
+
+	std::vector<Collapse> collapses;
+	std::vector<std::pair<uint32_t, uint32_t>> wedgePairs;
+	std::vector<uint32_t> remap(vertexCount);
+	std::vector<bool> touched(positionCount);
+
+	while (mesh.triangles.size() > targetIndexCount)
+	{
+		build_position_triangles(mesh);
+
+		//unique edges of the current mesh
+		edges.clear();
+		for (size_t t = 0; t < mesh.triangles.size(); t += 3)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				uint32_t a = mesh.positionOf[mesh.triangles[t + c]];
+				uint32_t b = mesh.positionOf[mesh.triangles[t + (c + 1) % 3]];
+				edges.push_back({ std::min(a, b), std::max(a, b) });
+			}
+		}
+		std::sort(edges.begin(), edges.end());
+		edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+
+		//cheapest valid direction of every edge
+		collapses.clear();
+		for (const auto& edge : edges)
+		{
+			Collapse forward, backward;
+			bool forwardValid = evaluate_collapse(mesh, edge.first, edge.second, forward, wedgePairs);
+			bool backwardValid = evaluate_collapse(mesh, edge.second, edge.first, backward, wedgePairs);
+
+			if (forwardValid && (!backwardValid || forward.cost <= backward.cost))
+				collapses.push_back(forward);
+			else if (backwardValid)
+				collapses.push_back(backward);
+		}
+
+		if (collapses.empty())
+			break;
+
+		std::stable_sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) {
+			return a.cost < b.cost;
+		});
+
+		for (size_t v = 0; v < vertexCount; v++)
+			remap[v] = uint32_t(v);
+		std::fill(touched.begin(), touched.end(), false);
+
+		//only the cheaper part of the list goes in one pass, the rest gets re-evaluated on the simplified mesh
+		size_t limit = std::max<size_t>(collapses.size() / 3, 1);
+		size_t triangleEstimate = mesh.triangles.size() / 3;
+		size_t applied = 0;
+
+		for (size_t i = 0; i < limit && triangleEstimate * 3 > targetIndexCount; i++)
+		{
+			const Collapse& collapse = collapses[i];
+
+			//every triangle around from has to be unchanged for the evaluation to hold
+			if (touched[collapse.from] || touched[collapse.to])
+				continue;
+
+			Collapse current;
+			if (!evaluate_collapse(mesh, collapse.from, collapse.to, current, wedgePairs))
+				continue;
+
+			for (const auto& pair : wedgePairs)
+				remap[pair.first] = pair.second;
+
+			add_quadric(mesh.quadrics[collapse.to], mesh.quadrics[collapse.from]);
+
+			for (uint32_t a = mesh.triangleOffsets[collapse.from]; a < mesh.triangleOffsets[collapse.from + 1]; a++)
+			{
+				const uint32_t* triangle = &mesh.triangles[mesh.positionTriangles[a] * 3];
+
+				bool removed = false;
+				for (int c = 0; c < 3; c++)
+				{
+					uint32_t position = mesh.positionOf[triangle[c]];
+					touched[position] = true;
+					removed |= position == collapse.to;
+				}
+
+				if (removed)
+					triangleEstimate--;
+			}
+
+			maxError = std::max(maxError, current.positionError);
+			applied++;
+		}
+
+		if (applied == 0)
+			break;
+
+		//apply the collapses, triangles that lost an edge are dropped
+		size_t write = 0;
+		for (size_t t = 0; t < mesh.triangles.size(); t += 3)
+		{
+			uint32_t a = remap[mesh.triangles[t + 0]];
+			uint32_t b = remap[mesh.triangles[t + 1]];
+			uint32_t c = remap[mesh.triangles[t + 2]];
+
+			uint32_t pa = mesh.positionOf[a], pb = mesh.positionOf[b], pc = mesh.positionOf[c];
+			if (pa == pb || pb == pc || pa == pc)
+				continue;
+
+			mesh.triangles[write++] = a;
+			mesh.triangles[write++] = b;
+			mesh.triangles[write++] = c;
+		}
+		mesh.triangles.resize(write);
+	}
+
+	outIndices = mesh.triangles;
+
+	return float(std::sqrt(maxError));
+}
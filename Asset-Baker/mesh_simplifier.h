@@ -0,0 +1,20 @@
+#pragma once
+
+#include <mesh_asset.h>
+
+#include <cstdint>
+#include <vector>
+
+struct SimplifySettings
+{
+	//how much a uv or normal difference of 1 costs, relative to a position error of the mesh radius
+	float attributeWeight = 0.05f;
+};
+
+//edge collapse simplification driven by quadric error metrics (Garland and Heckbert 1997).
+//vertices only ever collapse onto existing ones so the vertex buffer is shared with the source indices,
+//uv seams collapse together, normal seams collapse like other edges with the normal change weighted into
+//the cost, and open borders are kept in place.
+//returns the object space error of the result
+float simplify_mesh(const assets::Vertex_f32_PNCV* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount,
+	size_t targetIndexCount, const SimplifySettings& settings, std::vector<uint32_t>& outIndices);
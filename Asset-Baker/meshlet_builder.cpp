@@ -0,0 +1,268 @@
+#include <meshlet_builder.h>
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#include <glm/glm.hpp>
+
+namespace {
+
+	constexpr uint32_t NoLocalIndex = ~0u;
+
+	glm::vec3 vertex_position(const assets::Vertex_f32_PNCV* vertices, uint32_t index)
+	{
+		return glm::vec3{ vertices[index].position[0], vertices[index].position[1], vertices[index].position[2] };
+	}
+
+	//bounding sphere and normal cone, the cone math follows meshoptimizer's meshopt_computeMeshletBounds
+	void compute_meshlet_bounds(const assets::Vertex_f32_PNCV* vertices, const uint32_t* meshletVertices, const uint8_t* meshletTriangles, assets::Meshlet& meshlet)
+	{
+		glm::vec3 minimum{ FLT_MAX }, maximum{ -FLT_MAX };
+		for (uint32_t i = 0; i < meshlet.vertexCount; i++)
+		{
+			glm::vec3 position = vertex_position(vertices, meshletVertices[i]);
+			minimum = glm::min(minimum, position);
+			maximum = glm::max(maximum, position);
+		}
+
+		glm::vec3 center = (minimum + maximum) * 0.5f;
+
+		float radius2 = 0.f;
+		for (uint32_t i = 0; i < meshlet.vertexCount; i++)
+		{
+			glm::vec3 offset = vertex_position(vertices, meshletVertices[i]) - center;
+			radius2 = std::max(radius2, glm::dot(offset, offset));
+		}
+
+		memcpy(meshlet.center, &center, sizeof(float) * 3);
+		meshlet.radius = std::sqrt(radius2);
+
+		//same winding as the normals the baker generates for the vertices
+		std::vector<glm::vec3> normals;
+		std::vector<glm::vec3> corners;
+		glm::vec3 normalSum{ 0.f };
+		for (uint32_t t = 0; t < meshlet.triangleCount; t++)
+		{
+			const uint8_t* triangle = meshletTriangles + t * 3;
+			glm::vec3 p0 = vertex_position(vertices, meshletVertices[triangle[0]]);
+			glm::vec3 p1 = vertex_position(vertices, meshletVertices[triangle[1]]);
+			glm::vec3 p2 = vertex_position(vertices, meshletVertices[triangle[2]]);
+
+			glm::vec3 normal = glm::cross(p2 - p0, p1 - p0);
+			float length = glm::length(normal);
+			if (length <= 0.f)
+				continue;
+
+			normals.push_back(normal / length);
+			corners.push_back(p0);
+			normalSum += normal / length;
+		}
+
+		//no cone by default, the cutoff of 1 never culls
+		memcpy(meshlet.coneApex, &center, sizeof(float) * 3);
+		memset(meshlet.coneAxis, 0, sizeof(meshlet.coneAxis));
+		meshlet.coneCutoff = 1.f;
+
+		float sumLength = glm::length(normalSum);
+		if (normals.empty() || sumLength <= 0.f)
+			return;
+
+		glm::vec3 axis = normalSum / sumLength;
+
+		float minimumDot = 1.f;
+		for (const glm::vec3& normal : normals)
+			minimumDot = std::min(minimumDot, glm::dot(axis, normal));
+
+		//the cone spans close to a half sphere, culling would almost never succeed
+		if (minimumDot <= 0.1f)
+			return;
+
+		//move the apex back until every triangle plane is in front of it
+		float maximumT = 0.f;
+		for (size_t i = 0; i < normals.size(); i++)
+		{
+			float distance = glm::dot(center - corners[i], normals[i]);
+			float alignment = glm::dot(axis, normals[i]);
+			maximumT = std::max(maximumT, distance / alignment);
+		}
+
+		glm::vec3 apex = center - axis * maximumT;
+
+		memcpy(meshlet.coneApex, &apex, sizeof(float) * 3);
+		memcpy(meshlet.coneAxis, &axis, sizeof(float) * 3);
+		meshlet.coneCutoff = std::sqrt(1.f - minimumDot * minimumDot);
+	}
+}
+
+void build_meshlets(const assets::Vertex_f32_PNCV* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount,
+	const MeshletSettings& settings, assets::MeshInfo& info, std::vector<char>& outMeshletData)
+{
+	uint32_t maxVertices = std::min(std::max(settings.maxVertices, 3u), MaxMeshletVertices);
+	uint32_t maxTriangles = std::min(std::max(settings.maxTriangles, 1u), MaxMeshletTriangles);
+
+	size_t triangleCount = indexCount / 3;
+
+	//triangles that use each vertex
+	std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		adjacencyOffsets[indices[i] + 1]++;
+	for (size_t v = 0; v < vertexCount; v++)
+		adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+
+	std::vector<uint32_t> adjacency(triangleCount * 3);
+	std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+	for (size_t i = 0; i < triangleCount * 3; i++)
+		adjacency[fill[indices[i]]++] = uint32_t(i / 3);
+
+	std::vector<assets::Meshlet> meshlets;
+	std::vector<uint32_t> meshletVertices;
+	std::vector<uint8_t> meshletTriangles;
+
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<uint32_t> localIndex(vertexCount, NoLocalIndex);
+	std::vector<uint32_t> candidates;
+
+	assets::Meshlet meshlet = {};
+	glm::vec3 positionSum{ 0.f };
+
+	auto centroid_distance = [&](uint32_t triangle) {
+		const uint32_t* corners = indices + triangle * 3;
+		glm::vec3 centroid = (vertex_position(vertices, corners[0]) + vertex_position(vertices, corners[1]) + vertex_position(vertices, corners[2])) / 3.f;
+		glm::vec3 offset = centroid - positionSum / float(std::max(meshlet.vertexCount, 1u));
+		return glm::dot(offset, offset);
+	};
+
+	auto new_vertices = [&](uint32_t triangle) {
+		const uint32_t* corners = indices + triangle * 3;
+		uint32_t count = 0;
+		for (int c = 0; c < 3; c++)
+		{
+			bool repeated = (c > 0 && corners[c] == corners[0]) || (c > 1 && corners[c] == corners[1]);
+			if (localIndex[corners[c]] == NoLocalIndex && !repeated)
+				count++;
+		}
+		return count;
+	};
+
+	auto flush = [&]() {
+		if (meshlet.triangleCount == 0)
+			return;
+
+		compute_meshlet_bounds(vertices, meshletVertices.data() + meshlet.vertexOffset, meshletTriangles.data() + meshlet.triangleOffset * 3, meshlet);
+		meshlets.push_back(meshlet);
+
+		for (uint32_t i = 0; i < meshlet.vertexCount; i++)
+			localIndex[meshletVertices[meshlet.vertexOffset + i]] = NoLocalIndex;
+
+		meshlet = {};
+		positionSum = glm::vec3{ 0.f };
+		meshlet.vertexOffset = uint32_t(meshletVertices.size());
+		meshlet.triangleOffset = uint32_t(meshletTriangles.size() / 3);
+		candidates.clear();
+	};
+
+	size_t seed = 0;
+	for (size_t emittedCount = 0; emittedCount < triangleCount; emittedCount++)
+	{
+		//prefer the connected triangle that adds the fewest vertices, then the one closest to the meshlet so it stays round.
+		//remaining ties go to the lowest index so the result is stable
+		uint32_t best = ~0u;
+		uint32_t bestCost = ~0u;
+		float bestDistance = FLT_MAX;
+		for (uint32_t candidate : candidates)
+		{
+			if (emitted[candidate])
+				continue;
+
+			uint32_t cost = new_vertices(candidate);
+			if (meshlet.vertexCount + cost > maxVertices || cost > bestCost)
+				continue;
+
+			float distance = centroid_distance(candidate);
+			if (cost < bestCost || distance < bestDistance || (distance == bestDistance && candidate < best))
+			{
+				best = candidate;
+				bestCost = cost;
+				bestDistance = distance;
+			}
+		}
+
+		if (best == ~0u)
+		{
+			//nothing connected fits, continue with the next triangle in index order
+			while (emitted[seed])
+				seed++;
+			best = uint32_t(seed);
+			bestCost = new_vertices(best);
+		}
+
+		if (meshlet.triangleCount == maxTriangles || meshlet.vertexCount + bestCost > maxVertices)
+		{
+			flush();
+			bestCost = new_vertices(best);
+		}
+
+		const uint32_t* corners = indices + best * 3;
+		for (int c = 0; c < 3; c++)
+		{
+			uint32_t vertex = corners[c];
+			if (localIndex[vertex] == NoLocalIndex)
+			{
+				localIndex[vertex] = meshlet.vertexCount++;
+				meshletVertices.push_back(vertex);
+				positionSum += vertex_position(vertices, vertex);
+			}
+			meshletTriangles.push_back(uint8_t(localIndex[vertex]));
+		}
+
+		meshlet.triangleCount++;
+		emitted[best] = true;
+
+		for (int c = 0; c < 3; c++)
+		{
+			uint32_t vertex = corners[c];
+			for (uint32_t a = adjacencyOffsets[vertex]; a < adjacencyOffsets[vertex + 1]; a++)
+			{
+				if (!emitted[adjacency[a]])
+					candidates.push_back(adjacency[a]);
+			}
+		}
+
+		//drop the triangles that got emitted so the list stays short
+		if (candidates.size() > maxTriangles * 16)
+		{
+			candidates.erase(std::remove_if(candidates.begin(), candidates.end(), [&](uint32_t t) { return emitted[t]; }), candidates.end());
+			std::sort(candidates.begin(), candidates.end());
+			candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+		}
+	}
+
+	flush();
+
+	info.meshletCount = uint32_t(meshlets.size());
+	info.meshletVertexCount = uint32_t(meshletVertices.size());
+	info.meshletTriangleCount = uint32_t(meshletTriangles.size() / 3);
+
+	outMeshletData.resize(assets::meshlet_buffer_size(info));
+
+	char* output = outMeshletData.data();
+	memcpy(output, meshlets.data(), meshlets.size() * sizeof(assets::Meshlet));
+	output += meshlets.size() * sizeof(assets::Meshlet);
+	if (info.indexSize == 2)
+	{
+		for (uint32_t vertex : meshletVertices)
+		{
+			uint16_t shortVertex = uint16_t(vertex);
+			memcpy(output, &shortVertex, sizeof(uint16_t));
+			output += sizeof(uint16_t);
+		}
+	}
+	else
+	{
+		memcpy(output, meshletVertices.data(), meshletVertices.size() * sizeof(uint32_t));
+		output += meshletVertices.size() * sizeof(uint32_t);
+	}
+	memcpy(output, meshletTriangles.data(), meshletTriangles.size());
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <mesh_asset.h>
+
+#include <cstdint>
+#include <vector>
+
+//local indices are 8 bit, so a meshlet can not reference more than 255 vertices
+constexpr uint32_t MaxMeshletVertices = 255;
+//the most primitives a mesh shader workgroup can output
+constexpr uint32_t MaxMeshletTriangles = 512;
+
+struct MeshletSettings
+{
+	uint32_t maxVertices = 64;
+	uint32_t maxTriangles = 124;
+};
+
+//splits an indexed triangle list into meshlets, each one grows through the triangles that share its vertices.
+//fills the meshlet counts of info and writes the data in the layout read by assets::read_meshlets,
+//the vertex indices are written with info.indexSize bytes
+void build_meshlets(const assets::Vertex_f32_PNCV* vertices, size_t vertexCount, const uint32_t* indices, size_t indexCount,
+	const MeshletSettings& settings, assets::MeshInfo& info, std::vector<char>& outMeshletData);
@@ -0,0 +1,700 @@
+#include <texture_compressor.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BAKER_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+	//one 4x4 block as structure of arrays, so the palette search handles 4 texels per instruction
+	struct BlockTexels
+	{
+		alignas(16) float channels[4][16];
+	};
+
+	struct Endpoints
+	{
+		float low[4];
+		float high[4];
+	};
+
+	void load_block(const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t blockX, uint32_t blockY, BlockTexels& block)
+	{
+		for (uint32_t y = 0; y < 4; y++)
+		{
+			uint32_t sourceY = std::min(blockY * 4 + y, height - 1);
+			for (uint32_t x = 0; x < 4; x++)
+			{
+				uint32_t sourceX = std::min(blockX * 4 + x, width - 1);
+				const uint8_t* texel = pixels + (size_t(sourceY) * width + sourceX) * 4;
+
+				for (int c = 0; c < 4; c++)
+					block.channels[c][y * 4 + x] = texel[c];
+			}
+		}
+	}
+
+	//picks the closest palette entry for every texel over channels [firstChannel, lastChannel), returns the squared error
+	float select_indices(const BlockTexels& block, const float (*palette)[4], int paletteSize, int firstChannel, int lastChannel, uint8_t indices[16])
+	{
+		float errors[16];
+
+#ifdef BAKER_USE_SSE2
+		for (int i = 0; i < 16; i += 4)
+		{
+			__m128 best = _mm_set1_ps(FLT_MAX);
+			__m128i bestIndex = _mm_setzero_si128();
+
+			for (int p = 0; p < paletteSize; p++)
+			{
+				__m128 distance = _mm_setzero_ps();
+				for (int c = firstChannel; c < lastChannel; c++)
+				{
+					__m128 diff = _mm_sub_ps(_mm_load_ps(&block.channels[c][i]), _mm_set1_ps(palette[p][c]));
+					distance = _mm_add_ps(distance, _mm_mul_ps(diff, diff));
+				}
+
+				__m128i closer = _mm_castps_si128(_mm_cmplt_ps(distance, best));
+				best = _mm_min_ps(distance, best);
+				bestIndex = _mm_or_si128(_mm_andnot_si128(closer, bestIndex), _mm_and_si128(closer, _mm_set1_epi32(p)));
+			}
+
+			alignas(16) int32_t lanes[4];
+			_mm_store_si128((__m128i*)lanes, bestIndex);
+			_mm_storeu_ps(&errors[i], best);
+
+			for (int lane = 0; lane < 4; lane++)
+				indices[i + lane] = uint8_t(lanes[lane]);
+		}
+#else
+		for (int i = 0; i < 16; i++)
+		{
+			float best = FLT_MAX;
+			int bestIndex = 0;
+
+			for (int p = 0; p < paletteSize; p++)
+			{
+				float distance = 0.f;
+				for (int c = firstChannel; c < lastChannel; c++)
+				{
+					float diff = block.channels[c][i] - palette[p][c];
+					distance += diff * diff;
+				}
+
+				if (distance < best)
+				{
+					best = distance;
+					bestIndex = p;
+				}
+			}
+
+			errors[i] = best;
+			indices[i] = uint8_t(bestIndex);
+		}
+#endif
+
+		float total = 0.f;
+		for (int i = 0; i < 16; i++)
+			total += errors[i];
+		return total;
+	}
+
+	//end points along the main axis of the texel distribution, or the bounding box for the fast path
+	void fit_endpoints(const BlockTexels& block, int firstChannel, int lastChannel, BlockQuality quality, Endpoints& endpoints)
+	{
+		float minimum[4], maximum[4], mean[4];
+		for (int c = firstChannel; c < lastChannel; c++)
+		{
+			minimum[c] = maximum[c] = block.channels[c][0];
+			mean[c] = 0.f;
+			for (int i = 0; i < 16; i++)
+			{
+				minimum[c] = std::min(minimum[c], block.channels[c][i]);
+				maximum[c] = std::max(maximum[c], block.channels[c][i]);
+				mean[c] += block.channels[c][i];
+			}
+			mean[c] /= 16.f;
+		}
+
+		if (quality != BlockQuality::Fast)
+		{
+			float covariance[4][4] = {};
+			for (int i = 0; i < 16; i++)
+			{
+				for (int a = firstChannel; a < lastChannel; a++)
+				{
+					for (int b = firstChannel; b < lastChannel; b++)
+						covariance[a][b] += (block.channels[a][i] - mean[a]) * (block.channels[b][i] - mean[b]);
+				}
+			}
+
+			//power iteration from the bounding box diagonal
+			float axis[4];
+			for (int c = firstChannel; c < lastChannel; c++)
+				axis[c] = maximum[c] - minimum[c];
+
+			float length = 0.f;
+			for (int iteration = 0; iteration < 8; iteration++)
+			{
+				float next[4];
+				length = 0.f;
+				for (int a = firstChannel; a < lastChannel; a++)
+				{
+					next[a] = 0.f;
+					for (int b = firstChannel; b < lastChannel; b++)
+						next[a] += covariance[a][b] * axis[b];
+					length = std::max(length, std::abs(next[a]));
+				}
+
+				if (length < 1e-6f)
+					break;
+
+				for (int c = firstChannel; c < lastChannel; c++)
+					axis[c] = next[c] / length;
+			}
+
+			if (length >= 1e-6f)
+			{
+				float norm = 0.f;
+				for (int c = firstChannel; c < lastChannel; c++)
+					norm += axis[c] * axis[c];
+				norm = std::sqrt(norm);
+
+				float lowT = FLT_MAX, highT = -FLT_MAX;
+				for (int i = 0; i < 16; i++)
+				{
+					float t = 0.f;
+					for (int c = firstChannel; c < lastChannel; c++)
+						t += (block.channels[c][i] - mean[c]) * axis[c] / norm;
+					lowT = std::min(lowT, t);
+					highT = std::max(highT, t);
+				}
+
+				for (int c = firstChannel; c < lastChannel; c++)
+				{
+					endpoints.low[c] = std::min(std::max(mean[c] + axis[c] / norm * lowT, 0.f), 255.f);
+					endpoints.high[c] = std::min(std::max(mean[c] + axis[c] / norm * highT, 0.f), 255.f);
+				}
+				return;
+			}
+		}
+
+		//inset the box a little, the extremes are rarely worth an exact palette entry
+		for (int c = firstChannel; c < lastChannel; c++)
+		{
+			float inset = (maximum[c] - minimum[c]) / 16.f;
+			endpoints.low[c] = minimum[c] + inset;
+			endpoints.high[c] = maximum[c] - inset;
+		}
+	}
+
+	//least squares end points for a fixed index assignment, weights go from 0 at low to 1 at high
+	bool refine_endpoints(const BlockTexels& block, int firstChannel, int lastChannel, const uint8_t indices[16], const float* weights, Endpoints& endpoints)
+	{
+		float a = 0.f, b = 0.f, c = 0.f;
+		float lowSum[4] = {}, highSum[4] = {};
+
+		for (int i = 0; i < 16; i++)
+		{
+			float w = weights[indices[i]];
+			a += (1.f - w) * (1.f - w);
+			b += (1.f - w) * w;
+			c += w * w;
+
+			for (int ch = firstChannel; ch < lastChannel; ch++)
+			{
+				lowSum[ch] += (1.f - w) * block.channels[ch][i];
+				highSum[ch] += w * block.channels[ch][i];
+			}
+		}
+
+		float determinant = a * c - b * b;
+		if (std::abs(determinant) < 1e-6f)
+			return false;
+
+		for (int ch = firstChannel; ch < lastChannel; ch++)
+		{
+			endpoints.low[ch] = std::min(std::max((c * lowSum[ch] - b * highSum[ch]) / determinant, 0.f), 255.f);
+			endpoints.high[ch] = std::min(std::max((a * highSum[ch] - b * lowSum[ch]) / determinant, 0.f), 255.f);
+		}
+		return true;
+	}
+
+	int refinement_passes(BlockQuality quality)
+	{
+		switch (quality)
+		{
+			case BlockQuality::Fast:
+				return 0;
+			case BlockQuality::Normal:
+				return 1;
+			default:
+				return 3;
+		}
+	}
+
+	struct BitWriter
+	{
+		uint8_t* data;
+		uint32_t position{ 0 };
+
+		void write(uint32_t value, uint32_t bits)
+		{
+			for (uint32_t i = 0; i < bits; i++, position++)
+			{
+				if ((value >> i) & 1)
+					data[position >> 3] |= uint8_t(1 << (position & 7));
+			}
+		}
+	};
+
+	// BC1 ------------------------------------------------------------------------
+
+	uint16_t pack_565(const float color[4])
+	{
+		uint32_t r = uint32_t(std::lround(color[0] * 31.f / 255.f));
+		uint32_t g = uint32_t(std::lround(color[1] * 63.f / 255.f));
+		uint32_t b = uint32_t(std::lround(color[2] * 31.f / 255.f));
+		return uint16_t((r << 11) | (g << 5) | b);
+	}
+
+	void unpack_565(uint16_t packed, float color[4])
+	{
+		uint32_t r = (packed >> 11) & 31;
+		uint32_t g = (packed >> 5) & 63;
+		uint32_t b = packed & 31;
+		color[0] = float((r << 3) | (r >> 2));
+		color[1] = float((g << 2) | (g >> 4));
+		color[2] = float((b << 3) | (b >> 2));
+		color[3] = 255.f;
+	}
+
+	//color part of bc1 and bc3. punch through blocks use the 3 color mode with index 3 as transparent black
+	void encode_color_block(const BlockTexels& block, BlockQuality quality, bool punchThrough, uint8_t* output)
+	{
+		static const float fourColorWeights[4] = { 0.f, 1.f, 1.f / 3.f, 2.f / 3.f };
+		static const float threeColorWeights[4] = { 0.f, 1.f, 0.5f, 0.f };
+
+		bool transparent[16];
+		bool anyTransparent = false;
+		for (int i = 0; i < 16; i++)
+		{
+			transparent[i] = punchThrough && block.channels[3][i] < 128.f;
+			anyTransparent |= transparent[i];
+		}
+
+		Endpoints endpoints;
+		fit_endpoints(block, 0, 3, quality, endpoints);
+
+		uint16_t bestColors[2] = { 0, 0 };
+		uint8_t bestIndices[16] = {};
+		float bestError = FLT_MAX;
+
+		for (int pass = 0; pass <= refinement_passes(quality); pass++)
+		{
+			uint16_t color0 = pack_565(endpoints.high);
+			uint16_t color1 = pack_565(endpoints.low);
+
+			//the order of the two colors selects the block mode
+			bool swapped = anyTransparent ? color0 > color1 : color0 < color1;
+			if (swapped)
+				std::swap(color0, color1);
+
+			float palette[4][4];
+			unpack_565(color0, palette[0]);
+			unpack_565(color1, palette[1]);
+
+			int paletteSize = 4;
+			for (int c = 0; c < 3; c++)
+			{
+				if (anyTransparent)
+				{
+					palette[2][c] = (palette[0][c] + palette[1][c]) / 2.f;
+				}
+				else
+				{
+					palette[2][c] = (2.f * palette[0][c] + palette[1][c]) / 3.f;
+					palette[3][c] = (palette[0][c] + 2.f * palette[1][c]) / 3.f;
+				}
+			}
+			if (anyTransparent)
+				paletteSize = 3;
+
+			uint8_t indices[16];
+			float error = select_indices(block, palette, color0 == color1 ? 1 : paletteSize, 0, 3, indices);
+
+			if (anyTransparent)
+			{
+				for (int i = 0; i < 16; i++)
+				{
+					if (transparent[i])
+						indices[i] = 3;
+				}
+			}
+
+			if (error < bestError)
+			{
+				bestError = error;
+				bestColors[0] = color0;
+				bestColors[1] = color1;
+				memcpy(bestIndices, indices, 16);
+			}
+
+			//weights are relative to the low end point, which is color1 unless the pair was swapped
+			uint8_t lowToHigh[16];
+			for (int i = 0; i < 16; i++)
+				lowToHigh[i] = indices[i];
+
+			float weights[4];
+			const float* modeWeights = anyTransparent ? threeColorWeights : fourColorWeights;
+			for (int w = 0; w < 4; w++)
+				weights[w] = swapped ? modeWeights[w] : 1.f - modeWeights[w];
+
+			BlockTexels opaque = block;
+			if (anyTransparent)
+			{
+				//transparent texels do not pull the end points, park them on the low end point
+				for (int i = 0; i < 16; i++)
+				{
+					if (transparent[i])
+					{
+						for (int c = 0; c < 3; c++)
+							opaque.channels[c][i] = swapped ? palette[0][c] : palette[1][c];
+						lowToHigh[i] = swapped ? 0 : 1;
+					}
+				}
+			}
+
+			if (!refine_endpoints(opaque, 0, 3, lowToHigh, weights, endpoints))
+				break;
+		}
+
+		memcpy(output, &bestColors[0], 2);
+		memcpy(output + 2, &bestColors[1], 2);
+
+		uint32_t packedIndices = 0;
+		for (int i = 0; i < 16; i++)
+			packedIndices |= uint32_t(bestIndices[i]) << (i * 2);
+		memcpy(output + 4, &packedIndices, 4);
+	}
+
+	// BC3 alpha ------------------------------------------------------------------
+
+	void encode_alpha_block(const BlockTexels& block, BlockQuality quality, uint8_t* output)
+	{
+		static const float weights[8] = { 0.f, 1.f, 1.f / 7.f, 2.f / 7.f, 3.f / 7.f, 4.f / 7.f, 5.f / 7.f, 6.f / 7.f };
+
+		float minimum = 255.f, maximum = 0.f;
+		for (int i = 0; i < 16; i++)
+		{
+			minimum = std::min(minimum, block.channels[3][i]);
+			maximum = std::max(maximum, block.channels[3][i]);
+		}
+
+		Endpoints endpoints;
+		endpoints.low[3] = minimum;
+		endpoints.high[3] = maximum;
+
+		uint8_t bestAlpha[2] = { uint8_t(maximum), uint8_t(maximum) };
+		uint8_t bestIndices[16] = {};
+		float bestError = FLT_MAX;
+
+		for (int pass = 0; pass <= refinement_passes(quality); pass++)
+		{
+			//alpha0 > alpha1 selects the 8 value mode
+			uint8_t alpha0 = uint8_t(std::lround(endpoints.high[3]));
+			uint8_t alpha1 = uint8_t(std::lround(endpoints.low[3]));
+			if (alpha0 <= alpha1)
+				break;
+
+			float palette[8][4];
+			palette[0][3] = alpha0;
+			palette[1][3] = alpha1;
+			for (int p = 2; p < 8; p++)
+				palette[p][3] = float(((8 - p) * alpha0 + (p - 1) * alpha1) / 7);
+
+			uint8_t indices[16];
+			float error = select_indices(block, palette, 8, 3, 4, indices);
+			if (error < bestError)
+			{
+				bestError = error;
+				bestAlpha[0] = alpha0;
+				bestAlpha[1] = alpha1;
+				memcpy(bestIndices, indices, 16);
+			}
+
+			//the weights above go towards alpha1, the low end point
+			float lowToHigh[8];
+			for (int w = 0; w < 8; w++)
+				lowToHigh[w] = 1.f - weights[w];
+
+			if (!refine_endpoints(block, 3, 4, indices, lowToHigh, endpoints))
+				break;
+		}
+
+		output[0] = bestAlpha[0];
+		output[1] = bestAlpha[1];
+
+		uint64_t packedIndices = 0;
+		for (int i = 0; i < 16; i++)
+			packedIndices |= uint64_t(bestIndices[i]) << (i * 3);
+		for (int i = 0; i < 6; i++)
+			output[2 + i] = uint8_t(packedIndices >> (i * 8));
+	}
+
+	// BC7 ------------------------------------------------------------------------
+
+	//mode 6: one subset, rgba end points with 7 bits plus one shared p-bit each, 4 bit indices
+	const uint32_t Bc7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+	struct Bc7Endpoint
+	{
+		uint32_t value[4];
+		uint32_t pbit;
+	};
+
+	Bc7Endpoint quantize_bc7(const float color[4], uint32_t pbit)
+	{
+		Bc7Endpoint endpoint;
+		endpoint.pbit = pbit;
+		for (int c = 0; c < 4; c++)
+		{
+			int q = int(std::lround((color[c] - float(pbit)) / 2.f));
+			endpoint.value[c] = uint32_t(std::min(std::max(q, 0), 127));
+		}
+		return endpoint;
+	}
+
+	float quantize_error(const Bc7Endpoint& endpoint, const float color[4])
+	{
+		float error = 0.f;
+		for (int c = 0; c < 4; c++)
+		{
+			float diff = float(endpoint.value[c] * 2 + endpoint.pbit) - color[c];
+			error += diff * diff;
+		}
+		return error;
+	}
+
+	float evaluate_bc7(const BlockTexels& block, const Bc7Endpoint& low, const Bc7Endpoint& high, uint8_t indices[16])
+	{
+		float palette[16][4];
+		for (int p = 0; p < 16; p++)
+		{
+			for (int c = 0; c < 4; c++)
+			{
+				uint32_t e0 = low.value[c] * 2 + low.pbit;
+				uint32_t e1 = high.value[c] * 2 + high.pbit;
+				palette[p][c] = float(((64 - Bc7Weights[p]) * e0 + Bc7Weights[p] * e1 + 32) >> 6);
+			}
+		}
+
+		return select_indices(block, palette, 16, 0, 4, indices);
+	}
+
+	void encode_bc7_block(const BlockTexels& block, BlockQuality quality, uint8_t* output)
+	{
+		float weights[16];
+		for (int w = 0; w < 16; w++)
+			weights[w] = Bc7Weights[w] / 64.f;
+
+		Endpoints endpoints;
+		fit_endpoints(block, 0, 4, quality, endpoints);
+
+		Bc7Endpoint bestLow{}, bestHigh{};
+		uint8_t bestIndices[16] = {};
+		float bestError = FLT_MAX;
+
+		for (int pass = 0; pass <= refinement_passes(quality); pass++)
+		{
+			Bc7Endpoint low, high;
+			uint8_t indices[16];
+			float error = FLT_MAX;
+
+			if (quality == BlockQuality::High)
+			{
+				for (uint32_t combination = 0; combination < 4; combination++)
+				{
+					Bc7Endpoint candidateLow = quantize_bc7(endpoints.low, combination & 1);
+					Bc7Endpoint candidateHigh = quantize_bc7(endpoints.high, combination >> 1);
+
+					uint8_t candidateIndices[16];
+					float candidateError = evaluate_bc7(block, candidateLow, candidateHigh, candidateIndices);
+					if (candidateError < error)
+					{
+						error = candidateError;
+						low = candidateLow;
+						high = candidateHigh;
+						memcpy(indices, candidateIndices, 16);
+					}
+				}
+			}
+			else
+			{
+				//pick each p-bit on its own end point error
+				Bc7Endpoint low0 = quantize_bc7(endpoints.low, 0), low1 = quantize_bc7(endpoints.low, 1);
+				Bc7Endpoint high0 = quantize_bc7(endpoints.high, 0), high1 = quantize_bc7(endpoints.high, 1);
+
+				low = quantize_error(low0, endpoints.low) <= quantize_error(low1, endpoints.low) ? low0 : low1;
+				high = quantize_error(high0, endpoints.high) <= quantize_error(high1, endpoints.high) ? high0 : high1;
+				error = evaluate_bc7(block, low, high, indices);
+			}
+
+			if (error < bestError)
+			{
+				bestError = error;
+				bestLow = low;
+				bestHigh = high;
+				memcpy(bestIndices, indices, 16);
+			}
+
+			if (!refine_endpoints(block, 0, 4, indices, weights, endpoints))
+				break;
+		}
+
+		//the msb of the first index is implied 0, swap the end points to get there
+		if (bestIndices[0] & 8)
+		{
+			std::swap(bestLow, bestHigh);
+			for (int i = 0; i < 16; i++)
+				bestIndices[i] = uint8_t(15 - bestIndices[i]);
+		}
+
+		memset(output, 0, 16);
+		BitWriter writer{ output };
+
+		writer.write(1 << 6, 7);
+		for (int c = 0; c < 4; c++)
+		{
+			writer.write(bestLow.value[c], 7);
+			writer.write(bestHigh.value[c], 7);
+		}
+		writer.write(bestLow.pbit, 1);
+		writer.write(bestHigh.pbit, 1);
+
+		writer.write(bestIndices[0], 3);
+		for (int i = 1; i < 16; i++)
+			writer.write(bestIndices[i], 4);
+	}
+
+	void encode_block(const BlockTexels& block, assets::TextureFormat format, BlockQuality quality, uint8_t* output)
+	{
+		switch (format)
+		{
+			case assets::TextureFormat::BC1:
+				encode_color_block(block, quality, true, output);
+				break;
+			case assets::TextureFormat::BC3:
+				encode_alpha_block(block, quality, output);
+				encode_color_block(block, quality, false, output + 8);
+				break;
+			case assets::TextureFormat::BC7:
+				encode_bc7_block(block, quality, output);
+				break;
+			default:
+				break;
+		}
+	}
+}
+
+bool parse_block_quality(const char* name, BlockQuality& outQuality)
+{
+	if (strcmp(name, "fast") == 0)
+		outQuality = BlockQuality::Fast;
+
+	else if (strcmp(name, "normal") == 0)
+		outQuality = BlockQuality::Normal;
+
+	else if (strcmp(name, "high") == 0)
+		outQuality = BlockQuality::High;
+
+	else
+		return false;
+
+	return true;
+}
+
+void compress_texture_level(const uint8_t* pixels, uint32_t width, uint32_t height, const BlockCompressionSettings& settings, uint8_t* output)
+{
+	uint32_t blocksX = (width + 3) / 4;
+	uint32_t blocksY = (height + 3) / 4;
+	size_t blockBytes = settings.format == assets::TextureFormat::BC1 ? 8 : 16;
+
+	auto encode_rows = [&](uint32_t firstRow, uint32_t lastRow) {
+		BlockTexels block;
+		for (uint32_t y = firstRow; y < lastRow; y++)
+		{
+			for (uint32_t x = 0; x < blocksX; x++)
+			{
+				load_block(pixels, width, height, x, y, block);
+				encode_block(block, settings.format, settings.quality, output + (size_t(y) * blocksX + x) * blockBytes);
+			}
+		}
+	};
+
+	//every block is written to a fixed place so the output does not depend on the thread count
+	if (settings.jobs)
+	{
+		//a few hundred blocks per job so the small mips do not drown in scheduling
+		uint32_t rowsPerJob = std::max(1u, 256 / blocksX);
+
+		assets::JobGroup group;
+		for (uint32_t y = 0; y < blocksY; y += rowsPerJob)
+		{
+			uint32_t lastRow = std::min(blocksY, y + rowsPerJob);
+			settings.jobs->run(group, [=, &encode_rows]() { encode_rows(y, lastRow); });
+		}
+		settings.jobs->wait(group);
+		return;
+	}
+
+	uint32_t threadCount = settings.threadCount ? settings.threadCount : std::max(1u, std::thread::hardware_concurrency());
+	threadCount = std::min(threadCount, blocksY);
+
+	//threads grab one row of blocks at a time
+	std::atomic<uint32_t> nextRow{ 0 };
+	auto worker = [&]() {
+		for (uint32_t y = nextRow++; y < blocksY; y = nextRow++)
+			encode_rows(y, y + 1);
+	};
+
+	std::vector<std::thread> threads;
+	for (uint32_t i = 1; i < threadCount; i++)
+		threads.emplace_back(worker);
+
+	worker();
+
+	for (auto& thread : threads)
+		thread.join();
+}
+
+void compress_texture_levels(std::vector<uint8_t>& levels, assets::TextureInfo& info, const BlockCompressionSettings& settings)
+{
+	std::vector<uint8_t> blocks;
+
+	for (uint32_t i = 0; i < info.levelCount; i++)
+	{
+		assets::TextureLevel& level = info.levels[i];
+
+		uint64_t size = assets::texture_level_size(settings.format, level.width, level.height);
+		uint64_t offset = blocks.size();
+		blocks.resize(offset + size);
+
+		compress_texture_level(levels.data() + level.offset, level.width, level.height, settings, blocks.data() + offset);
+
+		level.offset = offset;
+		level.size = size;
+	}
+
+	info.textureFormat = settings.format;
+	info.textureSize = blocks.size();
+	levels.swap(blocks);
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <texture_asset.h>
+#include <job_system.h>
+
+#include <cstdint>
+#include <vector>
+
+enum class BlockQuality
+{
+	Fast,   //bounding box endpoints
+	Normal, //principal axis endpoints with one refinement pass
+	High    //extra refinement passes, every bc7 p-bit combination is tried
+};
+
+struct BlockCompressionSettings
+{
+	assets::TextureFormat format = assets::TextureFormat::BC7;
+	BlockQuality quality = BlockQuality::Normal;
+	//0 uses every hardware thread, ignored when the rows run on a job system
+	uint32_t threadCount = 0;
+	assets::JobSystem* jobs = nullptr;
+};
+
+bool parse_block_quality(const char* name, BlockQuality& outQuality);
+
+//encodes one RGBA8 level into 4x4 blocks, output has to hold texture_level_size bytes.
+//blocks on the right and bottom edges of sizes that are not a multiple of 4 repeat the last texel
+void compress_texture_level(const uint8_t* pixels, uint32_t width, uint32_t height, const BlockCompressionSettings& settings, uint8_t* output);
+
+//replaces the RGBA8 levels described in info with their block compressed version, offsets and sizes are updated
+void compress_texture_levels(std::vector<uint8_t>& levels, assets::TextureInfo& info, const BlockCompressionSettings& settings);
@@ -0,0 +1,137 @@
+#include <texture_mips.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+	float srgb_to_linear(float c)
+	{
+		return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+	}
+
+	float linear_to_srgb(float c)
+	{
+		return c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.f / 2.4f) - 0.055f;
+	}
+
+	struct FloatImage
+	{
+		uint32_t width;
+		uint32_t height;
+		std::vector<float> texels;
+	};
+
+	//halves one axis, stride picks between a horizontal and a vertical pass
+	void downsample_axis(const FloatImage& source, FloatImage& destination, bool horizontal, MipFilter filter)
+	{
+		uint32_t sourceLength = horizontal ? source.width : source.height;
+		uint32_t length = std::max(1u, sourceLength / 2);
+
+		destination.width = horizontal ? length : source.width;
+		destination.height = horizontal ? source.height : length;
+		destination.texels.assign(size_t(destination.width) * destination.height * 4, 0.f);
+
+		const int boxTaps[] = { 0, 1 };
+		const float boxWeights[] = { 0.5f, 0.5f };
+		const int tentTaps[] = { -1, 0, 1, 2 };
+		const float tentWeights[] = { 0.125f, 0.375f, 0.375f, 0.125f };
+
+		const int* taps = filter == MipFilter::Tent ? tentTaps : boxTaps;
+		const float* weights = filter == MipFilter::Tent ? tentWeights : boxWeights;
+		int tapCount = filter == MipFilter::Tent ? 4 : 2;
+
+		uint32_t lines = horizontal ? source.height : source.width;
+		for (uint32_t line = 0; line < lines; line++)
+		{
+			for (uint32_t i = 0; i < length; i++)
+			{
+				float sum[4] = { 0, 0, 0, 0 };
+				for (int t = 0; t < tapCount; t++)
+				{
+					//clamp to the edge, also covers odd sizes and axes that are already 1 texel
+					int s = std::min(std::max(int(i * 2) + taps[t], 0), int(sourceLength) - 1);
+
+					size_t x = horizontal ? s : line;
+					size_t y = horizontal ? line : s;
+					const float* texel = &source.texels[(y * source.width + x) * 4];
+
+					for (int c = 0; c < 4; c++)
+						sum[c] += texel[c] * weights[t];
+				}
+
+				size_t x = horizontal ? i : line;
+				size_t y = horizontal ? line : i;
+				memcpy(&destination.texels[(y * destination.width + x) * 4], sum, sizeof(sum));
+			}
+		}
+	}
+}
+
+void generate_mips(const uint8_t* pixels, uint32_t width, uint32_t height, MipFilter filter, bool srgb,
+	std::vector<uint8_t>& outPixels, assets::TextureInfo& info)
+{
+	uint32_t levelCount = 1;
+	if (filter != MipFilter::None)
+	{
+		uint32_t largest = std::max(width, height);
+		while ((largest >> levelCount) > 0 && levelCount < assets::MaxTextureLevels)
+			levelCount++;
+	}
+
+	float toLinear[256];
+	for (int i = 0; i < 256; i++)
+		toLinear[i] = srgb ? srgb_to_linear(i / 255.f) : i / 255.f;
+
+	FloatImage current;
+	current.width = width;
+	current.height = height;
+	current.texels.resize(size_t(width) * height * 4);
+	for (size_t i = 0; i < current.texels.size(); i++)
+	{
+		//alpha is always linear
+		current.texels[i] = (i % 4 == 3) ? pixels[i] / 255.f : toLinear[pixels[i]];
+	}
+
+	outPixels.clear();
+	info.levelCount = levelCount;
+
+	for (uint32_t level = 0; level < levelCount; level++)
+	{
+		if (level > 0)
+		{
+			FloatImage halfWidth;
+			downsample_axis(current, halfWidth, true, filter);
+			downsample_axis(halfWidth, current, false, filter);
+		}
+
+		assets::TextureLevel& textureLevel = info.levels[level];
+		textureLevel.width = current.width;
+		textureLevel.height = current.height;
+		textureLevel.offset = outPixels.size();
+		textureLevel.size = size_t(current.width) * current.height * 4;
+		textureLevel.blockSize = 0;
+
+		outPixels.resize(outPixels.size() + textureLevel.size);
+		uint8_t* output = outPixels.data() + textureLevel.offset;
+
+		if (level == 0)
+		{
+			//the base level is kept bit exact
+			memcpy(output, pixels, textureLevel.size);
+			continue;
+		}
+
+		for (size_t i = 0; i < textureLevel.size; i++)
+		{
+			float value = current.texels[i];
+			if (srgb && i % 4 != 3)
+				value = linear_to_srgb(value);
+
+			output[i] = uint8_t(std::lround(std::min(std::max(value, 0.f), 1.f) * 255.f));
+		}
+	}
+
+	info.textureSize = outPixels.size();
+}
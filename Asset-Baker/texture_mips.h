@@ -0,0 +1,18 @@
+#pragma once
+
+#include <texture_asset.h>
+
+#include <cstdint>
+#include <vector>
+
+enum class MipFilter
+{
+	None, //base level only
+	Box,  //2x2 average
+	Tent  //separable 1 3 3 1 kernel, softer but less aliasing
+};
+
+//builds the mip chain of an RGBA8 image, filtering is done in linear space when srgb is set.
+//the levels are written back to back into outPixels and described in info.levels
+void generate_mips(const uint8_t* pixels, uint32_t width, uint32_t height, MipFilter filter, bool srgb,
+	std::vector<uint8_t>& outPixels, assets::TextureInfo& info);
@@ -0,0 +1,199 @@
+#include <asset_archive.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+
+namespace {
+	constexpr uint32_t ArchiveVersion = 1;
+
+	//entries start on this boundary so the fixed asset headers are aligned inside the mapping
+	constexpr uint64_t EntryAlignment = 16;
+
+	void write_padding(std::ofstream& outfile, uint64_t& position, uint64_t alignment)
+	{
+		static const char zeros[EntryAlignment] = {};
+
+		uint64_t padding = (alignment - position % alignment) % alignment;
+		outfile.write(zeros, padding);
+		position += padding;
+	}
+}
+
+uint64_t assets::hash_name(const char* name)
+{
+	//FNV-1a
+	uint64_t hash = 14695981039346656037ull;
+	for (const char* c = name; *c; c++)
+	{
+		hash ^= uint8_t(*c);
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+bool assets::open_archive(const char* path, AssetArchive& outputArchive)
+{
+	if (!map_file(path, outputArchive.file))
+		return false;
+
+	const char* data = outputArchive.file.data;
+	size_t size = outputArchive.file.size;
+
+	ArchiveHeader header;
+	bool valid = size >= sizeof(ArchiveHeader);
+	if (valid)
+	{
+		memcpy(&header, data, sizeof(ArchiveHeader));
+
+		valid = memcmp(header.magic, ArchiveMagic, 4) == 0 && header.version == ArchiveVersion
+			&& header.tocOffset + uint64_t(header.entryCount) * sizeof(ArchiveEntry) <= size
+			&& header.namesOffset + header.namesSize <= size
+			&& header.tocOffset % alignof(ArchiveEntry) == 0;
+
+		//every name is terminated, a block that ends in a terminator keeps strcmp inside of it from any offset
+		valid = valid && (header.namesSize == 0 || data[header.namesOffset + header.namesSize - 1] == '\0');
+	}
+
+	if (!valid)
+	{
+		std::cout << "Invalid asset archive " << path << std::endl;
+		close_archive(outputArchive);
+		return false;
+	}
+
+	outputArchive.entries = (const ArchiveEntry*)(data + header.tocOffset);
+	outputArchive.entryCount = header.entryCount;
+	outputArchive.names = data + header.namesOffset;
+	outputArchive.namesSize = header.namesSize;
+
+	return true;
+}
+
+void assets::close_archive(AssetArchive& archive)
+{
+	unmap_file(archive.file);
+
+	archive.entries = nullptr;
+	archive.entryCount = 0;
+	archive.names = nullptr;
+	archive.namesSize = 0;
+}
+
+const assets::ArchiveEntry* assets::find_entry(const AssetArchive& archive, const char* name)
+{
+	uint64_t hash = hash_name(name);
+
+	const ArchiveEntry* first = archive.entries;
+	const ArchiveEntry* last = archive.entries + archive.entryCount;
+
+	const ArchiveEntry* it = std::lower_bound(first, last, hash, [](const ArchiveEntry& entry, uint64_t h) {
+		return entry.nameHash < h;
+	});
+
+	//walk over hash collisions comparing the full names
+	for (; it != last && it->nameHash == hash; it++)
+	{
+		if (strcmp(entry_name(archive, it), name) == 0)
+			return it;
+	}
+
+	return nullptr;
+}
+
+const char* assets::entry_name(const AssetArchive& archive, const ArchiveEntry* entry)
+{
+	if (entry->nameOffset >= archive.namesSize)
+		return "";
+
+	return archive.names + entry->nameOffset;
+}
+
+bool assets::read_entry(const AssetArchive& archive, const ArchiveEntry* entry, AssetView& outputView)
+{
+	if (entry->offset + entry->size > archive.file.size)
+		return false;
+
+	return parse_binaryfile(archive.file.data + entry->offset, entry->size, outputView);
+}
+
+void assets::add_archive_file(ArchiveBuilder& builder, const std::string& name, const std::string& path)
+{
+	builder.sources.push_back({ name, path });
+}
+
+bool assets::save_archive(const char* path, const ArchiveBuilder& builder)
+{
+	std::ofstream outfile;
+	outfile.open(path, std::ios::binary | std::ios::out);
+
+	if (!outfile.is_open())
+		return false;
+
+	ArchiveHeader header = {};
+	memcpy(header.magic, ArchiveMagic, 4);
+	header.version = ArchiveVersion;
+
+	//header gets rewritten once the toc position is known
+	outfile.write((const char*)&header, sizeof(ArchiveHeader));
+	uint64_t position = sizeof(ArchiveHeader);
+
+	std::vector<ArchiveEntry> toc;
+	toc.reserve(builder.sources.size());
+
+	std::string names;
+
+	for (const auto& source : builder.sources)
+	{
+		MappedFile file;
+		if (!map_file(source.path.c_str(), file))
+		{
+			std::cout << "Failed to add " << source.path << " to archive" << std::endl;
+			continue;
+		}
+
+		write_padding(outfile, position, EntryAlignment);
+
+		ArchiveEntry entry = {};
+		entry.nameHash = hash_name(source.name.c_str());
+		entry.offset = position;
+		entry.size = file.size;
+		entry.nameOffset = names.size();
+
+		AssetView view;
+		if (parse_binaryfile(file.data, file.size, view))
+			memcpy(entry.type, view.type, 4);
+
+		outfile.write(file.data, file.size);
+		position += file.size;
+
+		names.append(source.name);
+		names.push_back('\0');
+
+		toc.push_back(entry);
+
+		unmap_file(file);
+	}
+
+	//the data stays in load order, the toc is sorted for lookups
+	std::stable_sort(toc.begin(), toc.end(), [](const ArchiveEntry& a, const ArchiveEntry& b) {
+		return a.nameHash < b.nameHash;
+	});
+
+	write_padding(outfile, position, EntryAlignment);
+	header.tocOffset = position;
+	header.entryCount = toc.size();
+	outfile.write((const char*)toc.data(), toc.size() * sizeof(ArchiveEntry));
+	position += toc.size() * sizeof(ArchiveEntry);
+
+	header.namesOffset = position;
+	header.namesSize = names.size();
+	outfile.write(names.data(), names.size());
+
+	outfile.seekp(0);
+	outfile.write((const char*)&header, sizeof(ArchiveHeader));
+
+	outfile.close();
+
+	return bool(outfile);
+}
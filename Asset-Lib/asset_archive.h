@@ -0,0 +1,71 @@
+#pragma once
+
+#include <asset_loader.h>
+
+namespace assets
+{
+	//archive layout: ArchiveHeader | entry data in load order | toc sorted by name hash | name table
+	struct ArchiveHeader
+	{
+		char magic[4];
+		uint32_t version;
+		uint32_t entryCount;
+		uint32_t namesSize;
+		uint64_t tocOffset;
+		uint64_t namesOffset;
+	};
+
+	struct ArchiveEntry
+	{
+		uint64_t nameHash;
+		uint64_t offset;
+		uint64_t size;
+		char type[4];
+		uint32_t nameOffset;
+	};
+
+	constexpr char ArchiveMagic[4] = { 'V','K','P','K' };
+
+	//archive mapped from disk, entries are slices of the mapping
+	struct AssetArchive
+	{
+		MappedFile file;
+
+		const ArchiveEntry* entries{ nullptr };
+		uint32_t entryCount{ 0 };
+
+		const char* names{ nullptr };
+		size_t namesSize{ 0 };
+	};
+
+	//collects the files that go into an archive, they are written in the order they are added
+	struct ArchiveBuilder
+	{
+		struct Source
+		{
+			std::string name;
+			std::string path;
+		};
+
+		std::vector<Source> sources;
+	};
+
+	uint64_t hash_name(const char* name);
+
+	bool open_archive(const char* path, AssetArchive& outputArchive);
+
+	void close_archive(AssetArchive& archive);
+
+	//binary search on the toc, returns null when the name is not in the archive
+	const ArchiveEntry* find_entry(const AssetArchive& archive, const char* name);
+
+	const char* entry_name(const AssetArchive& archive, const ArchiveEntry* entry);
+
+	//parses an entry in place, the view points into the archive mapping
+	bool read_entry(const AssetArchive& archive, const ArchiveEntry* entry, AssetView& outputView);
+
+	void add_archive_file(ArchiveBuilder& builder, const std::string& name, const std::string& path);
+
+	//streams every source file into one archive, each one is mapped and copied without decoding
+	bool save_archive(const char* path, const ArchiveBuilder& builder);
+}
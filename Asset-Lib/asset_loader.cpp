@@ -2,11 +2,47 @@
 
 #include <fstream>
 
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 bool assets::save_binaryfile(const char* path, const AssetFile& file)
 {
   std::ofstream outfile;
   outfile.open(path, std::ios::binary | std::ios::out);
 
+	if (!outfile.is_open())
+		return false;
+
+	if (!file.info.empty())
+	{
+		AssetHeader header = {};
+		memcpy(header.magic, AssetMagic, 4);
+		memcpy(header.type, file.type, 4);
+		header.version = file.version;
+		header.infoSize = file.info.size();
+		header.jsonSize = file.json.size();
+		header.blobSize = file.binaryBlob.size();
+
+		outfile.write((const char*)&header, sizeof(AssetHeader));
+		outfile.write(file.info.data(), file.info.size());
+		outfile.write(file.binaryBlob.data(), file.binaryBlob.size());
+
+		//the json is only a debug sidecar, loaders never need to read it
+		outfile.write(file.json.data(), file.json.size());
+
+		outfile.close();
+
+		return true;
+	}
+
 	//json lenght
 	uint32_t jsonlength = file.json.size() + 1 ;
 	outfile.write((const char*)&jsonlength, sizeof(uint32_t));
@@ -36,6 +72,33 @@ bool assets::load_binaryfile(const char* path, AssetFile& outputFile)
 
   infile.seekg(0);
 
+	AssetHeader header = {};
+	infile.read((char*) &header, sizeof(AssetHeader));
+
+	if (infile.gcount() == sizeof(AssetHeader) && memcmp(header.magic, AssetMagic, 4) == 0)
+	{
+		memcpy(outputFile.type, header.type, 4);
+		outputFile.version = header.version;
+
+		outputFile.info.resize(header.infoSize);
+		infile.read(outputFile.info.data(), header.infoSize);
+
+		outputFile.binaryBlob.resize(header.blobSize);
+		infile.read(outputFile.binaryBlob.data(), header.blobSize);
+
+		outputFile.json.resize(header.jsonSize);
+		infile.read(outputFile.json.data(), header.jsonSize);
+
+		bool complete = bool(infile);
+		infile.close();
+
+		return complete;
+	}
+
+	//older json layout
+	infile.clear();
+	infile.seekg(0);
+
   //json lenght
 	uint32_t jsonlength = 0;
   infile.read((char*) &jsonlength, sizeof(uint32_t));
@@ -56,3 +119,169 @@ bool assets::load_binaryfile(const char* path, AssetFile& outputFile)
 
   return true;
 }
+
+bool assets::parse_binaryfile(const char* data, size_t size, AssetView& outputView)
+{
+	if (size >= sizeof(AssetHeader) && memcmp(data, AssetMagic, 4) == 0)
+	{
+		AssetHeader header;
+		memcpy(&header, data, sizeof(AssetHeader));
+
+		if (size < sizeof(AssetHeader) + size_t(header.infoSize) + header.blobSize + header.jsonSize)
+			return false;
+
+		memcpy(outputView.type, header.type, 4);
+		outputView.version = header.version;
+
+		outputView.info = data + sizeof(AssetHeader);
+		outputView.infoSize = header.infoSize;
+
+		outputView.binaryBlob = outputView.info + header.infoSize;
+		outputView.blobSize = header.blobSize;
+
+		outputView.json = header.jsonSize ? outputView.binaryBlob + header.blobSize : nullptr;
+		outputView.jsonSize = header.jsonSize;
+
+		return true;
+	}
+
+	const size_t headerSize = sizeof(uint32_t) * 2;
+	if (size < headerSize)
+		return false;
+
+	//json lenght
+	uint32_t jsonlength = 0;
+	memcpy(&jsonlength, data, sizeof(uint32_t));
+
+	//blob lenght
+	uint32_t bloblength = 0;
+	memcpy(&bloblength, data + sizeof(uint32_t), sizeof(uint32_t));
+
+	if (size < headerSize + size_t(jsonlength) + size_t(bloblength))
+		return false;
+
+	//the json is saved with its null terminator, keep it out of the view
+	outputView.json = data + headerSize;
+	outputView.jsonSize = strnlen(outputView.json, jsonlength);
+
+	outputView.binaryBlob = data + headerSize + jsonlength;
+	outputView.blobSize = bloblength;
+
+	return true;
+}
+
+bool assets::map_file(const char* path, MappedFile& outputFile)
+{
+	void* mapping = nullptr;
+	size_t mappingSize = 0;
+
+#ifdef _WIN32
+	HANDLE fileHandle = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+	{
+		CloseHandle(fileHandle);
+		return false;
+	}
+	mappingSize = size_t(fileSize.QuadPart);
+
+	HANDLE mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mappingHandle)
+	{
+		mapping = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	}
+
+	//the view keeps the mapping object alive, the handles are not needed anymore
+	if (mappingHandle)
+		CloseHandle(mappingHandle);
+	CloseHandle(fileHandle);
+
+	if (!mapping)
+		return false;
+#else
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+
+	struct stat fileStat;
+	if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0)
+	{
+		close(fd);
+		return false;
+	}
+	mappingSize = size_t(fileStat.st_size);
+
+	mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	//the mapping keeps a reference to the file, the descriptor can go
+	close(fd);
+
+	if (mapping == MAP_FAILED)
+		return false;
+
+	//files are consumed front to back
+	madvise(mapping, mappingSize, MADV_SEQUENTIAL);
+#endif
+
+	outputFile.data = (const char*)mapping;
+	outputFile.size = mappingSize;
+
+	return true;
+}
+
+void assets::unmap_file(MappedFile& file)
+{
+	if (!file.data)
+		return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(file.data);
+#else
+	munmap((void*)file.data, file.size);
+#endif
+
+	file.data = nullptr;
+	file.size = 0;
+}
+
+bool assets::map_binaryfile(const char* path, MappedAssetFile& outputFile)
+{
+	if (!map_file(path, outputFile.file))
+		return false;
+
+	if (!parse_binaryfile(outputFile.file.data, outputFile.file.size, outputFile.view))
+	{
+		unmap_binaryfile(outputFile);
+		return false;
+	}
+
+	return true;
+}
+
+void assets::unmap_binaryfile(MappedAssetFile& file)
+{
+	unmap_file(file.file);
+	file.view = AssetView{};
+}
+
+assets::AssetView assets::make_view(const AssetFile& file)
+{
+	AssetView view;
+
+	memcpy(view.type, file.type, 4);
+	view.version = file.version;
+
+	view.info = file.info.empty() ? nullptr : file.info.data();
+	view.infoSize = file.info.size();
+
+	view.json = file.json.data();
+	view.jsonSize = strnlen(file.json.data(), file.json.size());
+
+	view.binaryBlob = file.binaryBlob.data();
+	view.blobSize = file.binaryBlob.size();
+
+	return view;
+}
@@ -2,18 +2,94 @@
 
 #include <string>
 #include <cstring>
+#include <cstdint>
 #include <vector>
 
 namespace assets
 {
+	//binary asset layout: AssetHeader | fixed size info header | blob | optional json debug sidecar.
+	//files that do not start with the magic are the older json + blob layout
+	struct AssetHeader
+	{
+		char magic[4];
+		char type[4];
+		uint32_t version;
+		uint32_t infoSize;
+		uint32_t jsonSize;
+		uint32_t reserved;
+		uint64_t blobSize;
+	};
+
+	constexpr char AssetMagic[4] = { 'V','K','G','A' };
+
 	struct AssetFile
   {
+		char type[4]{};
+		uint32_t version{ 0 };
+		//fixed size info header, when empty the file is saved in the json layout
+		std::vector<char> info;
+
 		std::string json;
 		std::vector<char> binaryBlob;
 	};
 
+	//read-only view over the sections of an asset, it does not own the memory it points to
+	struct AssetView
+	{
+		char type[4]{};
+		uint32_t version{ 0 };
+
+		const char* info{ nullptr };
+		size_t infoSize{ 0 };
+
+		const char* json{ nullptr };
+		size_t jsonSize{ 0 };
+
+		const char* binaryBlob{ nullptr };
+		size_t blobSize{ 0 };
+	};
+
+	//read-only memory mapping of a whole file
+	struct MappedFile
+	{
+		const char* data{ nullptr };
+		size_t size{ 0 };
+	};
+
+	//asset file mapped straight from disk, the view stays valid until unmap_binaryfile
+	struct MappedAssetFile
+	{
+		AssetView view;
+		MappedFile file;
+	};
 
 	bool save_binaryfile(const char* path, const AssetFile& file);
 
 	bool load_binaryfile(const char* path, AssetFile& outputFile);
+
+	bool map_file(const char* path, MappedFile& outputFile);
+
+	void unmap_file(MappedFile& file);
+
+	//maps the file read-only instead of copying it, no heap allocation is made for the asset data
+	bool map_binaryfile(const char* path, MappedAssetFile& outputFile);
+
+	void unmap_binaryfile(MappedAssetFile& file);
+
+	//splits an in-memory asset file image into its json and blob sections
+	bool parse_binaryfile(const char* data, size_t size, AssetView& outputView);
+
+	AssetView make_view(const AssetFile& file);
+
+	//copies the fixed info header of a view into a POD struct, fields missing from older versions are zeroed
+	template<typename T>
+	bool read_info_header(const AssetView& view, const char type[4], T& outputInfo)
+	{
+		if (!view.info || memcmp(view.type, type, 4) != 0)
+			return false;
+
+		outputInfo = T{};
+		memcpy(&outputInfo, view.info, view.infoSize < sizeof(T) ? view.infoSize : sizeof(T));
+		return true;
+	}
 }
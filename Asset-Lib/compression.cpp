@@ -0,0 +1,237 @@
+#include <compression.h>
+
+#include <cstring>
+#include <lz4.h>
+
+namespace {
+
+	//lz4 block format limits, see lz4_Block_format.md
+	constexpr int MinMatch = 4;
+	constexpr int LastLiterals = 5;
+	constexpr int MatchFindLimit = 12;
+	constexpr int MaxDistance = 65535;
+
+	constexpr int HashLog = 15;
+	constexpr int MaxSearchAttempts = 256;
+
+	uint32_t read32(const uint8_t* p)
+	{
+		uint32_t v;
+		memcpy(&v, p, sizeof(uint32_t));
+		return v;
+	}
+
+	uint32_t hash4(const uint8_t* p)
+	{
+		return (read32(p) * 2654435761u) >> (32 - HashLog);
+	}
+
+	//hash chain match finder, every position links to the previous one with the same hash
+	struct ChainMatcher
+	{
+		const uint8_t* base;
+		std::vector<int32_t> head;
+		std::vector<uint16_t> chain;
+		int32_t nextToInsert{ 0 };
+
+		ChainMatcher(const uint8_t* source) : base(source), head(size_t(1) << HashLog, -1), chain(MaxDistance + 1, 0) {}
+
+		void insert_until(int32_t position)
+		{
+			for (; nextToInsert < position; nextToInsert++)
+			{
+				uint32_t h = hash4(base + nextToInsert);
+				int32_t previous = head[h];
+				int32_t delta = previous < 0 ? 0 : nextToInsert - previous;
+
+				//0 marks the end of the chain
+				chain[nextToInsert & MaxDistance] = uint16_t(delta > MaxDistance ? 0 : delta);
+				head[h] = nextToInsert;
+			}
+		}
+
+		int find_longest(int32_t position, int32_t matchLimit, int32_t& matchPosition)
+		{
+			insert_until(position);
+
+			int bestLength = 0;
+			int attempts = MaxSearchAttempts;
+
+			uint32_t sequence = read32(base + position);
+			int32_t candidate = head[hash4(base + position)];
+
+			while (candidate >= 0 && position - candidate <= MaxDistance && attempts-- > 0)
+			{
+				if (read32(base + candidate) == sequence)
+				{
+					int length = MinMatch;
+					while (position + length < matchLimit && base[candidate + length] == base[position + length])
+						length++;
+
+					if (length > bestLength)
+					{
+						bestLength = length;
+						matchPosition = candidate;
+					}
+				}
+
+				uint16_t delta = chain[candidate & MaxDistance];
+				if (delta == 0)
+					break;
+				candidate -= delta;
+			}
+
+			return bestLength;
+		}
+	};
+
+	void write_length(uint8_t*& op, size_t length)
+	{
+		for (; length >= 255; length -= 255)
+			*op++ = 255;
+		*op++ = uint8_t(length);
+	}
+
+	void write_sequence(uint8_t*& op, const uint8_t* literals, size_t literalLength, int offset, int matchLength)
+	{
+		uint8_t* token = op++;
+
+		*token = uint8_t((literalLength >= 15 ? 15 : literalLength) << 4);
+		if (literalLength >= 15)
+			write_length(op, literalLength - 15);
+
+		memcpy(op, literals, literalLength);
+		op += literalLength;
+
+		//the last sequence only carries literals
+		if (matchLength == 0)
+			return;
+
+		*op++ = uint8_t(offset & 0xFF);
+		*op++ = uint8_t(offset >> 8);
+
+		size_t extra = size_t(matchLength - MinMatch);
+		*token |= uint8_t(extra >= 15 ? 15 : extra);
+		if (extra >= 15)
+			write_length(op, extra - 15);
+	}
+
+	//high compression encoder, searches the hash chains deeply and does one step of lazy matching.
+	//the output is a plain lz4 block so LZ4_decompress_safe reads it
+	int compress_hc(const char* source, char* destination, int sourceSize)
+	{
+		const uint8_t* src = (const uint8_t*)source;
+		uint8_t* op = (uint8_t*)destination;
+
+		int32_t anchor = 0;
+
+		if (sourceSize > MatchFindLimit)
+		{
+			const int32_t matchStartLimit = sourceSize - MatchFindLimit;
+			const int32_t matchLimit = sourceSize - LastLiterals;
+
+			ChainMatcher matcher{ src };
+
+			int32_t ip = 0;
+			while (ip <= matchStartLimit)
+			{
+				int32_t matchPosition = 0;
+				int length = matcher.find_longest(ip, matchLimit, matchPosition);
+				if (length < MinMatch)
+				{
+					ip++;
+					continue;
+				}
+
+				//lazy evaluation, prefer a longer match starting at the next byte
+				while (ip + 1 <= matchStartLimit)
+				{
+					int32_t nextPosition = 0;
+					int nextLength = matcher.find_longest(ip + 1, matchLimit, nextPosition);
+					if (nextLength <= length)
+						break;
+
+					ip++;
+					length = nextLength;
+					matchPosition = nextPosition;
+				}
+
+				write_sequence(op, src + anchor, size_t(ip - anchor), ip - matchPosition, length);
+
+				ip += length;
+				anchor = ip;
+			}
+		}
+
+		write_sequence(op, src + anchor, size_t(sourceSize - anchor), 0, 0);
+
+		return int(op - (uint8_t*)destination);
+	}
+}
+
+assets::CompressionMode assets::parse_compression(const char* f)
+{
+	if (strcmp(f, "LZ4") == 0)
+		return CompressionMode::LZ4;
+
+	else if (strcmp(f, "LZ4HC") == 0)
+		return CompressionMode::LZ4HC;
+
+	else
+		return CompressionMode::None;
+}
+
+const char* assets::compression_name(CompressionMode mode)
+{
+	switch (mode)
+	{
+		case CompressionMode::LZ4:
+			return "LZ4";
+		case CompressionMode::LZ4HC:
+			return "LZ4HC";
+		default:
+			return "None";
+	}
+}
+
+size_t assets::compress_block(CompressionMode mode, const char* source, size_t sourceSize, std::vector<char>& output)
+{
+	size_t start = output.size();
+
+	if (mode == CompressionMode::None || sourceSize == 0)
+	{
+		output.resize(start + sourceSize);
+		memcpy(output.data() + start, source, sourceSize);
+		return sourceSize;
+	}
+
+	int bound = LZ4_compressBound(static_cast<int>(sourceSize));
+	output.resize(start + bound);
+
+	int compressedSize = 0;
+	if (mode == CompressionMode::LZ4HC)
+		compressedSize = compress_hc(source, output.data() + start, static_cast<int>(sourceSize));
+
+	else
+		compressedSize = LZ4_compress_default(source, output.data() + start, static_cast<int>(sourceSize), bound);
+
+	output.resize(start + compressedSize);
+
+	return size_t(compressedSize);
+}
+
+bool assets::decompress_block(CompressionMode mode, const char* source, size_t sourceSize, char* destination, size_t destinationSize)
+{
+	if (mode == CompressionMode::None || destinationSize == 0)
+	{
+		if (sourceSize != destinationSize)
+			return false;
+
+		memcpy(destination, source, sourceSize);
+		return true;
+	}
+
+	int decompressedSize = LZ4_decompress_safe(source, destination, static_cast<int>(sourceSize), static_cast<int>(destinationSize));
+
+	return decompressedSize == static_cast<int>(destinationSize);
+}
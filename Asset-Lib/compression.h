@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+namespace assets
+{
+	enum class CompressionMode : uint32_t
+	{
+		None = 0,
+		LZ4,  //fast lz4 block compression
+		LZ4HC //slower to bake, same lz4 block format and decoder
+	};
+
+	CompressionMode parse_compression(const char* f);
+
+	const char* compression_name(CompressionMode mode);
+
+	//compresses source as one self contained block and appends it to output, returns the block size
+	size_t compress_block(CompressionMode mode, const char* source, size_t sourceSize, std::vector<char>& output);
+
+	//decodes one block straight into destination, which has to hold exactly destinationSize bytes
+	bool decompress_block(CompressionMode mode, const char* source, size_t sourceSize, char* destination, size_t destinationSize);
+}
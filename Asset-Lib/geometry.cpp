@@ -0,0 +1,488 @@
+#include "geometry.h"
+#include "geometry_kernels.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#ifdef ASSETS_GEOMETRY_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef ASSETS_GEOMETRY_AVX2
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+namespace {
+
+	const float* position_at(const float* positions, size_t stride, size_t index)
+	{
+		return (const float*)((const char*)positions + index * stride);
+	}
+
+	//the vector paths read 4 floats per position
+	constexpr size_t MinVectorStride = sizeof(float) * 4;
+
+	// ---- scalar ----
+	//the vector paths below do the same operations in the same order, every level gives the same results.
+	//min and max take the new value first so ties keep the accumulated one, like std::min and std::max
+
+	void bounds_scalar(const float* positions, size_t count, size_t stride, float outMin[3], float outMax[3])
+	{
+		float min[3] = { std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max() };
+		float max[3] = { std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest() };
+
+		for (size_t i = 0; i < count; i++)
+		{
+			const float* p = position_at(positions, stride, i);
+			for (int c = 0; c < 3; c++)
+			{
+				min[c] = std::min(min[c], p[c]);
+				max[c] = std::max(max[c], p[c]);
+			}
+		}
+
+		for (int c = 0; c < 3; c++)
+		{
+			outMin[c] = min[c];
+			outMax[c] = max[c];
+		}
+	}
+
+	float max_distance_squared_scalar(const float* positions, size_t count, size_t stride, const float center[3])
+	{
+		float r2 = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			const float* p = position_at(positions, stride, i);
+			float dx = p[0] - center[0];
+			float dy = p[1] - center[1];
+			float dz = p[2] - center[2];
+			r2 = std::max(r2, dx * dx + dy * dy + dz * dz);
+		}
+		return r2;
+	}
+
+	void normalize_scalar(float& x, float& y, float& z)
+	{
+		float length = std::sqrt(x * x + y * y + z * z);
+		if (length > 0)
+		{
+			x = x / length;
+			y = y / length;
+			z = z / length;
+		}
+		else
+		{
+			x = y = z = 0;
+		}
+	}
+
+	void face_normals_scalar(const float* positions, size_t stride, const uint32_t* indices, size_t faceCount, bool normalize, float* normals)
+	{
+		for (size_t f = 0; f < faceCount; f++)
+		{
+			const float* p0 = position_at(positions, stride, indices[f * 3 + 0]);
+			const float* p1 = position_at(positions, stride, indices[f * 3 + 1]);
+			const float* p2 = position_at(positions, stride, indices[f * 3 + 2]);
+
+			//cross(p2 - p0, p1 - p0), the winding is clockwise
+			float ax = p2[0] - p0[0], ay = p2[1] - p0[1], az = p2[2] - p0[2];
+			float bx = p1[0] - p0[0], by = p1[1] - p0[1], bz = p1[2] - p0[2];
+
+			float nx = ay * bz - by * az;
+			float ny = az * bx - bz * ax;
+			float nz = ax * by - bx * ay;
+
+			if (normalize)
+				normalize_scalar(nx, ny, nz);
+
+			normals[f * 3 + 0] = nx;
+			normals[f * 3 + 1] = ny;
+			normals[f * 3 + 2] = nz;
+		}
+	}
+
+	void normalize_soa_scalar(float* x, float* y, float* z, size_t count)
+	{
+		for (size_t i = 0; i < count; i++)
+			normalize_scalar(x[i], y[i], z[i]);
+	}
+
+	void transform_points_scalar(const float m[16], const float* positions, size_t count, size_t stride, float* output, size_t outputStride)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			const float* p = position_at(positions, stride, i);
+			float x = p[0], y = p[1], z = p[2];
+
+			float* out = (float*)((char*)output + i * outputStride);
+			for (int c = 0; c < 3; c++)
+				out[c] = m[c] * x + m[4 + c] * y + m[8 + c] * z + m[12 + c];
+		}
+	}
+
+	// ---- sse2 ----
+#ifdef ASSETS_GEOMETRY_SSE2
+	__m128 load_position(const float* positions, size_t stride, size_t index)
+	{
+		return _mm_loadu_ps(position_at(positions, stride, index));
+	}
+
+	void store_xyz(float* output, __m128 v)
+	{
+		_mm_storel_pi((__m64*)output, v);
+		_mm_store_ss(output + 2, _mm_movehl_ps(v, v));
+	}
+
+	//x, y and z of 4 positions picked by index, out of interleaved vertices
+	void gather_positions(const float* positions, size_t stride, uint32_t i0, uint32_t i1, uint32_t i2, uint32_t i3, __m128& x, __m128& y, __m128& z)
+	{
+		__m128 a = load_position(positions, stride, i0);
+		__m128 b = load_position(positions, stride, i1);
+		__m128 c = load_position(positions, stride, i2);
+		__m128 d = load_position(positions, stride, i3);
+		_MM_TRANSPOSE4_PS(a, b, c, d);
+		x = a;
+		y = b;
+		z = c;
+	}
+
+	void normalize_sse2(__m128& x, __m128& y, __m128& z)
+	{
+		__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+		__m128 valid = _mm_cmpgt_ps(length, _mm_setzero_ps());
+		x = _mm_and_ps(_mm_div_ps(x, length), valid);
+		y = _mm_and_ps(_mm_div_ps(y, length), valid);
+		z = _mm_and_ps(_mm_div_ps(z, length), valid);
+	}
+
+	void bounds_sse2(const float* positions, size_t count, size_t stride, float outMin[3], float outMax[3])
+	{
+		//two independent chains so the min and max latency overlaps
+		__m128 min0 = load_position(positions, stride, 0);
+		__m128 max0 = min0;
+		__m128 min1 = min0;
+		__m128 max1 = min0;
+
+		size_t i = 1;
+		for (; i + 2 <= count; i += 2)
+		{
+			__m128 a = load_position(positions, stride, i);
+			__m128 b = load_position(positions, stride, i + 1);
+			min0 = _mm_min_ps(a, min0);
+			max0 = _mm_max_ps(a, max0);
+			min1 = _mm_min_ps(b, min1);
+			max1 = _mm_max_ps(b, max1);
+		}
+		for (; i < count; i++)
+		{
+			__m128 a = load_position(positions, stride, i);
+			min0 = _mm_min_ps(a, min0);
+			max0 = _mm_max_ps(a, max0);
+		}
+
+		store_xyz(outMin, _mm_min_ps(min0, min1));
+		store_xyz(outMax, _mm_max_ps(max0, max1));
+	}
+
+	float max_distance_squared_sse2(const float* positions, size_t count, size_t stride, const float center[3])
+	{
+		const __m128 cx = _mm_set1_ps(center[0]);
+		const __m128 cy = _mm_set1_ps(center[1]);
+		const __m128 cz = _mm_set1_ps(center[2]);
+
+		__m128 best = _mm_setzero_ps();
+
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 x, y, z;
+			gather_positions(positions, stride, uint32_t(i), uint32_t(i + 1), uint32_t(i + 2), uint32_t(i + 3), x, y, z);
+
+			__m128 dx = _mm_sub_ps(x, cx);
+			__m128 dy = _mm_sub_ps(y, cy);
+			__m128 dz = _mm_sub_ps(z, cz);
+			__m128 d2 = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+			best = _mm_max_ps(d2, best);
+		}
+
+		alignas(16) float lanes[4];
+		_mm_store_ps(lanes, best);
+		float r2 = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+
+		return std::max(r2, max_distance_squared_scalar(position_at(positions, stride, i), count - i, stride, center));
+	}
+
+	void face_normals_sse2(const float* positions, size_t stride, const uint32_t* indices, size_t faceCount, bool normalize, float* normals)
+	{
+		size_t f = 0;
+		for (; f + 4 <= faceCount; f += 4)
+		{
+			const uint32_t* tri = indices + f * 3;
+
+			__m128 x0, y0, z0, x1, y1, z1, x2, y2, z2;
+			gather_positions(positions, stride, tri[0], tri[3], tri[6], tri[9], x0, y0, z0);
+			gather_positions(positions, stride, tri[1], tri[4], tri[7], tri[10], x1, y1, z1);
+			gather_positions(positions, stride, tri[2], tri[5], tri[8], tri[11], x2, y2, z2);
+
+			__m128 ax = _mm_sub_ps(x2, x0), ay = _mm_sub_ps(y2, y0), az = _mm_sub_ps(z2, z0);
+			__m128 bx = _mm_sub_ps(x1, x0), by = _mm_sub_ps(y1, y0), bz = _mm_sub_ps(z1, z0);
+
+			__m128 nx = _mm_sub_ps(_mm_mul_ps(ay, bz), _mm_mul_ps(by, az));
+			__m128 ny = _mm_sub_ps(_mm_mul_ps(az, bx), _mm_mul_ps(bz, ax));
+			__m128 nz = _mm_sub_ps(_mm_mul_ps(ax, by), _mm_mul_ps(bx, ay));
+
+			if (normalize)
+				normalize_sse2(nx, ny, nz);
+
+			__m128 nw = _mm_setzero_ps();
+			_MM_TRANSPOSE4_PS(nx, ny, nz, nw);
+			store_xyz(normals + f * 3 + 0, nx);
+			store_xyz(normals + f * 3 + 3, ny);
+			store_xyz(normals + f * 3 + 6, nz);
+			store_xyz(normals + f * 3 + 9, nw);
+		}
+
+		face_normals_scalar(positions, stride, indices + f * 3, faceCount - f, normalize, normals + f * 3);
+	}
+
+	void normalize_soa_sse2(float* x, float* y, float* z, size_t count)
+	{
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 vx = _mm_loadu_ps(x + i);
+			__m128 vy = _mm_loadu_ps(y + i);
+			__m128 vz = _mm_loadu_ps(z + i);
+			normalize_sse2(vx, vy, vz);
+			_mm_storeu_ps(x + i, vx);
+			_mm_storeu_ps(y + i, vy);
+			_mm_storeu_ps(z + i, vz);
+		}
+
+		normalize_soa_scalar(x + i, y + i, z + i, count - i);
+	}
+
+	void transform_points_sse2(const float m[16], const float* positions, size_t count, size_t stride, float* output, size_t outputStride)
+	{
+		const __m128 c0 = _mm_loadu_ps(m + 0);
+		const __m128 c1 = _mm_loadu_ps(m + 4);
+		const __m128 c2 = _mm_loadu_ps(m + 8);
+		const __m128 c3 = _mm_loadu_ps(m + 12);
+
+		//one point per register, the matrix columns are scaled by its coordinates
+		for (size_t i = 0; i < count; i++)
+		{
+			__m128 p = load_position(positions, stride, i);
+			__m128 x = _mm_shuffle_ps(p, p, _MM_SHUFFLE(0, 0, 0, 0));
+			__m128 y = _mm_shuffle_ps(p, p, _MM_SHUFFLE(1, 1, 1, 1));
+			__m128 z = _mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 2, 2));
+
+			__m128 r = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, x), _mm_mul_ps(c1, y)), _mm_mul_ps(c2, z)), c3);
+			store_xyz((float*)((char*)output + i * outputStride), r);
+		}
+	}
+#endif
+
+#ifdef ASSETS_GEOMETRY_AVX2
+	bool cpu_has_avx2()
+	{
+#ifdef _MSC_VER
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+			return false;
+
+		__cpuid(info, 1);
+		bool osxsave = (info[2] & (1 << 27)) != 0;
+		bool avx = (info[2] & (1 << 28)) != 0;
+		//the os has to save the ymm registers on context switches
+		if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+			return false;
+
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		unsigned int eax, ebx, ecx, edx;
+		if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+			return false;
+		if (!(ecx & bit_OSXSAVE) || !(ecx & bit_AVX))
+			return false;
+
+		//the os has to save the ymm registers on context switches
+		unsigned int xcr0, xcr0High;
+		__asm__ volatile("xgetbv" : "=a"(xcr0), "=d"(xcr0High) : "c"(0));
+		if ((xcr0 & 6) != 6)
+			return false;
+
+		if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+			return false;
+		return (ebx & bit_AVX2) != 0;
+#endif
+	}
+#endif
+
+	const assets::kernels::GeometryKernels* kernels_for_level(assets::SimdLevel level)
+	{
+		switch (level)
+		{
+#ifdef ASSETS_GEOMETRY_AVX2
+		case assets::SimdLevel::AVX2:
+			return &assets::kernels::AVX2;
+#endif
+#ifdef ASSETS_GEOMETRY_SSE2
+		case assets::SimdLevel::SSE2:
+			return &assets::kernels::SSE2;
+#endif
+		default:
+			return &assets::kernels::Scalar;
+		}
+	}
+
+	std::atomic<const assets::kernels::GeometryKernels*> activeKernels{ nullptr };
+	std::atomic<assets::SimdLevel> activeLevel{ assets::SimdLevel::Scalar };
+
+	const assets::kernels::GeometryKernels& kernels_for_stride(size_t stride)
+	{
+		if (stride < MinVectorStride)
+			return assets::kernels::Scalar;
+
+		const assets::kernels::GeometryKernels* kernels = activeKernels.load(std::memory_order_relaxed);
+		if (!kernels)
+		{
+			assets::set_simd_level(assets::supported_simd_level());
+			kernels = activeKernels.load(std::memory_order_relaxed);
+		}
+		return *kernels;
+	}
+}
+
+const assets::kernels::GeometryKernels assets::kernels::Scalar = {
+	bounds_scalar,
+	max_distance_squared_scalar,
+	face_normals_scalar,
+	normalize_soa_scalar,
+	transform_points_scalar
+};
+
+#ifdef ASSETS_GEOMETRY_SSE2
+const assets::kernels::GeometryKernels assets::kernels::SSE2 = {
+	bounds_sse2,
+	max_distance_squared_sse2,
+	face_normals_sse2,
+	normalize_soa_sse2,
+	transform_points_sse2
+};
+#endif
+
+assets::SimdLevel assets::supported_simd_level()
+{
+	static const SimdLevel level = []() {
+#ifdef ASSETS_GEOMETRY_AVX2
+		if (cpu_has_avx2())
+			return SimdLevel::AVX2;
+#endif
+#ifdef ASSETS_GEOMETRY_SSE2
+		return SimdLevel::SSE2;
+#else
+		return SimdLevel::Scalar;
+#endif
+	}();
+	return level;
+}
+
+assets::SimdLevel assets::active_simd_level()
+{
+	if (!activeKernels.load(std::memory_order_relaxed))
+		return supported_simd_level();
+	return activeLevel.load(std::memory_order_relaxed);
+}
+
+void assets::set_simd_level(SimdLevel level)
+{
+	level = SimdLevel(std::min(uint32_t(level), uint32_t(supported_simd_level())));
+	activeLevel.store(level, std::memory_order_relaxed);
+	activeKernels.store(kernels_for_level(level), std::memory_order_relaxed);
+}
+
+const char* assets::simd_level_name(SimdLevel level)
+{
+	switch (level)
+	{
+	case SimdLevel::SSE2:
+		return "sse2";
+	case SimdLevel::AVX2:
+		return "avx2";
+	default:
+		return "scalar";
+	}
+}
+
+assets::Aabb assets::compute_aabb(const float* positions, size_t count, size_t stride)
+{
+	Aabb box = {};
+	if (count == 0)
+		return box;
+
+	kernels_for_stride(stride).bounds(positions, count, stride, box.min, box.max);
+	return box;
+}
+
+float assets::compute_bounding_radius(const float* positions, size_t count, size_t stride, const float center[3])
+{
+	return std::sqrt(kernels_for_stride(stride).max_distance_squared(positions, count, stride, center));
+}
+
+void assets::compute_face_normals(const float* positions, size_t stride, const uint32_t* indices, size_t indexCount, float* normals)
+{
+	kernels_for_stride(stride).face_normals(positions, stride, indices, indexCount / 3, true, normals);
+}
+
+void assets::compute_vertex_normals(const float* positions, size_t positionStride, const uint32_t* indices, size_t indexCount,
+	size_t vertexCount, float* normals, size_t normalStride)
+{
+	const kernels::GeometryKernels& kernels = kernels_for_stride(positionStride);
+
+	//unnormalized, the cross product length weights each face by its area
+	size_t faceCount = indexCount / 3;
+	std::vector<float> faceNormals(faceCount * 3);
+	kernels.face_normals(positions, positionStride, indices, faceCount, false, faceNormals.data());
+
+	std::vector<float> x(vertexCount, 0.f);
+	std::vector<float> y(vertexCount, 0.f);
+	std::vector<float> z(vertexCount, 0.f);
+
+	//scattered adds, this part stays scalar
+	for (size_t f = 0; f < faceCount; f++)
+	{
+		for (int corner = 0; corner < 3; corner++)
+		{
+			uint32_t v = indices[f * 3 + corner];
+			x[v] += faceNormals[f * 3 + 0];
+			y[v] += faceNormals[f * 3 + 1];
+			z[v] += faceNormals[f * 3 + 2];
+		}
+	}
+
+	kernels.normalize(x.data(), y.data(), z.data(), vertexCount);
+
+	for (size_t v = 0; v < vertexCount; v++)
+	{
+		float* normal = (float*)((char*)normals + v * normalStride);
+		normal[0] = x[v];
+		normal[1] = y[v];
+		normal[2] = z[v];
+	}
+}
+
+void assets::transform_points(const float matrix[16], const float* positions, size_t count, size_t stride, float* output, size_t outputStride)
+{
+	kernels_for_stride(stride).transform_points(matrix, positions, count, stride, output, outputStride);
+}
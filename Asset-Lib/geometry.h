@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace assets
+{
+	//instruction sets the geometry kernels are built for, picked at runtime from what the cpu supports
+	enum class SimdLevel : uint32_t
+	{
+		Scalar = 0,
+		SSE2,
+		AVX2
+	};
+
+	//best level this cpu and build support
+	SimdLevel supported_simd_level();
+
+	SimdLevel active_simd_level();
+
+	//forces the kernels to a lower level, for benchmarks and comparisons. clamped to the supported level
+	void set_simd_level(SimdLevel level);
+
+	const char* simd_level_name(SimdLevel level);
+
+	struct Aabb
+	{
+		float min[3];
+		float max[3];
+	};
+
+	//positions are 3 floats found every stride bytes, so they can be read in place from interleaved vertices.
+	//the vector paths load them as 4 floats and only run when stride is at least 16 bytes, tighter arrays use the scalar path
+
+	//empty input gives an empty box at the origin
+	Aabb compute_aabb(const float* positions, size_t count, size_t stride);
+
+	//distance from center to the furthest position
+	float compute_bounding_radius(const float* positions, size_t count, size_t stride, const float center[3]);
+
+	//one normal per triangle, 3 floats each, front faces are clockwise like in the engine pipelines.
+	//degenerate triangles get a zero normal
+	void compute_face_normals(const float* positions, size_t stride, const uint32_t* indices, size_t indexCount, float* normals);
+
+	//smooth normals, the face normals are weighted by the triangle area. normals are written as 3 floats every normalStride bytes
+	void compute_vertex_normals(const float* positions, size_t positionStride, const uint32_t* indices, size_t indexCount,
+		size_t vertexCount, float* normals, size_t normalStride);
+
+	//transforms the positions as points by a column major 4x4 matrix, output can be the input itself
+	void transform_points(const float matrix[16], const float* positions, size_t count, size_t stride, float* output, size_t outputStride);
+}
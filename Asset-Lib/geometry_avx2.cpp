@@ -0,0 +1,241 @@
+#include "geometry_kernels.h"
+
+#include <algorithm>
+#include <cmath>
+
+//built with avx2 code generation, nothing here runs before the cpu has been checked for it
+#ifdef ASSETS_GEOMETRY_AVX2
+#include <immintrin.h>
+
+namespace {
+
+	const float* position_at(const float* positions, size_t stride, size_t index)
+	{
+		return (const float*)((const char*)positions + index * stride);
+	}
+
+	__m128 load_position(const float* positions, size_t stride, size_t index)
+	{
+		return _mm_loadu_ps(position_at(positions, stride, index));
+	}
+
+	__m256 combine(__m128 low, __m128 high)
+	{
+		return _mm256_insertf128_ps(_mm256_castps128_ps256(low), high, 1);
+	}
+
+	void store_xyz(float* output, __m128 v)
+	{
+		_mm_storel_pi((__m64*)output, v);
+		_mm_store_ss(output + 2, _mm_movehl_ps(v, v));
+	}
+
+	//x, y and z of 8 positions picked by index, as two transposed halves
+	void gather_positions(const float* positions, size_t stride, const uint32_t index[8], __m256& x, __m256& y, __m256& z)
+	{
+		__m128 a = load_position(positions, stride, index[0]);
+		__m128 b = load_position(positions, stride, index[1]);
+		__m128 c = load_position(positions, stride, index[2]);
+		__m128 d = load_position(positions, stride, index[3]);
+		_MM_TRANSPOSE4_PS(a, b, c, d);
+
+		__m128 e = load_position(positions, stride, index[4]);
+		__m128 f = load_position(positions, stride, index[5]);
+		__m128 g = load_position(positions, stride, index[6]);
+		__m128 h = load_position(positions, stride, index[7]);
+		_MM_TRANSPOSE4_PS(e, f, g, h);
+
+		x = combine(a, e);
+		y = combine(b, f);
+		z = combine(c, g);
+	}
+
+	void normalize_avx2(__m256& x, __m256& y, __m256& z)
+	{
+		__m256 length = _mm256_sqrt_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, x), _mm256_mul_ps(y, y)), _mm256_mul_ps(z, z)));
+		__m256 valid = _mm256_cmp_ps(length, _mm256_setzero_ps(), _CMP_GT_OQ);
+		x = _mm256_and_ps(_mm256_div_ps(x, length), valid);
+		y = _mm256_and_ps(_mm256_div_ps(y, length), valid);
+		z = _mm256_and_ps(_mm256_div_ps(z, length), valid);
+	}
+
+	void bounds_avx2(const float* positions, size_t count, size_t stride, float outMin[3], float outMax[3])
+	{
+		//two positions per register, two registers per iteration
+		__m128 first = load_position(positions, stride, 0);
+		__m256 min0 = combine(first, first);
+		__m256 max0 = min0;
+		__m256 min1 = min0;
+		__m256 max1 = min0;
+
+		size_t i = 1;
+		for (; i + 4 <= count; i += 4)
+		{
+			__m256 a = combine(load_position(positions, stride, i), load_position(positions, stride, i + 1));
+			__m256 b = combine(load_position(positions, stride, i + 2), load_position(positions, stride, i + 3));
+			min0 = _mm256_min_ps(a, min0);
+			max0 = _mm256_max_ps(a, max0);
+			min1 = _mm256_min_ps(b, min1);
+			max1 = _mm256_max_ps(b, max1);
+		}
+
+		min0 = _mm256_min_ps(min1, min0);
+		max0 = _mm256_max_ps(max1, max0);
+		__m128 min = _mm_min_ps(_mm256_extractf128_ps(min0, 1), _mm256_castps256_ps128(min0));
+		__m128 max = _mm_max_ps(_mm256_extractf128_ps(max0, 1), _mm256_castps256_ps128(max0));
+
+		for (; i < count; i++)
+		{
+			__m128 a = load_position(positions, stride, i);
+			min = _mm_min_ps(a, min);
+			max = _mm_max_ps(a, max);
+		}
+
+		store_xyz(outMin, min);
+		store_xyz(outMax, max);
+	}
+
+	float max_distance_squared_avx2(const float* positions, size_t count, size_t stride, const float center[3])
+	{
+		const __m256 cx = _mm256_set1_ps(center[0]);
+		const __m256 cy = _mm256_set1_ps(center[1]);
+		const __m256 cz = _mm256_set1_ps(center[2]);
+
+		__m256 best = _mm256_setzero_ps();
+
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			const uint32_t index[8] = {
+				uint32_t(i), uint32_t(i + 1), uint32_t(i + 2), uint32_t(i + 3),
+				uint32_t(i + 4), uint32_t(i + 5), uint32_t(i + 6), uint32_t(i + 7)
+			};
+
+			__m256 x, y, z;
+			gather_positions(positions, stride, index, x, y, z);
+
+			__m256 dx = _mm256_sub_ps(x, cx);
+			__m256 dy = _mm256_sub_ps(y, cy);
+			__m256 dz = _mm256_sub_ps(z, cz);
+			__m256 d2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)), _mm256_mul_ps(dz, dz));
+			best = _mm256_max_ps(d2, best);
+		}
+
+		alignas(32) float lanes[8];
+		_mm256_store_ps(lanes, best);
+		float r2 = *std::max_element(lanes, lanes + 8);
+
+		//the last few go through the same math as the scalar kernel
+		for (; i < count; i++)
+		{
+			const float* p = position_at(positions, stride, i);
+			float dx = p[0] - center[0];
+			float dy = p[1] - center[1];
+			float dz = p[2] - center[2];
+			r2 = std::max(r2, dx * dx + dy * dy + dz * dz);
+		}
+		return r2;
+	}
+
+	void face_normals_avx2(const float* positions, size_t stride, const uint32_t* indices, size_t faceCount, bool normalize, float* normals)
+	{
+		size_t f = 0;
+		for (; f + 8 <= faceCount; f += 8)
+		{
+			const uint32_t* tri = indices + f * 3;
+
+			uint32_t corner0[8], corner1[8], corner2[8];
+			for (int t = 0; t < 8; t++)
+			{
+				corner0[t] = tri[t * 3 + 0];
+				corner1[t] = tri[t * 3 + 1];
+				corner2[t] = tri[t * 3 + 2];
+			}
+
+			__m256 x0, y0, z0, x1, y1, z1, x2, y2, z2;
+			gather_positions(positions, stride, corner0, x0, y0, z0);
+			gather_positions(positions, stride, corner1, x1, y1, z1);
+			gather_positions(positions, stride, corner2, x2, y2, z2);
+
+			__m256 ax = _mm256_sub_ps(x2, x0), ay = _mm256_sub_ps(y2, y0), az = _mm256_sub_ps(z2, z0);
+			__m256 bx = _mm256_sub_ps(x1, x0), by = _mm256_sub_ps(y1, y0), bz = _mm256_sub_ps(z1, z0);
+
+			__m256 nx = _mm256_sub_ps(_mm256_mul_ps(ay, bz), _mm256_mul_ps(by, az));
+			__m256 ny = _mm256_sub_ps(_mm256_mul_ps(az, bx), _mm256_mul_ps(bz, ax));
+			__m256 nz = _mm256_sub_ps(_mm256_mul_ps(ax, by), _mm256_mul_ps(bx, ay));
+
+			if (normalize)
+				normalize_avx2(nx, ny, nz);
+
+			//back to one normal per register, a half at a time
+			for (int half = 0; half < 2; half++)
+			{
+				__m128 hx = half ? _mm256_extractf128_ps(nx, 1) : _mm256_castps256_ps128(nx);
+				__m128 hy = half ? _mm256_extractf128_ps(ny, 1) : _mm256_castps256_ps128(ny);
+				__m128 hz = half ? _mm256_extractf128_ps(nz, 1) : _mm256_castps256_ps128(nz);
+				__m128 hw = _mm_setzero_ps();
+				_MM_TRANSPOSE4_PS(hx, hy, hz, hw);
+
+				float* out = normals + (f + half * 4) * 3;
+				store_xyz(out + 0, hx);
+				store_xyz(out + 3, hy);
+				store_xyz(out + 6, hz);
+				store_xyz(out + 9, hw);
+			}
+		}
+
+		assets::kernels::SSE2.face_normals(positions, stride, indices + f * 3, faceCount - f, normalize, normals + f * 3);
+	}
+
+	void normalize_soa_avx2(float* x, float* y, float* z, size_t count)
+	{
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			__m256 vx = _mm256_loadu_ps(x + i);
+			__m256 vy = _mm256_loadu_ps(y + i);
+			__m256 vz = _mm256_loadu_ps(z + i);
+			normalize_avx2(vx, vy, vz);
+			_mm256_storeu_ps(x + i, vx);
+			_mm256_storeu_ps(y + i, vy);
+			_mm256_storeu_ps(z + i, vz);
+		}
+
+		assets::kernels::SSE2.normalize(x + i, y + i, z + i, count - i);
+	}
+
+	void transform_points_avx2(const float m[16], const float* positions, size_t count, size_t stride, float* output, size_t outputStride)
+	{
+		const __m256 c0 = _mm256_broadcast_ps((const __m128*)(m + 0));
+		const __m256 c1 = _mm256_broadcast_ps((const __m128*)(m + 4));
+		const __m256 c2 = _mm256_broadcast_ps((const __m128*)(m + 8));
+		const __m256 c3 = _mm256_broadcast_ps((const __m128*)(m + 12));
+
+		//two points per register, one in each half
+		size_t i = 0;
+		for (; i + 2 <= count; i += 2)
+		{
+			__m256 p = combine(load_position(positions, stride, i), load_position(positions, stride, i + 1));
+			__m256 x = _mm256_permute_ps(p, _MM_SHUFFLE(0, 0, 0, 0));
+			__m256 y = _mm256_permute_ps(p, _MM_SHUFFLE(1, 1, 1, 1));
+			__m256 z = _mm256_permute_ps(p, _MM_SHUFFLE(2, 2, 2, 2));
+
+			__m256 r = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(c0, x), _mm256_mul_ps(c1, y)), _mm256_mul_ps(c2, z)), c3);
+			store_xyz((float*)((char*)output + i * outputStride), _mm256_castps256_ps128(r));
+			store_xyz((float*)((char*)output + (i + 1) * outputStride), _mm256_extractf128_ps(r, 1));
+		}
+
+		assets::kernels::SSE2.transform_points(m, position_at(positions, stride, i), count - i, stride,
+			(float*)((char*)output + i * outputStride), outputStride);
+	}
+}
+
+const assets::kernels::GeometryKernels assets::kernels::AVX2 = {
+	bounds_avx2,
+	max_distance_squared_avx2,
+	face_normals_avx2,
+	normalize_soa_avx2,
+	transform_points_avx2
+};
+
+#endif
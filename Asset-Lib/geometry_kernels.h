@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+//per instruction set implementations behind geometry.h, only included by the geometry sources
+namespace assets::kernels
+{
+	struct GeometryKernels
+	{
+		void (*bounds)(const float* positions, size_t count, size_t stride, float outMin[3], float outMax[3]);
+		float (*max_distance_squared)(const float* positions, size_t count, size_t stride, const float center[3]);
+		//unnormalized normals are the cross products, twice the triangle area long
+		void (*face_normals)(const float* positions, size_t stride, const uint32_t* indices, size_t faceCount, bool normalize, float* normals);
+		//normalizes count vectors stored as separate x, y and z arrays, zero vectors stay zero
+		void (*normalize)(float* x, float* y, float* z, size_t count);
+		void (*transform_points)(const float matrix[16], const float* positions, size_t count, size_t stride, float* output, size_t outputStride);
+	};
+
+	extern const GeometryKernels Scalar;
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ASSETS_GEOMETRY_SSE2
+	extern const GeometryKernels SSE2;
+#endif
+
+	//ASSETS_GEOMETRY_AVX2 is set by the build when geometry_avx2.cpp is compiled with avx2 enabled
+#ifdef ASSETS_GEOMETRY_AVX2
+	extern const GeometryKernels AVX2;
+#endif
+}
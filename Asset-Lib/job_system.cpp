@@ -0,0 +1,143 @@
+#include <job_system.h>
+
+#include <algorithm>
+
+namespace {
+
+	//queue of the calling thread, threads outside the pool share queue 0
+	thread_local const assets::JobSystem* currentSystem = nullptr;
+	thread_local uint32_t currentQueue = 0;
+}
+
+assets::JobSystem::JobSystem(uint32_t threadCount)
+{
+	if (threadCount == 0)
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+
+	queues.resize(threadCount);
+	for (auto& queue : queues)
+		queue = std::make_unique<JobQueue>();
+
+	for (uint32_t i = 1; i < threadCount; i++)
+		workers.emplace_back([this, i]() { worker_loop(i); });
+}
+
+assets::JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock{ sleepMutex };
+		stopping = true;
+	}
+	wake.notify_all();
+
+	for (auto& worker : workers)
+		worker.join();
+}
+
+void assets::JobSystem::run(JobGroup& group, std::function<void()> job)
+{
+	group.pending++;
+
+	uint32_t queueIndex = currentSystem == this ? currentQueue : 0;
+	{
+		std::lock_guard<std::mutex> lock{ queues[queueIndex]->mutex };
+		queues[queueIndex]->jobs.push_back(Job{ std::move(job), &group });
+		queuedJobs++;
+	}
+
+	//taking the lock orders the push before the sleeping threads check their condition
+	{
+		std::lock_guard<std::mutex> lock{ sleepMutex };
+	}
+	wake.notify_one();
+}
+
+void assets::JobSystem::wait(JobGroup& group)
+{
+	uint32_t queueIndex = currentSystem == this ? currentQueue : 0;
+
+	while (group.pending > 0)
+	{
+		Job job;
+		if (pop_job(queueIndex, job))
+		{
+			execute(job);
+			continue;
+		}
+
+		//the rest of the group is running on other threads
+		std::unique_lock<std::mutex> lock{ sleepMutex };
+		wake.wait(lock, [&]() { return group.pending == 0 || queuedJobs > 0; });
+	}
+}
+
+bool assets::JobSystem::pop_job(uint32_t queueIndex, Job& outJob)
+{
+	if (queuedJobs == 0)
+		return false;
+
+	//newest job of our own queue first
+	{
+		JobQueue& queue = *queues[queueIndex];
+		std::lock_guard<std::mutex> lock{ queue.mutex };
+		if (!queue.jobs.empty())
+		{
+			outJob = std::move(queue.jobs.back());
+			queue.jobs.pop_back();
+			queuedJobs--;
+			return true;
+		}
+	}
+
+	//then steal the oldest job of the other queues, it is the one most likely to spawn more work
+	for (size_t i = 1; i < queues.size(); i++)
+	{
+		JobQueue& queue = *queues[(queueIndex + i) % queues.size()];
+		std::lock_guard<std::mutex> lock{ queue.mutex };
+		if (!queue.jobs.empty())
+		{
+			outJob = std::move(queue.jobs.front());
+			queue.jobs.pop_front();
+			queuedJobs--;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void assets::JobSystem::execute(Job& job)
+{
+	job.function();
+
+	//the waiting thread may destroy the group as soon as it reaches 0, it is not touched after that
+	if (--job.group->pending == 0)
+	{
+		{
+			std::lock_guard<std::mutex> lock{ sleepMutex };
+		}
+		wake.notify_all();
+	}
+}
+
+void assets::JobSystem::worker_loop(uint32_t queueIndex)
+{
+	currentSystem = this;
+	currentQueue = queueIndex;
+
+	while (true)
+	{
+		Job job;
+		if (pop_job(queueIndex, job))
+		{
+			execute(job);
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock{ sleepMutex };
+		wake.wait(lock, [&]() { return stopping || queuedJobs > 0; });
+
+		if (stopping && queuedJobs == 0)
+			return;
+	}
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace assets
+{
+	//jobs added to a group can be waited on together, a group has to outlive its jobs
+	struct JobGroup
+	{
+		std::atomic<uint32_t> pending{ 0 };
+	};
+
+	//work stealing thread pool. every thread owns a queue and takes its newest job first, so nested jobs
+	//run while their data is still hot, idle threads steal the oldest job of another queue.
+	//threads waiting on a group run jobs until the group is done, so jobs can wait on the jobs they spawn
+	class JobSystem
+	{
+	public:
+		//threadCount includes the threads calling wait, 0 uses every hardware thread and 1 runs everything inside wait
+		explicit JobSystem(uint32_t threadCount = 0);
+		~JobSystem();
+
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+
+		void run(JobGroup& group, std::function<void()> job);
+
+		void wait(JobGroup& group);
+
+		uint32_t thread_count() const { return uint32_t(queues.size()); }
+
+	private:
+		struct Job
+		{
+			std::function<void()> function;
+			JobGroup* group;
+		};
+
+		struct JobQueue
+		{
+			std::mutex mutex;
+			std::deque<Job> jobs;
+		};
+
+		bool pop_job(uint32_t queueIndex, Job& outJob);
+		void execute(Job& job);
+		void worker_loop(uint32_t queueIndex);
+
+		//queue 0 is shared by every thread that is not one of the workers
+		std::vector<std::unique_ptr<JobQueue>> queues;
+		std::vector<std::thread> workers;
+
+		std::atomic<uint32_t> queuedJobs{ 0 };
+		bool stopping{ false };
+
+		std::mutex sleepMutex;
+		std::condition_variable wake;
+	};
+}
@@ -1,8 +1,65 @@
 #include "mesh_asset.h"
+#include "geometry.h"
 #include "json.hpp"
-#include "lz4.h"
 
 #include <stdio.h>
+#include <string.h>
+#include <type_traits>
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ASSETS_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace {
+	constexpr char MeshType[4] = { 'M','E','S','H' };
+	constexpr uint32_t MeshVersion = 3;
+
+	//fixed layout stored in the binary header of .mesh files, new fields only get appended
+	struct MeshHeader
+	{
+		uint32_t vertexBufferSize;
+		uint32_t vertexCount;
+		uint32_t faceCount;
+
+		uint32_t indexBufferSize;
+		uint32_t indexCount;
+		uint32_t indexSize;
+
+		uint32_t vertexFormat;
+
+		uint32_t compressionMode;
+		uint32_t vertexBlockSize;
+		uint32_t indexBlockSize;
+
+		float boundsOrigin[3];
+		float boundsRadius;
+		float boundsExtents[3];
+
+		//version 2
+		uint32_t meshletCount;
+		uint32_t meshletVertexCount;
+		uint32_t meshletTriangleCount;
+		uint32_t meshletBlockSize;
+
+		//version 3
+		uint32_t lodCount;
+		assets::MeshLod lods[assets::MaxMeshLods];
+	};
+	static_assert(std::is_trivially_copyable<MeshHeader>::value, "mesh header has to be POD");
+	static_assert(sizeof(assets::Meshlet) % 4 == 0, "meshlets are followed by the vertex index array");
+
+	//files from before lods were added hold only the full mesh
+	void fill_single_lod(assets::MeshInfo& info)
+	{
+		info.lodCount = 1;
+		info.lods[0].indexOffset = 0;
+		info.lods[0].indexCount = info.indexCount;
+		info.lods[0].error = 0.f;
+	}
+}
 
 assets::VertexFormat parse_format(const char* f)
 {
@@ -22,9 +79,59 @@ assets::VertexFormat parse_format(const char* f)
 
 assets::MeshInfo assets::read_mesh_info(AssetFile* file)
 {
-	MeshInfo info;
+	return read_mesh_info(make_view(*file));
+}
+
+assets::MeshInfo assets::read_mesh_info(const AssetView& file)
+{
+	//zeroed, so a file that is not a mesh comes back without vertices or index size and gets rejected
+	MeshInfo info = {};
+
+	MeshHeader header;
+	if (read_info_header(file, MeshType, header))
+	{
+		info.vertexBuferSize = header.vertexBufferSize;
+		info.vertexCount     = header.vertexCount;
+		info.faceCount       = header.faceCount;
+
+		info.indexBuferSize = header.indexBufferSize;
+		info.indexCount     = header.indexCount;
+		info.indexSize      = (char) header.indexSize;
+
+		memcpy(info.bounds.origin, header.boundsOrigin, sizeof(float) * 3);
+		info.bounds.radius = header.boundsRadius;
+		memcpy(info.bounds.extents, header.boundsExtents, sizeof(float) * 3);
+
+		info.vertexFormat = (VertexFormat) header.vertexFormat;
+
+		info.compressionMode = (CompressionMode) header.compressionMode;
+		info.vertexBlockSize = header.vertexBlockSize;
+		info.indexBlockSize  = header.indexBlockSize;
 
-	nlohmann::json metadata = nlohmann::json::parse(file->json);
+		//zeroed for version 1 files
+		info.meshletCount         = header.meshletCount;
+		info.meshletVertexCount   = header.meshletVertexCount;
+		info.meshletTriangleCount = header.meshletTriangleCount;
+		info.meshletBlockSize     = header.meshletBlockSize;
+
+		info.lodCount = std::min(header.lodCount, MaxMeshLods);
+		memcpy(info.lods, header.lods, sizeof(MeshLod) * info.lodCount);
+
+		if (info.lodCount == 0)
+			fill_single_lod(info);
+
+		return info;
+	}
+
+	//an info header of another type is not ours. files in the older json layout have no header and no type,
+	//the metadata is all they have
+	if (file.info || !file.json || file.jsonSize == 0)
+		return info;
+
+	//without a type the keys tell a mesh apart from a texture
+	nlohmann::json metadata = nlohmann::json::parse(file.json, file.json + file.jsonSize, nullptr, false);
+	if (!metadata.is_object() || !metadata.contains("vertex_count") || !metadata.contains("bounds"))
+		return info;
 
 	info.vertexBuferSize = metadata["vertex_buffer_size"];
 	info.vertexCount     = metadata["vertex_count"];
@@ -52,25 +159,105 @@ assets::MeshInfo assets::read_mesh_info(AssetFile* file)
 
 	std::string vertexFormat = metadata["vertex_format"];
 	info.vertexFormat = parse_format(vertexFormat.c_str());
+
+	//older files have no block sizes, they were always stored uncompressed
+	std::string compression = metadata.value("compression", "None");
+	info.compressionMode = parse_compression(compression.c_str());
+	info.vertexBlockSize = metadata.value("vertex_block_size", info.vertexBuferSize);
+	info.indexBlockSize  = metadata.value("index_block_size", info.indexBuferSize);
+
+	info.meshletCount         = 0;
+	info.meshletVertexCount   = 0;
+	info.meshletTriangleCount = 0;
+	info.meshletBlockSize     = 0;
+
+	fill_single_lod(info);
+
     return info;
 }
 
-void assets::unpack_mesh(MeshInfo* info, const char* sourcebuffer, size_t sourceSize, char* vertexBufer, char* indexBuffer)
+bool assets::unpack_mesh(MeshInfo* info, const char* sourcebuffer, size_t sourceSize, char* vertexBufer, char* indexBuffer)
+{
+	if (sourceSize < size_t(info->vertexBlockSize) + info->indexBlockSize)
+		return false;
+
+	//vertex block
+	if (!decompress_block(info->compressionMode, sourcebuffer, info->vertexBlockSize, vertexBufer, info->vertexBuferSize))
+		return false;
+
+	//index block
+	return decompress_block(info->compressionMode, sourcebuffer + info->vertexBlockSize, info->indexBlockSize, indexBuffer, info->indexBuferSize);
+}
+
+bool assets::unpack_mesh_packed(MeshInfo* info, const char* sourcebuffer, size_t sourceSize, Vertex_P32N8C8V16* vertexBufer, char* indexBuffer)
+{
+	if (info->vertexFormat == VertexFormat::P32N8C8V16)
+		return unpack_mesh(info, sourcebuffer, sourceSize, (char*)vertexBufer, indexBuffer);
+
+	if (info->vertexFormat != VertexFormat::PNCV_F32 || info->vertexBuferSize != info->vertexCount * sizeof(Vertex_f32_PNCV))
+		return false;
+
+	if (sourceSize < size_t(info->vertexBlockSize) + info->indexBlockSize)
+		return false;
+
+	if (info->compressionMode == CompressionMode::None)
+	{
+		if (info->vertexBlockSize != info->vertexBuferSize)
+			return false;
+
+		//the blob is only byte aligned, copy the vertices out in small runs before packing them
+		constexpr size_t Run = 256;
+		Vertex_f32_PNCV run[Run];
+		for (size_t first = 0; first < info->vertexCount; first += Run)
+		{
+			size_t count = std::min(Run, size_t(info->vertexCount) - first);
+			memcpy(run, sourcebuffer + first * sizeof(Vertex_f32_PNCV), count * sizeof(Vertex_f32_PNCV));
+			pack_vertices(run, count, vertexBufer + first);
+		}
+	}
+	else
+	{
+		std::vector<Vertex_f32_PNCV> fullVertices(info->vertexCount);
+		if (!decompress_block(info->compressionMode, sourcebuffer, info->vertexBlockSize, (char*)fullVertices.data(), info->vertexBuferSize))
+			return false;
+
+		pack_vertices(fullVertices.data(), fullVertices.size(), vertexBufer);
+	}
+
+	return decompress_block(info->compressionMode, sourcebuffer + info->vertexBlockSize, info->indexBlockSize, indexBuffer, info->indexBuferSize);
+}
+
+size_t assets::meshlet_buffer_size(const MeshInfo& info)
 {
-	//decompressing into temporal vector. TODO: streaming decompress directly on the buffers
-	std::vector<char> decompressedBuffer;
-	decompressedBuffer.resize(info->vertexBuferSize + info->indexBuferSize);
+	return info.meshletCount * sizeof(Meshlet) + info.meshletVertexCount * uint32_t(info.indexSize) + info.meshletTriangleCount * 3;
+}
 
-	LZ4_decompress_safe(sourcebuffer, decompressedBuffer.data(), static_cast<int>(sourceSize), static_cast<int>(decompressedBuffer.size()));
+bool assets::unpack_meshlets(MeshInfo* info, const char* sourcebuffer, size_t sourceSize, char* meshletBuffer)
+{
+	size_t blockOffset = size_t(info->vertexBlockSize) + info->indexBlockSize;
+	if (sourceSize < blockOffset + info->meshletBlockSize)
+		return false;
 
-	//copy vertex buffer
-	memcpy(vertexBufer, decompressedBuffer.data(), info->vertexBuferSize);
+	return decompress_block(info->compressionMode, sourcebuffer + blockOffset, info->meshletBlockSize, meshletBuffer, meshlet_buffer_size(*info));
+}
 
-	//copy index buffer
-	memcpy(indexBuffer, decompressedBuffer.data() + info->vertexBuferSize, info->indexBuferSize);
+assets::MeshletView assets::read_meshlets(const MeshInfo& info, const char* meshletBuffer)
+{
+	MeshletView view;
+	view.meshlets = (const Meshlet*)meshletBuffer;
+	view.meshletCount = info.meshletCount;
+	view.vertexIndexSize = uint32_t(info.indexSize);
+	view.vertices = meshletBuffer + info.meshletCount * sizeof(Meshlet);
+	view.triangles = (const uint8_t*)(view.vertices + info.meshletVertexCount * view.vertexIndexSize);
+	return view;
 }
 
-assets::AssetFile assets::pack_mesh(MeshInfo* info, char* vertexData, char* indexData)
+char assets::index_size_for(size_t vertexCount)
+{
+	return vertexCount <= 65536 ? 2 : 4;
+}
+
+assets::AssetFile assets::pack_mesh(MeshInfo* info, char* vertexData, char* indexData, const char* meshletData)
 {
 	AssetFile file;
 	nlohmann::json metadata;
@@ -108,79 +295,260 @@ assets::AssetFile assets::pack_mesh(MeshInfo* info, char* vertexData, char* inde
 
 	metadata["bounds"] = boundsData;
 
-	size_t fullsize = info->vertexBuferSize + info->indexBuferSize;
+	//compress vertex and index data as independent blocks
+	file.binaryBlob.reserve(info->vertexBuferSize + info->indexBuferSize);
+	info->vertexBlockSize = compress_block(info->compressionMode, vertexData, info->vertexBuferSize, file.binaryBlob);
+	info->indexBlockSize  = compress_block(info->compressionMode, indexData, info->indexBuferSize, file.binaryBlob);
 
-	// std::vector<char> merged_buffer;
-	// merged_buffer.resize(fullsize);
-	//
-	// //copy vertex buffer
-	// memcpy(merged_buffer.data(), vertexData, info->vertexBuferSize);
-	//
-	// //copy index buffer
-	// memcpy(merged_buffer.data() + info->vertexBuferSize, indexData, info->indexBuferSize);
+	if (meshletData && info->meshletCount > 0)
+	{
+		info->meshletBlockSize = compress_block(info->compressionMode, meshletData, meshlet_buffer_size(*info), file.binaryBlob);
+	}
+	else
+	{
+		info->meshletCount = 0;
+		info->meshletVertexCount = 0;
+		info->meshletTriangleCount = 0;
+		info->meshletBlockSize = 0;
+	}
 
-	file.binaryBlob.resize(fullsize);
-	//copy vertex buffer
-	memcpy(file.binaryBlob.data(), vertexData, info->vertexBuferSize);
+	metadata["compression"] = compression_name(info->compressionMode);
+	metadata["vertex_block_size"] = info->vertexBlockSize;
+	metadata["index_block_size"] = info->indexBlockSize;
+	metadata["meshlet_count"] = info->meshletCount;
 
-	//copy index buffer
-	memcpy(file.binaryBlob.data() + info->vertexBuferSize, indexData, info->indexBuferSize);
+	if (info->lodCount == 0)
+		fill_single_lod(*info);
 
-	//compress buffer and copy it into the file struct
-	// size_t compressStaging = LZ4_compressBound(static_cast<int>(fullsize));
+	for (uint32_t i = 0; i < info->lodCount; i++)
+	{
+		metadata["lods"].push_back({ info->lods[i].indexOffset, info->lods[i].indexCount, info->lods[i].error });
+	}
 
-	// file.binaryBlob.resize(compressStaging);
+	file.json = metadata.dump();
 
-	// int compressedSize = LZ4_compress_default(merged_buffer.data(), file.binaryBlob.data(), static_cast<int>(merged_buffer.size()), static_cast<int>(compressStaging));
-	// file.binaryBlob.resize(compressedSize);
+	MeshHeader header = {};
+	header.vertexBufferSize = info->vertexBuferSize;
+	header.vertexCount      = info->vertexCount;
+	header.faceCount        = info->faceCount;
 
-	metadata["compression"] = "None";
+	header.indexBufferSize = info->indexBuferSize;
+	header.indexCount      = info->indexCount;
+	header.indexSize       = info->indexSize;
 
-	file.json = metadata.dump();
+	header.vertexFormat = (uint32_t) info->vertexFormat;
+
+	header.compressionMode = (uint32_t) info->compressionMode;
+	header.vertexBlockSize = info->vertexBlockSize;
+	header.indexBlockSize  = info->indexBlockSize;
+
+	header.meshletCount         = info->meshletCount;
+	header.meshletVertexCount   = info->meshletVertexCount;
+	header.meshletTriangleCount = info->meshletTriangleCount;
+	header.meshletBlockSize     = info->meshletBlockSize;
+
+	header.lodCount = info->lodCount;
+	memcpy(header.lods, info->lods, sizeof(MeshLod) * info->lodCount);
+
+	memcpy(header.boundsOrigin, info->bounds.origin, sizeof(float) * 3);
+	header.boundsRadius = info->bounds.radius;
+	memcpy(header.boundsExtents, info->bounds.extents, sizeof(float) * 3);
+
+	memcpy(file.type, MeshType, 4);
+	file.version = MeshVersion;
+	file.info.resize(sizeof(MeshHeader));
+	memcpy(file.info.data(), &header, sizeof(MeshHeader));
 
 	return file;
 }
 
+uint32_t assets::select_mesh_lod(const MeshInfo& info, float pixelsPerUnit, float maxPixelError)
+{
+	//errors only grow along the chain
+	uint32_t lod = 0;
+	for (uint32_t i = 1; i < info.lodCount; i++)
+	{
+		if (info.lods[i].error * pixelsPerUnit > maxPixelError)
+			break;
+		lod = i;
+	}
+	return lod;
+}
+
 assets::MeshBounds assets::calculateBounds(Vertex_f32_PNCV* vertices, size_t count)
 {
 	MeshBounds bounds;
 
-	float min[3] = { std::numeric_limits<float>::max(),std::numeric_limits<float>::max(),std::numeric_limits<float>::max() };
-	float max[3] = { std::numeric_limits<float>::min(),std::numeric_limits<float>::min(),std::numeric_limits<float>::min() };
+	const float* positions = count > 0 ? vertices->position : nullptr;
+	Aabb box = compute_aabb(positions, count, sizeof(Vertex_f32_PNCV));
 
-	for (int i = 0; i < count; i++) {
-		min[0] = std::min(min[0], vertices[i].position[0]);
-		min[1] = std::min(min[1], vertices[i].position[1]);
-		min[2] = std::min(min[2], vertices[i].position[2]);
+	bounds.extents[0] = (box.max[0] - box.min[0]) / 2.0f;
+	bounds.extents[1] = (box.max[1] - box.min[1]) / 2.0f;
+	bounds.extents[2] = (box.max[2] - box.min[2]) / 2.0f;
 
-		max[0] = std::max(max[0], vertices[i].position[0]);
-		max[1] = std::max(max[1], vertices[i].position[1]);
-		max[2] = std::max(max[2], vertices[i].position[2]);
+	bounds.origin[0] = bounds.extents[0] + box.min[0];
+	bounds.origin[1] = bounds.extents[1] + box.min[1];
+	bounds.origin[2] = bounds.extents[2] + box.min[2];
+
+	//go through the vertices again to calculate the exact bounding sphere radius
+	bounds.radius = compute_bounding_radius(positions, count, sizeof(Vertex_f32_PNCV), bounds.origin);
+
+	return bounds;
+}
+
+uint16_t assets::float_to_half(float value)
+{
+	//scalar version of the SSE2 conversion below so both paths produce the same bits
+	uint32_t f;
+	memcpy(&f, &value, sizeof(float));
+
+	uint32_t sign = f & 0x80000000u;
+	uint32_t absf = f ^ sign;
+
+	uint32_t half;
+	if (absf >= (255u << 23))
+	{
+		//inf or nan
+		half = 0x7c00u | (absf > (255u << 23) ? 0x200u : 0u);
+	}
+	else
+	{
+		uint32_t noSticky = absf & ~0xfffu;
+		float magic;
+		uint32_t magicBits = 15u << 23;
+		memcpy(&magic, &magicBits, sizeof(float));
+
+		float scaled;
+		memcpy(&scaled, &noSticky, sizeof(float));
+		scaled *= magic;
+
+		float clampValue;
+		uint32_t clampBits = (31u << 23) - 0x1000u;
+		memcpy(&clampValue, &clampBits, sizeof(float));
+		scaled = std::min(scaled, clampValue);
+
+		uint32_t scaledBits;
+		memcpy(&scaledBits, &scaled, sizeof(float));
+		half = (scaledBits + 0x1000u) >> 13;
 	}
 
-	bounds.extents[0] = (max[0] - min[0]) / 2.0f;
-	bounds.extents[1] = (max[1] - min[1]) / 2.0f;
-	bounds.extents[2] = (max[2] - min[2]) / 2.0f;
+	return uint16_t(half | (sign >> 16));
+}
 
-	bounds.origin[0] = bounds.extents[0] + min[0];
-	bounds.origin[1] = bounds.extents[1] + min[1];
-	bounds.origin[2] = bounds.extents[2] + min[2];
+namespace {
+	int8_t pack_snorm8(float v)
+	{
+		v = std::min(std::max(v, -1.f), 1.f);
+		return int8_t(std::lrint(v * 127.f));
+	}
 
-	//go through the vertices again to calculate the exact bounding sphere radius
-	float r2 = 0;
-	for (int i = 0; i < count; i++) {
+	uint8_t pack_unorm8(float v)
+	{
+		v = std::min(std::max(v, 0.f), 1.f);
+		return uint8_t(std::lrint(v * 255.f));
+	}
+
+	void pack_vertex(const assets::Vertex_f32_PNCV& vertex, assets::Vertex_P32N8C8V16& output)
+	{
+		memcpy(output.position, vertex.position, sizeof(float) * 3);
 
-		float offset[3];
-		offset[0] = vertices[i].position[0] - bounds.origin[0];
-		offset[1] = vertices[i].position[1] - bounds.origin[1];
-		offset[2] = vertices[i].position[2] - bounds.origin[2];
+		for (int i = 0; i < 4; i++)
+		{
+			output.normal[i] = pack_snorm8(vertex.normal[i]);
+			output.color[i] = pack_unorm8(vertex.color[i]);
+		}
 
-		//pithagoras
-		float distance = offset[0] * offset[0] + offset[1] * offset[1] + offset[2] * offset[2];
-		r2 = std::max(r2, distance);
+		output.uv[0] = assets::float_to_half(vertex.uv[0]);
+		output.uv[1] = assets::float_to_half(vertex.uv[1]);
 	}
 
-	bounds.radius = std::sqrt(r2);
+#ifdef ASSETS_USE_SSE2
+	//4 wide float to half, see Fabian Giesen's float_to_half_SSE2
+	__m128i float_to_half_sse2(__m128 f)
+	{
+		const __m128i maskSign = _mm_set1_epi32(0x80000000u);
+		const __m128i maskRound = _mm_set1_epi32(~0xfffu);
+		const __m128i f32Infinity = _mm_set1_epi32(255 << 23);
+		const __m128i magic = _mm_set1_epi32(15 << 23);
+		const __m128i nanBit = _mm_set1_epi32(0x200);
+		const __m128i infinityAsHalf = _mm_set1_epi32(0x7c00);
+		const __m128i clampValue = _mm_set1_epi32((31 << 23) - 0x1000);
+
+		__m128 justSign = _mm_and_ps(_mm_castsi128_ps(maskSign), f);
+		__m128 absf = _mm_xor_ps(f, justSign);
+		__m128i absfInt = _mm_castps_si128(absf);
+
+		__m128i isNan = _mm_cmpgt_epi32(absfInt, f32Infinity);
+		__m128i isNormal = _mm_cmpgt_epi32(f32Infinity, absfInt);
+		__m128i infOrNan = _mm_or_si128(_mm_and_si128(isNan, nanBit), infinityAsHalf);
+
+		__m128 noSticky = _mm_and_ps(absf, _mm_castsi128_ps(maskRound));
+		__m128 scaled = _mm_mul_ps(noSticky, _mm_castsi128_ps(magic));
+		__m128 clamped = _mm_min_ps(scaled, _mm_castsi128_ps(clampValue));
+		__m128i biased = _mm_sub_epi32(_mm_castps_si128(clamped), maskRound);
+		__m128i shifted = _mm_srli_epi32(biased, 13);
+
+		__m128i joined = _mm_or_si128(_mm_and_si128(shifted, isNormal), _mm_andnot_si128(isNormal, infOrNan));
+		return _mm_or_si128(joined, _mm_srli_epi32(_mm_castps_si128(justSign), 16));
+	}
 
-	return bounds;
+	//packs 4 float lanes into 4 bytes, signed or unsigned saturation
+	uint32_t pack_bytes_sse2(__m128 v, __m128 minValue, __m128 maxValue, __m128 scale, bool isSigned)
+	{
+		v = _mm_min_ps(_mm_max_ps(v, minValue), maxValue);
+		__m128i ints = _mm_cvtps_epi32(_mm_mul_ps(v, scale));
+		__m128i words = _mm_packs_epi32(ints, ints);
+		__m128i bytes = isSigned ? _mm_packs_epi16(words, words) : _mm_packus_epi16(words, words);
+		return uint32_t(_mm_cvtsi128_si32(bytes));
+	}
+#endif
+}
+
+void assets::pack_vertices(const Vertex_f32_PNCV* vertices, size_t count, Vertex_P32N8C8V16* output)
+{
+	size_t i = 0;
+
+#ifdef ASSETS_USE_SSE2
+	const __m128 minusOne = _mm_set1_ps(-1.f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 snormScale = _mm_set1_ps(127.f);
+	const __m128 unormScale = _mm_set1_ps(255.f);
+
+	//two vertices per iteration so the uv conversion fills a whole register
+	for (; i + 2 <= count; i += 2)
+	{
+		const Vertex_f32_PNCV& a = vertices[i];
+		const Vertex_f32_PNCV& b = vertices[i + 1];
+		Vertex_P32N8C8V16& outA = output[i];
+		Vertex_P32N8C8V16& outB = output[i + 1];
+
+		memcpy(outA.position, a.position, sizeof(float) * 3);
+		memcpy(outB.position, b.position, sizeof(float) * 3);
+
+		uint32_t normalA = pack_bytes_sse2(_mm_loadu_ps(a.normal), minusOne, one, snormScale, true);
+		uint32_t normalB = pack_bytes_sse2(_mm_loadu_ps(b.normal), minusOne, one, snormScale, true);
+		memcpy(outA.normal, &normalA, 4);
+		memcpy(outB.normal, &normalB, 4);
+
+		uint32_t colorA = pack_bytes_sse2(_mm_loadu_ps(a.color), zero, one, unormScale, false);
+		uint32_t colorB = pack_bytes_sse2(_mm_loadu_ps(b.color), zero, one, unormScale, false);
+		memcpy(outA.color, &colorA, 4);
+		memcpy(outB.color, &colorB, 4);
+
+		__m128 uvs = _mm_setr_ps(a.uv[0], a.uv[1], b.uv[0], b.uv[1]);
+		alignas(16) uint32_t halfs[4];
+		_mm_store_si128((__m128i*)halfs, float_to_half_sse2(uvs));
+
+		outA.uv[0] = uint16_t(halfs[0]);
+		outA.uv[1] = uint16_t(halfs[1]);
+		outB.uv[0] = uint16_t(halfs[2]);
+		outB.uv[1] = uint16_t(halfs[3]);
+	}
+#endif
+
+	for (; i < count; i++)
+	{
+		pack_vertex(vertices[i], output[i]);
+	}
 }
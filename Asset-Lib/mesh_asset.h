@@ -1,6 +1,7 @@
 #pragma once
 
 #include <asset_loader.h>
+#include <compression.h>
 
 namespace assets
 {
@@ -12,13 +13,15 @@ namespace assets
 		float uv[4];
 	};
 
+	//24 bytes, the gpu reads it with SFLOAT / SNORM8 / UNORM8 / SFLOAT16 attribute formats
 	struct Vertex_P32N8C8V16
   {
-		float position[4];
-		float normal[4];
-		float color[4];
-		float uv[4];
+		float position[3];
+		int8_t normal[4];
+		uint8_t color[4];
+		uint16_t uv[2];
 	};
+	static_assert(sizeof(Vertex_P32N8C8V16) == 24, "packed vertex layout has to stay tight");
 
 	enum class VertexFormat : uint32_t
 	{
@@ -34,6 +37,53 @@ namespace assets
 		float extents[3];
 	};
 
+	//cluster of up to a few hundred triangles that can be culled on its own
+	struct Meshlet
+	{
+		//bounding sphere
+		float center[3];
+		float radius;
+
+		//normal cone, every triangle faces away from the camera when dot(normalize(coneApex - camera), coneAxis) >= coneCutoff
+		float coneApex[3];
+		float coneAxis[3];
+		float coneCutoff;
+
+		//ranges in the meshlet vertex and triangle arrays
+		uint32_t vertexOffset;
+		uint32_t triangleOffset;
+		uint32_t vertexCount;
+		uint32_t triangleCount;
+	};
+
+	constexpr uint32_t MaxMeshLods = 8;
+
+	//one level of detail, every lod is a range of the shared index buffer over the same vertices
+	struct MeshLod
+	{
+		uint32_t indexOffset;
+		uint32_t indexCount;
+		//object space distance the simplified surface can be away from the original one
+		float error;
+	};
+
+	//decoded meshlet block: Meshlet array | vertex indices into the mesh vertex buffer | uint8 triangles, 3 per triangle, indexing the meshlet vertices.
+	//the vertex indices have the same size as the mesh indices
+	struct MeshletView
+	{
+		const Meshlet* meshlets;
+		uint32_t meshletCount;
+
+		const char* vertices;
+		uint32_t vertexIndexSize;
+		const uint8_t* triangles;
+
+		uint32_t vertex(size_t i) const
+		{
+			return vertexIndexSize == 2 ? ((const uint16_t*)vertices)[i] : ((const uint32_t*)vertices)[i];
+		}
+	};
+
 	struct MeshInfo
   {
 		uint32_t vertexBuferSize;
@@ -42,20 +92,65 @@ namespace assets
 
 		uint32_t indexBuferSize;
 		uint32_t indexCount;
+		//2 or 4 bytes, meshes with up to 65536 vertices are baked with 16 bit indices
 		char indexSize;
 
 		MeshBounds bounds;
 
+		//lod 0 is the full mesh, files without lods report a single one covering every index
+		uint32_t lodCount;
+		MeshLod lods[MaxMeshLods];
+
 		VertexFormat vertexFormat;
 
+		//vertex and index data are compressed as separate blocks so each one decodes straight into its buffer
+		CompressionMode compressionMode;
+		uint32_t vertexBlockSize;
+		uint32_t indexBlockSize;
+
+		//meshlets are optional, they are stored as a third block after the indices
+		uint32_t meshletCount;
+		uint32_t meshletVertexCount;
+		uint32_t meshletTriangleCount;
+		uint32_t meshletBlockSize;
+
 		std::string originalFile;
 	};
 
 	MeshInfo read_mesh_info(AssetFile* file);
 
-	void unpack_mesh(MeshInfo* info, const char* sourcebuffer, size_t sourceSize, char* vertexBufer, char* indexBuffer);
+	MeshInfo read_mesh_info(const AssetView& file);
+
+	//decodes the blob directly into the destination buffers, they can be mapped gpu memory
+	bool unpack_mesh(MeshInfo* info, const char* sourcebuffer, size_t sourceSize, char* vertexBufer, char* indexBuffer);
 
-	AssetFile pack_mesh(MeshInfo* info, char* vertexData, char* indexData);
+	//decodes the blob directly into the gpu vertex layout, quantizing full precision vertices on the way.
+	//uncompressed ones are packed straight from the blob, compressed ones go through one scratch decode
+	bool unpack_mesh_packed(MeshInfo* info, const char* sourcebuffer, size_t sourceSize, Vertex_P32N8C8V16* vertexBufer, char* indexBuffer);
 
+	//size of the meshlet block once decoded
+	size_t meshlet_buffer_size(const MeshInfo& info);
+
+	//decodes the meshlet block into meshletBuffer, which has to hold meshlet_buffer_size bytes
+	bool unpack_meshlets(MeshInfo* info, const char* sourcebuffer, size_t sourceSize, char* meshletBuffer);
+
+	MeshletView read_meshlets(const MeshInfo& info, const char* meshletBuffer);
+
+	//smallest index size, in bytes, that can address vertexCount vertices
+	char index_size_for(size_t vertexCount);
+
+	//meshletData holds meshlet_buffer_size bytes laid out like MeshletView, it is ignored when meshletCount is 0
+	AssetFile pack_mesh(MeshInfo* info, char* vertexData, char* indexData, const char* meshletData = nullptr);
+
+	//most simplified lod whose error stays under maxPixelError on screen.
+	//pixelsPerUnit is how many pixels one object space unit covers at the distance of the mesh
+	uint32_t select_mesh_lod(const MeshInfo& info, float pixelsPerUnit, float maxPixelError);
+
+	//box around the positions, and the sphere around the box center that holds every one of them
 	MeshBounds calculateBounds(Vertex_f32_PNCV* vertices, size_t count);
+
+	//quantizes full precision vertices, uses SSE2 when available
+	void pack_vertices(const Vertex_f32_PNCV* vertices, size_t count, Vertex_P32N8C8V16* output);
+
+	uint16_t float_to_half(float value);
 }
@@ -1,68 +1,223 @@
 #include <texture_asset.h>
 
 #include <string>
+#include <cstring>
+#include <type_traits>
+#include <algorithm>
 #include <json.hpp>
-#include <lz4.h>
+
+namespace {
+  constexpr char TextureType[4] = { 'T','E','X','I' };
+  constexpr uint32_t TextureVersion = 2;
+
+  //fixed layout stored in the binary header of .tx files, new fields only get appended
+  struct TextureHeader
+  {
+    uint64_t textureSize;
+    uint32_t textureFormat;
+    uint32_t width;
+    uint32_t height;
+    uint32_t compressionMode;
+
+    //version 2
+    uint32_t levelCount;
+    uint32_t padding;
+    assets::TextureLevel levels[assets::MaxTextureLevels];
+  };
+
+  //files from before mip support hold one level covering the whole blob
+  void fill_single_level(assets::TextureInfo& info, uint64_t blockSize)
+  {
+    info.levelCount = 1;
+    info.levels[0].width = info.pixelsize[0];
+    info.levels[0].height = info.pixelsize[1];
+    info.levels[0].offset = 0;
+    info.levels[0].size = info.textureSize;
+    info.levels[0].blockSize = blockSize;
+  }
+  static_assert(std::is_trivially_copyable<TextureHeader>::value, "texture header has to be POD");
+}
 
 assets::TextureFormat assets::parse_format(const char* f)
 {
   if (strcmp(f, "RGBA8") == 0)
     return assets::TextureFormat::RGBA8;
 
+  else if (strcmp(f, "BC1") == 0)
+    return assets::TextureFormat::BC1;
+
+  else if (strcmp(f, "BC3") == 0)
+    return assets::TextureFormat::BC3;
+
+  else if (strcmp(f, "BC7") == 0)
+    return assets::TextureFormat::BC7;
+
   else
     return assets::TextureFormat::Unknown;
 }
 
+const char* assets::format_name(TextureFormat format)
+{
+  switch (format)
+  {
+    case TextureFormat::RGBA8:
+      return "RGBA8";
+    case TextureFormat::BC1:
+      return "BC1";
+    case TextureFormat::BC3:
+      return "BC3";
+    case TextureFormat::BC7:
+      return "BC7";
+    default:
+      return "Unknown";
+  }
+}
+
+bool assets::is_block_compressed(TextureFormat format)
+{
+  return format == TextureFormat::BC1 || format == TextureFormat::BC3 || format == TextureFormat::BC7;
+}
+
+uint64_t assets::texture_level_size(TextureFormat format, uint32_t width, uint32_t height)
+{
+  uint64_t blocks = uint64_t((width + 3) / 4) * ((height + 3) / 4);
+
+  switch (format)
+  {
+    case TextureFormat::BC1:
+      return blocks * 8;
+    case TextureFormat::BC3:
+    case TextureFormat::BC7:
+      return blocks * 16;
+    default:
+      return uint64_t(width) * height * 4;
+  }
+}
+
 assets::AssetFile assets::pack_texture(assets::TextureInfo* info, void* pixelData)
 {
   AssetFile file;
 
   nlohmann::json texture_metadata;
-  texture_metadata["format"] = "RGBA8";
+  texture_metadata["format"] = format_name(info->textureFormat);
   texture_metadata["width"] = info->pixelsize[0];
   texture_metadata["height"] = info->pixelsize[1];
   texture_metadata["buffer_size"] = info->textureSize;
   texture_metadata["original_file"] = info->originalFile;
-  texture_metadata["compression"] = "";
+  texture_metadata["compression"] = compression_name(info->compressionMode);
+
+  if (info->levelCount == 0)
+    fill_single_level(*info, 0);
+
+  //every level is an independent block so it can be decoded straight to its place in a staging buffer
+  file.binaryBlob.reserve(info->textureSize);
+  for (uint32_t i = 0; i < info->levelCount; i++)
+  {
+    TextureLevel& level = info->levels[i];
+    level.blockSize = compress_block(info->compressionMode, (const char*)pixelData + level.offset, level.size, file.binaryBlob);
+
+    texture_metadata["levels"].push_back({ level.width, level.height, level.size, level.blockSize });
+  }
+
   std::string stringified = texture_metadata.dump();
 	file.json = stringified;
 
-  // int compressStaging = LZ4_compressBound(info->textureSize);
-	file.binaryBlob.resize(info->textureSize);
-  memcpy(file.binaryBlob.data(), pixelData, info->textureSize);
-	// int compressedSize = LZ4_compress_default((const char*)pixelData, file.binaryBlob.data(), info->textureSize, compressStaging);
-	// file.binaryBlob.resize(compressedSize);
+  TextureHeader header = {};
+  header.textureSize = info->textureSize;
+  header.textureFormat = (uint32_t) info->textureFormat;
+  header.width = info->pixelsize[0];
+  header.height = info->pixelsize[1];
+  header.compressionMode = (uint32_t) info->compressionMode;
+  header.levelCount = info->levelCount;
+  memcpy(header.levels, info->levels, sizeof(TextureLevel) * info->levelCount);
+
+  memcpy(file.type, TextureType, 4);
+  file.version = TextureVersion;
+  file.info.resize(sizeof(TextureHeader));
+  memcpy(file.info.data(), &header, sizeof(TextureHeader));
 
   return file;
 }
 
 assets::TextureInfo assets::read_texture_info(assets::AssetFile* file)
 {
-  TextureInfo info;
+  return read_texture_info(make_view(*file));
+}
 
-  nlohmann::json texture_metadata = nlohmann::json::parse(file->json);
+assets::TextureInfo assets::read_texture_info(const assets::AssetView& file)
+{
+  //zeroed, so a file that is not a texture comes back with no levels and an unknown format
+  TextureInfo info = {};
+
+  TextureHeader header;
+  if (read_info_header(file, TextureType, header))
+  {
+    info.textureSize = header.textureSize;
+    info.textureFormat = (TextureFormat) header.textureFormat;
+    info.pixelsize[0] = header.width;
+    info.pixelsize[1] = header.height;
+    info.pixelsize[2] = 1;
+    info.compressionMode = (CompressionMode) header.compressionMode;
+
+    info.levelCount = std::min(header.levelCount, MaxTextureLevels);
+    memcpy(info.levels, header.levels, sizeof(TextureLevel) * info.levelCount);
+
+    if (info.levelCount == 0)
+      fill_single_level(info, file.blobSize);
+
+    return info;
+  }
+
+  //an info header of another type is not ours. files in the older json layout have no header and no type,
+  //the metadata is all they have
+  if (file.info || !file.json || file.jsonSize == 0)
+    return info;
+
+  //without a type the keys tell a texture apart from a mesh
+  nlohmann::json texture_metadata = nlohmann::json::parse(file.json, file.json + file.jsonSize, nullptr, false);
+  if (!texture_metadata.is_object() || !texture_metadata.contains("format") || !texture_metadata.contains("width"))
+    return info;
 
   std::string formatString = texture_metadata["format"];
   info.textureFormat = parse_format(formatString.c_str());
 
   std::string compressionString = texture_metadata["compression"];
+  info.compressionMode = parse_compression(compressionString.c_str());
 
   info.textureSize = texture_metadata["buffer_size"];
 
   info.pixelsize[0] = texture_metadata["width"];
   info.pixelsize[1] = texture_metadata["height"];
+  info.pixelsize[2] = 1;
 
   info.originalFile = texture_metadata["original_file"];
 
+  fill_single_level(info, file.blobSize);
+
 	return info;
 }
 
-void assets::unpack_texture(TextureInfo* info, const char* sourcebuffer, size_t sourceSize, char* destination)
+bool assets::unpack_texture(TextureInfo* info, const char* sourcebuffer, size_t sourceSize, char* destination)
+{
+  for (uint32_t i = 0; i < info->levelCount; i++)
+  {
+    if (!unpack_texture_level(info, i, sourcebuffer, sourceSize, destination + info->levels[i].offset))
+      return false;
+  }
+
+  return true;
+}
+
+bool assets::unpack_texture_level(TextureInfo* info, uint32_t level, const char* sourcebuffer, size_t sourceSize, char* destination)
 {
-  // if (info->compressionMode == CompressionMode::LZ4)
-	// 	LZ4_decompress_safe(sourcebuffer, destination, sourceSize, info->textureSize);
-  //
-	// else
-    memcpy(destination, sourcebuffer, sourceSize);
+  //blocks are stored back to back in level order
+  uint64_t blockOffset = 0;
+  for (uint32_t i = 0; i < level; i++)
+    blockOffset += info->levels[i].blockSize;
+
+  const TextureLevel& textureLevel = info->levels[level];
+  if (blockOffset + textureLevel.blockSize > sourceSize)
+    return false;
 
+  return decompress_block(info->compressionMode, sourcebuffer + blockOffset, textureLevel.blockSize, destination, textureLevel.size);
 }
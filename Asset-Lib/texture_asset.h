@@ -1,13 +1,31 @@
 #pragma once
 
 #include "asset_loader.h"
+#include "compression.h"
 
 namespace assets
 {
 	enum class TextureFormat
 	{
 		Unknown = 0,
-		RGBA8
+		RGBA8,
+		BC1, //rgb 4x4 blocks of 8 bytes, 1 bit alpha
+		BC3, //bc1 color plus interpolated alpha, 16 bytes per block
+		BC7  //rgba 4x4 blocks of 16 bytes, best quality
+	};
+
+	constexpr uint32_t MaxTextureLevels = 16;
+
+	//one mip level, levels are stored largest first and each one is its own compressed block
+	struct TextureLevel
+	{
+		uint32_t width;
+		uint32_t height;
+		//position and size of the level once decoded
+		uint64_t offset;
+		uint64_t size;
+		//size of the level inside the blob
+		uint64_t blockSize;
 	};
 
 	struct TextureInfo
@@ -15,15 +33,34 @@ namespace assets
 		uint64_t textureSize;
 		TextureFormat textureFormat;
 		uint32_t pixelsize[3];
+		CompressionMode compressionMode;
+
+		uint32_t levelCount;
+		TextureLevel levels[MaxTextureLevels];
+
 		std::string originalFile;
 	};
 
 	//parses the texture metadata from an asset file
 	TextureInfo read_texture_info(AssetFile* file);
 
-	void unpack_texture(TextureInfo* info, const char* sourcebuffer, size_t sourceSize, char* destination);
+	TextureInfo read_texture_info(const AssetView& file);
 
+	//decodes every level directly into destination, which has to hold textureSize bytes
+	bool unpack_texture(TextureInfo* info, const char* sourcebuffer, size_t sourceSize, char* destination);
+
+	//decodes a single level into destination, which has to hold levels[level].size bytes
+	bool unpack_texture_level(TextureInfo* info, uint32_t level, const char* sourcebuffer, size_t sourceSize, char* destination);
+
+	//pixelData holds every level at the offsets set in info->levels, the block sizes are filled here
 	AssetFile pack_texture(TextureInfo* info, void* pixelData);
 
 	TextureFormat parse_format(const char* f);
+
+	const char* format_name(TextureFormat format);
+
+	bool is_block_compressed(TextureFormat format);
+
+	//size of one level of the given format once decoded, block formats round the size up to whole 4x4 blocks
+	uint64_t texture_level_size(TextureFormat format, uint32_t width, uint32_t height);
 }
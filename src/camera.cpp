@@ -16,3 +16,20 @@ glm::mat4 Camera::get_projection()
 
   return projection;
 }
+
+void Camera::get_frustum_planes(glm::vec4 outPlanes[6])
+{
+	//rows of the view projection matrix, glm stores columns
+	glm::mat4 viewproj = glm::transpose(get_projection() * get_view());
+
+	outPlanes[0] = viewproj[3] + viewproj[0];
+	outPlanes[1] = viewproj[3] - viewproj[0];
+	outPlanes[2] = viewproj[3] + viewproj[1];
+	outPlanes[3] = viewproj[3] - viewproj[1];
+	//vulkan clips depth to [0, w]
+	outPlanes[4] = viewproj[2];
+	outPlanes[5] = viewproj[3] - viewproj[2];
+
+	for (int i = 0; i < 6; i++)
+		outPlanes[i] /= glm::length(glm::vec3(outPlanes[i]));
+}
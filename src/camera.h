@@ -15,6 +15,10 @@ public:
     glm::mat4 get_view();
     glm::mat4 get_projection();
 
+    //left, right, bottom, top, near and far, normalized and facing inwards: a point p is inside
+    //when dot(plane.xyz, p) + plane.w >= 0 for all of them
+    void get_frustum_planes(glm::vec4 outPlanes[6]);
+
 private:
   glm::mat4 view;
   glm::mat4 projection;
@@ -0,0 +1,194 @@
+#include <vk_culling.h>
+#include <vk_culling_kernels.h>
+
+#include <vk_engine.h>
+#include <geometry.h>
+#include <job_system.h>
+
+#include <algorithm>
+#include <limits>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define CULL_SSE
+#endif
+
+namespace {
+
+	//arrays are padded for the widest path, the narrower ones simply take two steps
+	constexpr size_t Lanes = 8;
+
+	//below this a job costs more than the culling it does
+	constexpr size_t MinObjectsPerJob = 16 * 1024;
+
+	size_t pad_to_lanes(size_t count)
+	{
+		return (count + Lanes - 1) / Lanes * Lanes;
+	}
+
+#ifdef VK_CULLING_AVX
+	//the cpu checks of the geometry kernels, avx2 implies avx
+	bool use_avx()
+	{
+		return assets::active_simd_level() >= assets::SimdLevel::AVX2;
+	}
+#endif
+}
+
+using culling::emit_visible;
+
+void FrustumCuller::build(const std::vector<RenderObject>& objects)
+{
+	_objectCount = objects.size();
+	size_t padded = pad_to_lanes(_objectCount);
+
+	//the padding fails every plane test
+	_centerX.assign(padded, 0.f);
+	_centerY.assign(padded, 0.f);
+	_centerZ.assign(padded, 0.f);
+	_radius.assign(padded, -std::numeric_limits<float>::infinity());
+
+	_pending.clear();
+	for (size_t i = 0; i < _objectCount; i++)
+	{
+		const RenderObject& object = objects[i];
+		if (object.mesh->residency == Residency::Resident)
+		{
+			set_sphere(i, object.mesh->mesh.boundingSphere, object.transform);
+		}
+		else
+		{
+			_radius[i] = std::numeric_limits<float>::infinity();
+			_pending.push_back({ uint32_t(i), object.mesh, object.transform });
+		}
+	}
+}
+
+void FrustumCuller::update_bounds()
+{
+	//the spheres are kept once known, evicting the mesh later does not lose them
+	auto known = std::remove_if(_pending.begin(), _pending.end(), [&](const PendingBounds& pending) {
+		if (pending.mesh->residency != Residency::Resident)
+			return false;
+
+		set_sphere(pending.object, pending.mesh->mesh.boundingSphere, pending.transform);
+		return true;
+	});
+	_pending.erase(known, _pending.end());
+}
+
+void FrustumCuller::set_sphere(size_t index, const glm::vec4& localSphere, const glm::mat4& transform)
+{
+	//same as the gpu culling, the radius grows with the largest scale axis
+	glm::vec3 center = transform * glm::vec4(glm::vec3(localSphere), 1.f);
+	float scale = std::max(std::max(glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1]))), glm::length(glm::vec3(transform[2])));
+
+	_centerX[index] = center.x;
+	_centerY[index] = center.y;
+	_centerZ[index] = center.z;
+	_radius[index] = localSphere.w * scale;
+}
+
+void FrustumCuller::cull(const glm::vec4 planes[6], std::vector<uint32_t>& outVisible, assets::JobSystem* jobs) const
+{
+	//every range writes its visible objects at its own start, they are packed together after
+	size_t padded = _radius.size();
+	outVisible.resize(padded);
+
+	size_t rangeCount = 1;
+	if (jobs)
+	{
+		rangeCount = std::max<size_t>(1, std::min<size_t>(jobs->thread_count(), padded / MinObjectsPerJob));
+	}
+
+	if (rangeCount == 1)
+	{
+		outVisible.resize(cull_range(planes, 0, padded, outVisible.data()));
+		return;
+	}
+
+	std::vector<size_t> begins(rangeCount + 1);
+	std::vector<size_t> visibleCounts(rangeCount);
+	for (size_t range = 0; range <= rangeCount; range++)
+		begins[range] = pad_to_lanes(padded * range / rangeCount);
+
+	assets::JobGroup cullGroup;
+	for (size_t range = 0; range < rangeCount; range++)
+	{
+		jobs->run(cullGroup, [&, range]() {
+			visibleCounts[range] = cull_range(planes, begins[range], begins[range + 1], outVisible.data() + begins[range]);
+		});
+	}
+	jobs->wait(cullGroup);
+
+	size_t visible = visibleCounts[0];
+	for (size_t range = 1; range < rangeCount; range++)
+	{
+		uint32_t* rangeVisible = outVisible.data() + begins[range];
+		std::copy(rangeVisible, rangeVisible + visibleCounts[range], outVisible.data() + visible);
+		visible += visibleCounts[range];
+	}
+	outVisible.resize(visible);
+}
+
+size_t FrustumCuller::cull_range(const glm::vec4 planes[6], size_t begin, size_t end, uint32_t* out) const
+{
+	size_t count = 0;
+
+#if defined(VK_CULLING_AVX)
+	if (use_avx())
+	{
+		culling::SphereArrays spheres = { _centerX.data(), _centerY.data(), _centerZ.data(), _radius.data() };
+		return culling::cull_range_avx(spheres, &planes[0].x, begin, end, out);
+	}
+#endif
+
+#if defined(CULL_SSE)
+	__m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; p++)
+	{
+		planeX[p] = _mm_set1_ps(planes[p].x);
+		planeY[p] = _mm_set1_ps(planes[p].y);
+		planeZ[p] = _mm_set1_ps(planes[p].z);
+		planeW[p] = _mm_set1_ps(planes[p].w);
+	}
+
+	const __m128 zero = _mm_setzero_ps();
+	for (size_t i = begin; i < end; i += 4)
+	{
+		__m128 x = _mm_loadu_ps(&_centerX[i]);
+		__m128 y = _mm_loadu_ps(&_centerY[i]);
+		__m128 z = _mm_loadu_ps(&_centerZ[i]);
+		__m128 negRadius = _mm_sub_ps(zero, _mm_loadu_ps(&_radius[i]));
+
+		__m128 inside = _mm_cmpeq_ps(zero, zero);
+		for (int p = 0; p < 6; p++)
+		{
+			__m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, planeX[p]), _mm_mul_ps(y, planeY[p])),
+				_mm_add_ps(_mm_mul_ps(z, planeZ[p]), planeW[p]));
+			inside = _mm_and_ps(inside, _mm_cmpgt_ps(distance, negRadius));
+		}
+
+		int mask = _mm_movemask_ps(inside);
+		if (mask != 0)
+		{
+			count = emit_visible(out, count, uint32_t(i), mask, 4);
+		}
+	}
+#else
+	for (size_t i = begin; i < end; i++)
+	{
+		bool inside = true;
+		for (int p = 0; p < 6; p++)
+		{
+			float distance = _centerX[i] * planes[p].x + _centerY[i] * planes[p].y + _centerZ[i] * planes[p].z + planes[p].w;
+			inside = inside && distance > -_radius[i];
+		}
+
+		out[count] = uint32_t(i);
+		count += inside ? 1 : 0;
+	}
+#endif
+
+	return count;
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace assets {
+	class JobSystem;
+}
+
+struct RenderObject;
+struct CachedMesh;
+
+//frustum culls the render objects on the cpu. the world space bounding spheres are kept as separate x, y, z
+//and radius arrays, so a single sse or avx instruction tests 4 or 8 objects against a plane and the visible
+//ones are written out without a branch per object
+class FrustumCuller {
+public:
+	//takes the transforms and meshes of the objects, again every time they change
+	void build(const std::vector<RenderObject>& objects);
+
+	//picks up the bounds of meshes streamed in since the last call. until its mesh was resident once an
+	//object has no bounds and is always visible, drawing it is what streams the mesh in
+	void update_bounds();
+
+	//indices of the objects inside the planes of Camera::get_frustum_planes, ascending.
+	//big scenes are split over the job system when there is one
+	void cull(const glm::vec4 planes[6], std::vector<uint32_t>& outVisible, assets::JobSystem* jobs = nullptr) const;
+
+	size_t object_count() const { return _objectCount; }
+
+private:
+	//writes the visible objects of [begin, end) to out and returns how many, both multiples of Lanes
+	size_t cull_range(const glm::vec4 planes[6], size_t begin, size_t end, uint32_t* out) const;
+
+	void set_sphere(size_t index, const glm::vec4& localSphere, const glm::mat4& transform);
+
+	struct PendingBounds {
+		uint32_t object;
+		CachedMesh* mesh;
+		glm::mat4 transform;
+	};
+
+	//padded to a multiple of 8 with spheres that are never visible
+	std::vector<float> _centerX;
+	std::vector<float> _centerY;
+	std::vector<float> _centerZ;
+	std::vector<float> _radius;
+	size_t _objectCount{ 0 };
+
+	//objects whose mesh bounds are not known yet
+	std::vector<PendingBounds> _pending;
+};
@@ -0,0 +1,46 @@
+#include <vk_culling_kernels.h>
+
+//built with avx code generation, only called once the cpu has been checked for it
+#ifdef VK_CULLING_AVX
+#include <immintrin.h>
+
+size_t culling::cull_range_avx(const SphereArrays& spheres, const float planes[24], size_t begin, size_t end, uint32_t* out)
+{
+	size_t count = 0;
+
+	__m256 planeX[6], planeY[6], planeZ[6], planeW[6];
+	for (int p = 0; p < 6; p++)
+	{
+		planeX[p] = _mm256_set1_ps(planes[p * 4 + 0]);
+		planeY[p] = _mm256_set1_ps(planes[p * 4 + 1]);
+		planeZ[p] = _mm256_set1_ps(planes[p * 4 + 2]);
+		planeW[p] = _mm256_set1_ps(planes[p * 4 + 3]);
+	}
+
+	const __m256 zero = _mm256_setzero_ps();
+	for (size_t i = begin; i < end; i += 8)
+	{
+		__m256 x = _mm256_loadu_ps(spheres.centerX + i);
+		__m256 y = _mm256_loadu_ps(spheres.centerY + i);
+		__m256 z = _mm256_loadu_ps(spheres.centerZ + i);
+		__m256 negRadius = _mm256_sub_ps(zero, _mm256_loadu_ps(spheres.radius + i));
+
+		//inside or touching every plane
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (int p = 0; p < 6; p++)
+		{
+			__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, planeX[p]), _mm256_mul_ps(y, planeY[p])),
+				_mm256_add_ps(_mm256_mul_ps(z, planeZ[p]), planeW[p]));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negRadius, _CMP_GT_OQ));
+		}
+
+		int mask = _mm256_movemask_ps(inside);
+		if (mask != 0)
+		{
+			count = emit_visible(out, count, uint32_t(i), mask, 8);
+		}
+	}
+
+	return count;
+}
+#endif
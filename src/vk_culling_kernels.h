@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+//per instruction set paths behind FrustumCuller, only included by the culling sources. nothing here may pull
+//in inline code shared with other sources, the avx one is built with avx code generation
+namespace culling {
+
+	//the sphere arrays of FrustumCuller, padded to a multiple of 8
+	struct SphereArrays {
+		const float* centerX;
+		const float* centerY;
+		const float* centerZ;
+		const float* radius;
+	};
+
+	//VK_CULLING_AVX is set by the build when vk_culling_avx.cpp is compiled with avx enabled
+#ifdef VK_CULLING_AVX
+	//planes are 6 times x, y, z and w
+	size_t cull_range_avx(const SphereArrays& spheres, const float planes[24], size_t begin, size_t end, uint32_t* out);
+#endif
+
+	namespace {
+		//writes every lane and only advances past the visible ones, out needs room for all of them
+		inline size_t emit_visible(uint32_t* out, size_t count, uint32_t first, int mask, int lanes)
+		{
+			for (int lane = 0; lane < lanes; lane++)
+			{
+				out[count] = first + lane;
+				count += (mask >> lane) & 1;
+			}
+			return count;
+		}
+	}
+}
@@ -53,11 +53,32 @@ void VulkanEngine::init()
 	init_descriptors();
 	init_pipeline();
 
+	if (assets::open_archive("../assets/assets_export/assets.pak", _assetArchive))
+	{
+		_mainDeletionQueue.push([=]() {
+			assets::close_archive(_assetArchive);
+		});
+	}
+
+	_uploader.init(this);
+	_geometryPool.init(this);
+	_streamer.init(this);
+	_resourceCache.init(this, &_streamer);
+
+	//both only register the assets, they are streamed in when first drawn
 	load_meshes();
 	load_images();
 
 	init_scene();
 
+	//the scene does not change after this, it is uploaded once for the gpu driven path
+	_gpuDriven.init(this);
+	if (_gpuDriven.supported())
+	{
+		_gpuDriven.build(_renderables);
+	}
+	_culler.build(_renderables);
+
 	init_imgui();
 
 	_isInitialized = true;
@@ -65,11 +86,14 @@ void VulkanEngine::init()
 
 void VulkanEngine::init_vulkan()
 {
-	//instance creation
+	//instance creation, 1.2 when the loader has it for the timeline semaphores of the upload queue
+	uint32_t loader_version = VK_API_VERSION_1_1;
+	vkEnumerateInstanceVersion(&loader_version);
+
 	vkb::InstanceBuilder instace_builder;
 	auto instance_builder_result = instace_builder.set_app_name("vkguide")
 										 														.request_validation_layers(true)
-										 														.require_api_version(1, 1, 0)
+										 														.require_api_version(1, loader_version >= VK_API_VERSION_1_2 ? 2 : 1, 0)
 										 														.use_default_debug_messenger()
 										 														.build();
 	vkb::Instance vkb_instance = instance_builder_result.value();
@@ -80,11 +104,21 @@ void VulkanEngine::init_vulkan()
 	//surface creation
 	SDL_Vulkan_CreateSurface(_window, _instance, &_surface);
 
-	//physical device selection
+	//physical device selection, block compressed textures are enabled when the gpu can sample them
+	VkPhysicalDeviceFeatures required_features = {};
+	required_features.textureCompressionBC = VK_TRUE;
+
 	vkb::PhysicalDeviceSelector physical_device_selector { vkb_instance };
 	auto physical_selector_result = physical_device_selector.set_minimum_version(1, 1)
 																													.set_surface(_surface)
+																													.set_required_features(required_features)
 																													.select();
+	_textureCompressionBC = bool(physical_selector_result);
+	if (!physical_selector_result)
+	{
+		physical_selector_result = physical_device_selector.set_required_features(VkPhysicalDeviceFeatures{}).select();
+	}
+
   if (!physical_selector_result)
 	{
 		std::cerr << "Failed to select Vulkan Physical Device. Error: " << physical_selector_result.error().message() << "\n";
@@ -95,8 +129,40 @@ void VulkanEngine::init_vulkan()
 
 	_physical_device = vkb_physical_device.physical_device;
 
+	//indirect draws of the gpu driven path, one command per object with the object index as first instance
+	VkPhysicalDeviceFeatures supported_features;
+	vkGetPhysicalDeviceFeatures(_physical_device, &supported_features);
+	vkb_physical_device.features.multiDrawIndirect = supported_features.multiDrawIndirect;
+	vkb_physical_device.features.drawIndirectFirstInstance = supported_features.drawIndirectFirstInstance;
+	_multiDrawIndirect = supported_features.multiDrawIndirect == VK_TRUE;
+	_drawIndirectFirstInstance = supported_features.drawIndirectFirstInstance == VK_TRUE;
+
+	//timeline semaphores let the frames wait on the uploads of another queue, and indirect count draws skip
+	//the culled objects without empty commands, both core since 1.2
+	VkPhysicalDeviceVulkan12Features supported_features12 = {};
+	supported_features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	if (vkb_instance.instance_version >= VK_API_VERSION_1_2 && vkb_physical_device.properties.apiVersion >= VK_API_VERSION_1_2)
+	{
+		VkPhysicalDeviceFeatures2 features = {};
+		features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features.pNext = &supported_features12;
+		vkGetPhysicalDeviceFeatures2(_physical_device, &features);
+	}
+	_timelineSemaphores = supported_features12.timelineSemaphore == VK_TRUE;
+	_drawIndirectCount = supported_features12.drawIndirectCount == VK_TRUE;
+
+	//only what is used gets enabled
+	VkPhysicalDeviceVulkan12Features enabled_features12 = {};
+	enabled_features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	enabled_features12.timelineSemaphore = supported_features12.timelineSemaphore;
+	enabled_features12.drawIndirectCount = supported_features12.drawIndirectCount;
+
 	//logical device
 	vkb::DeviceBuilder logical_device_builder { vkb_physical_device };
+	if (_timelineSemaphores || _drawIndirectCount)
+	{
+		logical_device_builder.add_pNext(&enabled_features12);
+	}
 	auto logical_builder_result = logical_device_builder.build();
 	vkb::Device vbk_logical_device = logical_builder_result.value();
 	vkb::Device vkb_logical_device = logical_builder_result.value();
@@ -107,6 +173,17 @@ void VulkanEngine::init_vulkan()
 	_graphics_queue = vkb_logical_device.get_queue(vkb::QueueType::graphics).value();
 	_graphics_family_index = vkb_logical_device.get_queue_index(vkb::QueueType::graphics).value();
 
+	//uploads go to a transfer only queue when there is one, the copy engine runs them next to the frames.
+	//without timeline semaphores there is nothing cheap to wait on them with, so they stay on the graphics queue
+	_transfer_queue = _graphics_queue;
+	_transfer_family_index = _graphics_family_index;
+	auto transfer_queue_result = vkb_logical_device.get_dedicated_queue(vkb::QueueType::transfer);
+	if (_timelineSemaphores && transfer_queue_result)
+	{
+		_transfer_queue = transfer_queue_result.value();
+		_transfer_family_index = vkb_logical_device.get_dedicated_queue_index(vkb::QueueType::transfer).value();
+	}
+
 	VmaAllocatorCreateInfo allocatorInfo = {};
   allocatorInfo.physicalDevice = _physical_device;
   allocatorInfo.device = _logical_device;
@@ -177,13 +254,6 @@ void VulkanEngine::init_swapchain()
 
 void VulkanEngine::init_commands()
 {
-	//upload context command pool
-	VkCommandPoolCreateInfo uploadCommandPoolInfo = vkinit::command_pool_create_info(_graphics_family_index);
-	VK_CHECK(vkCreateCommandPool(_logical_device, &uploadCommandPoolInfo, nullptr, &_uploadContext.commandPool));
-	_mainDeletionQueue.push([=]() {
-		vkDestroyCommandPool(_logical_device, _uploadContext.commandPool, nullptr);
-	});
-
 	//command pools one for each frame
 	VkCommandPoolCreateInfo _command_pool_info	= vkinit::command_pool_create_info(_graphics_family_index, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
 	for (size_t i = 0; i < FRAME_OVERLAP; i++)
@@ -203,6 +273,34 @@ void VulkanEngine::init_commands()
 			vkDestroyCommandPool(_logical_device, _frames[i]._commandPool, NULL);
 		});
 	}
+
+	_recordJobs = std::make_unique<assets::JobSystem>();
+
+	//reset all at once at the start of the frame, the secondaries are recorded again every time
+	VkCommandPoolCreateInfo record_pool_info = vkinit::command_pool_create_info(_graphics_family_index, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+	uint32_t record_slots = _recordJobs->thread_count() + 1;
+	for (size_t i = 0; i < FRAME_OVERLAP; i++)
+	{
+		_frames[i]._recordPools.resize(record_slots);
+		_frames[i]._recordCommandBuffers.resize(record_slots);
+
+		for (uint32_t slot = 0; slot < record_slots; slot++)
+		{
+			VK_CHECK(
+				vkCreateCommandPool(_logical_device, &record_pool_info, NULL, &_frames[i]._recordPools[slot]);
+			);
+
+			VkCommandBufferAllocateInfo command_buffer_info = vkinit::command_buffer_allocate_info(_frames[i]._recordPools[slot], 1, VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+			VK_CHECK(
+				vkAllocateCommandBuffers(_logical_device, &command_buffer_info, &_frames[i]._recordCommandBuffers[slot]);
+			);
+		}
+
+		_mainDeletionQueue.push([=]() {
+			for (VkCommandPool pool : _frames[i]._recordPools)
+				vkDestroyCommandPool(_logical_device, pool, NULL);
+		});
+	}
 }
 
 void VulkanEngine::init_renderpass()
@@ -281,16 +379,6 @@ void VulkanEngine::init_framebuffers()
 
 void VulkanEngine::init_sync_structures()
 {
-	VkFenceCreateInfo uploadFenceCreateInfo = {
-		.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-	};
-	VK_CHECK(
-		vkCreateFence(_logical_device, &uploadFenceCreateInfo, NULL, &_uploadContext.uploadFence)
-	);
-	_mainDeletionQueue.push([=]() {
-		vkDestroyFence(_logical_device, _uploadContext.uploadFence, NULL);
-	});
-
 	for (size_t i = 0; i < FRAME_OVERLAP; i++)
 	{
 		VkFenceCreateInfo fence_create_info = {
@@ -381,7 +469,15 @@ void VulkanEngine::cleanup()
 {
 	if (_isInitialized)
 	{
-		vkQueueWaitIdle(_graphics_queue);
+		vkDeviceWaitIdle(_logical_device);
+		_recordJobs.reset();
+
+		//finishes the uploads in flight, their resources end up in the cache
+		_streamer.cleanup();
+		_resourceCache.cleanup();
+		_gpuDriven.cleanup();
+		_geometryPool.cleanup();
+		_uploader.cleanup();
 
 		_mainDeletionQueue.flush();
 
@@ -399,6 +495,12 @@ void VulkanEngine::draw()
 	VK_CHECK(
 						vkResetFences(_logical_device, 1, &get_current_frame()._render_fence)
 					);
+	//the gpu is done with what this frame wrote last time around
+	get_current_frame().frameAllocator.reset();
+	for (VkCommandPool pool : get_current_frame()._recordPools)
+	{
+		VK_CHECK(vkResetCommandPool(_logical_device, pool, 0));
+	}
 	uint32_t frame_index = 0;
 	VK_CHECK(
 						vkAcquireNextImageKHR(_logical_device, _swapchain, 1000000000, get_current_frame()._present_semaphore, NULL, &frame_index)
@@ -434,28 +536,90 @@ void VulkanEngine::draw()
 	VkClearValue clearValues[] = { clearValue, depthClear };
 	_render_pass_begin_info.clearValueCount = 2;
 	_render_pass_begin_info.pClearValues = &clearValues[0];
-	vkCmdBeginRenderPass(get_current_frame()._mainCommandBuffer, &_render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+	//textures uploaded on the transfer queue are taken over first. moving meshes around has to wait for every
+	//upload that may still write into them, anything else only waits for what completed
+	uint64_t upload_wait_value = _uploader.record_acquires(get_current_frame()._mainCommandBuffer, _geometryPool.has_relocations());
+
+	//meshes the geometry pool moved since last frame are copied to their new place before anything draws
+	_geometryPool.record_relocations(get_current_frame()._mainCommandBuffer, _frameNumber);
+
+	uint32_t global_offset = write_global_data();
 
-	//do stuff
-	//do stuff
-	//do stuff
-	draw_objects(get_current_frame()._mainCommandBuffer, _renderables.data(), _renderables.size());
-	//do stuff
-	//do stuff
-	//do stuff
+	//the draw commands are written by a compute pass, which can not run inside the render pass
+	bool gpu_driven = _useGpuDriven && _gpuDriven.ready();
+	if (gpu_driven)
+	{
+		_gpuDriven.record_culling(get_current_frame()._mainCommandBuffer);
+	}
+
+	vkCmdBeginRenderPass(get_current_frame()._mainCommandBuffer, &_render_pass_begin_info, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+
+	VkCommandBufferInheritanceInfo inheritance = {};
+	inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritance.renderPass = _render_pass;
+	inheritance.subpass = 0;
+	inheritance.framebuffer = _framebuffers[frame_index];
+
+	VkCommandBufferBeginInfo secondary_begin_info = vkinit::command_buffer_begin_info(
+		VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT, &inheritance);
+
+	std::vector<VkCommandBuffer> secondaries;
+	if (gpu_driven)
+	{
+		//a handful of indirect draws, not worth spreading over the workers
+		VkCommandBuffer indirect_cmd = get_current_frame()._recordCommandBuffers.front();
+		VK_CHECK(vkBeginCommandBuffer(indirect_cmd, &secondary_begin_info));
+		_gpuDriven.record_draws(indirect_cmd, get_current_frame().globalDescriptorSet, global_offset);
+		VK_CHECK(vkEndCommandBuffer(indirect_cmd));
+		secondaries.push_back(indirect_cmd);
+	}
+	else
+	{
+		//only what is on screen is used, so meshes and textures out of view can be evicted
+		glm::vec4 frustum[6];
+		camera.get_frustum_planes(frustum);
+		_culler.update_bounds();
+		_culler.cull(frustum, _visibleObjects, _recordJobs.get());
+
+		draw_objects(inheritance, global_offset, _renderables.data(), _visibleObjects.data(), _visibleObjects.size(), secondaries);
+	}
 
-	ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), get_current_frame()._mainCommandBuffer);
+	//the render pass only takes secondaries now, imgui gets the last one
+	VkCommandBuffer imgui_cmd = get_current_frame()._recordCommandBuffers.back();
+	VK_CHECK(vkBeginCommandBuffer(imgui_cmd, &secondary_begin_info));
+	ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), imgui_cmd);
+	VK_CHECK(vkEndCommandBuffer(imgui_cmd));
+	secondaries.push_back(imgui_cmd);
+
+	vkCmdExecuteCommands(get_current_frame()._mainCommandBuffer, uint32_t(secondaries.size()), secondaries.data());
 
 	//finalize the render pass
 	vkCmdEndRenderPass(get_current_frame()._mainCommandBuffer);
 	VK_CHECK(vkEndCommandBuffer(get_current_frame()._mainCommandBuffer));
 
+	get_current_frame().frameAllocator.flush();
+
 	VkSubmitInfo submit = {};
 	submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-	submit.pWaitDstStageMask = &waitStage;
+	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT };
+	VkSemaphore waitSemaphores[] = { get_current_frame()._present_semaphore, _uploader.timeline() };
+	submit.pWaitDstStageMask = waitStages;
 	submit.waitSemaphoreCount = 1;
-	submit.pWaitSemaphores = &get_current_frame()._present_semaphore;
+	submit.pWaitSemaphores = waitSemaphores;
+
+	//the value of the binary present semaphore is ignored
+	uint64_t waitValues[] = { 0, upload_wait_value };
+	VkTimelineSemaphoreSubmitInfo timeline_info = {};
+	if (upload_wait_value > 0)
+	{
+		timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timeline_info.waitSemaphoreValueCount = 2;
+		timeline_info.pWaitSemaphoreValues = waitValues;
+
+		submit.pNext = &timeline_info;
+		submit.waitSemaphoreCount = 2;
+	}
+
 	submit.signalSemaphoreCount = 1;
 	submit.pSignalSemaphores = &get_current_frame()._render_semaphore;
 	submit.commandBufferCount = 1;
@@ -505,12 +669,50 @@ void VulkanEngine::run()
 			}
 		}
 
+		//frame boundary, finished uploads become visible to this frame's draws
+		_uploader.update();
+		_streamer.update();
+		//whatever else was recorded for upload this frame goes out in one batch too
+		_uploader.submit();
+
+		_resourceCache.update(_frameNumber);
+		_geometryPool.update(_frameNumber);
+		_gpuDriven.update(_frameNumber);
+
 		ImGui_ImplVulkan_NewFrame();
 		ImGui_ImplSDL2_NewFrame(_window);
 
 		ImGui::NewFrame();
 
 		ImGui::Text("Camera %d", 123);
+		ImGui::Text("Streaming %u assets", _streamer.pending_count());
+
+		const ResourceCacheStats& cacheStats = _resourceCache.stats();
+		ImGui::Text("Cache gpu %.1f MB", cacheStats.gpuBytes / (1024.0 * 1024.0));
+		ImGui::Text("Cache hits %llu misses %llu evictions %llu", (unsigned long long)cacheStats.hits,
+			(unsigned long long)cacheStats.misses, (unsigned long long)cacheStats.evictions);
+
+		GeometryPoolStats poolStats = _geometryPool.stats();
+		ImGui::Text("Geometry %.1f / %.1f MB in %u meshes, %u relocations", poolStats.usedBytes / (1024.0 * 1024.0),
+			poolStats.capacityBytes / (1024.0 * 1024.0), poolStats.allocations, poolStats.relocations);
+		if (ImGui::Button("Defragment geometry"))
+		{
+			_geometryPool.defragment();
+		}
+
+		if (_gpuDriven.supported())
+		{
+			ImGui::Checkbox("GPU culling", &_useGpuDriven);
+			ImGui::SliderFloat("LOD threshold (px)", &_gpuDriven.lodThreshold, 0.25f, 16.f);
+
+			const GpuDrivenStats& gpuStats = _gpuDriven.stats();
+			ImGui::Text("%u objects, %u meshes, %u batches in %u indirect draws", gpuStats.objects, gpuStats.meshes,
+				gpuStats.batches, gpuStats.drawCalls);
+		}
+		if (!_useGpuDriven || !_gpuDriven.ready())
+		{
+			ImGui::Text("CPU culling %zu of %zu objects visible", _visibleObjects.size(), _culler.object_count());
+		}
 
 		ImGui::InputFloat("X", &camera.pos.x, 1.0f, 1.0, "%.3f");
 		ImGui::InputFloat("Y", &camera.pos.y, 1.0f, 1.0, "%.3f");
@@ -547,51 +749,7 @@ void VulkanEngine::load_meshes()
 	// upload_mesh(_monkey_mesh);
 	// _meshes["monkey"] = _monkey_mesh;
 
-	Mesh lostEmpire;
-	//lostEmpire.load_from_obj("../assets/lost_empire.obj");
-	lostEmpire.load_mesh("../assets/assets_export/MESH_0_ToyCar.mesh");
-	upload_mesh(lostEmpire);
-	_meshes["empire"] = lostEmpire;
-}
-
-void VulkanEngine::upload_mesh(Mesh& mesh)
-{
-	const size_t bufferSize = mesh.vertices.size() * sizeof(Vertex);
-
-	Buffer stagingBuffer;
-	VkBufferCreateInfo stagingBufferCreateInfo = {};
-	stagingBufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-	stagingBufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-	stagingBufferCreateInfo.size  = bufferSize;
-	VmaAllocationCreateInfo vmaallocInfo = {};
-	vmaallocInfo.usage = VMA_MEMORY_USAGE_CPU_ONLY;
-	vmaCreateBuffer(_allocator, &stagingBufferCreateInfo, &vmaallocInfo, &stagingBuffer.vkbuffer, &stagingBuffer.allocation, nullptr);
-
-	void* data;
-	vmaMapMemory(_allocator, stagingBuffer.allocation, &data);
-	memcpy(data, mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
-	vmaUnmapMemory(_allocator, stagingBuffer.allocation);
-
-	VkBufferCreateInfo bufferCreatInfo = {};
-	bufferCreatInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-	bufferCreatInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
-	bufferCreatInfo.size  = bufferSize;
-	vmaallocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
-	VK_CHECK(vmaCreateBuffer(_allocator, &bufferCreatInfo, &vmaallocInfo, &mesh.verticesBuffer.vkbuffer, &mesh.verticesBuffer.allocation, nullptr));
-
-	immediate_submit([=](VkCommandBuffer cmd) {
-		VkBufferCopy copy;
-		copy.dstOffset = 0;
-		copy.srcOffset = 0;
-		copy.size = bufferSize;
-		vkCmdCopyBuffer(cmd, stagingBuffer.vkbuffer, mesh.verticesBuffer.vkbuffer, 1, &copy);
-	});
-
-	_mainDeletionQueue.push([=]() {
-	vmaDestroyBuffer(_allocator, mesh.verticesBuffer.vkbuffer, mesh.verticesBuffer.allocation);
-	});
-
-	vmaDestroyBuffer(_allocator, stagingBuffer.vkbuffer, stagingBuffer.allocation);
+	_resourceCache.add_mesh("empire", "MESH_0_ToyCar.mesh");
 }
 
 Material* VulkanEngine::create_material(VkPipeline pipeline, VkPipelineLayout layout, const std::string& name)
@@ -616,21 +774,13 @@ Material* VulkanEngine::get_material(const std::string& name)
 		return &(*it).second;
 }
 
-Mesh* VulkanEngine::get_mesh(const std::string& name)
+CachedMesh* VulkanEngine::get_mesh(const std::string& name)
 {
-	auto it = _meshes.find(name);
-
-	if (it == _meshes.end())
-		return nullptr;
-
-	else
-		return &(*it).second;
+	return _resourceCache.find_mesh(name);
 }
 
-void VulkanEngine::draw_objects(VkCommandBuffer cmd, RenderObject *first, int count)
+uint32_t VulkanEngine::write_global_data()
 {
-	int frameIndex = _frameNumber % FRAME_OVERLAP;
-
 	glm::mat4 view = camera.get_view();
 	glm::mat4 projection = camera.get_projection();
 
@@ -642,60 +792,132 @@ void VulkanEngine::draw_objects(VkCommandBuffer cmd, RenderObject *first, int co
 	float framed = (_frameNumber / 120.f);
 	globalData.scene.ambientColor = { sin(framed),0,cos(framed),1 };
 
-	//global data
-	{
-		char* data;
-		vmaMapMemory(_allocator, _globalBuffer.allocation, (void**) &data);
+	FrameData& frame = get_current_frame();
+
+	FrameAllocation globalAllocation = frame.frameAllocator.allocate_uniform(sizeof(GPUGlobalData));
+	memcpy(globalAllocation.data, &globalData, sizeof(GPUGlobalData));
+
+	//the set of this frame points at wherever its data landed, nothing else uses it while it records
+	VkDescriptorBufferInfo globalInfo;
+	globalInfo.buffer = globalAllocation.buffer;
+	globalInfo.offset = 0;
+	globalInfo.range = sizeof(GPUGlobalData);
 
-		data += pad_uniform_buffer_size(sizeof(GPUGlobalData)) * frameIndex;
-		memcpy(data, &globalData, sizeof(GPUGlobalData));
+	VkWriteDescriptorSet globalWrite = vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, frame.globalDescriptorSet, &globalInfo, 0);
+	vkUpdateDescriptorSets(_logical_device, 1, &globalWrite, 0, nullptr);
 
-		vmaUnmapMemory(_allocator, _globalBuffer.allocation);
+	return uint32_t(globalAllocation.offset);
+}
+
+void VulkanEngine::draw_objects(const VkCommandBufferInheritanceInfo& inheritance, uint32_t globalOffset, RenderObject* first, const uint32_t* visible, size_t count, std::vector<VkCommandBuffer>& outCommandBuffers)
+{
+	FrameData& frame = get_current_frame();
+
+	//object data, as many as there are visible objects
+	FrameAllocation objectAllocation = frame.frameAllocator.allocate_storage(sizeof(GPUObjectData) * std::max<size_t>(count, 1));
+	GPUObjectData* objectSSBO = (GPUObjectData*)objectAllocation.data;
+	for (size_t i = 0; i < count; i++)
+	{
+		RenderObject& object = first[visible[i]];
+		objectSSBO[i].modelMatrix = object.transform;
 	}
 
-	//object data
+	VkDescriptorBufferInfo objectInfo;
+	objectInfo.buffer = objectAllocation.buffer;
+	objectInfo.offset = objectAllocation.offset;
+	objectInfo.range = objectAllocation.size;
+
+	VkWriteDescriptorSet objectWrite = vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame.objectDescriptorSet, &objectInfo, 0);
+	vkUpdateDescriptorSets(_logical_device, 1, &objectWrite, 0, nullptr);
+
+	//cache bookkeeping and descriptor writes are not thread safe, they are done here before recording
+	std::vector<uint32_t> drawable;
+	drawable.reserve(count);
+	for (size_t i = 0; i < count; i++)
 	{
-		void* objectData;
-		vmaMapMemory(_allocator, get_current_frame().objectBuffer.allocation, &objectData);
-		GPUObjectData* objectSSBO = (GPUObjectData*)objectData;
-		for (int i = 0; i < count; i++)
+		RenderObject& object = first[visible[i]];
+
+		//both are touched every frame so neither is evicted while the other one streams in
+		bool meshResident = _resourceCache.use(object.mesh);
+		bool textureResident = !object.material->texture || _resourceCache.use(object.material->texture);
+		if (!meshResident || !textureResident)
+			continue;
+
+		if (object.material->texture && object.material->textureVersion != object.material->texture->version)
 		{
-			RenderObject& object = first[i];
-			objectSSBO[i].modelMatrix = object.transform;
+			write_material_texture(object.material);
 		}
-		vmaUnmapMemory(_allocator, get_current_frame().objectBuffer.allocation);
+
+		drawable.push_back(uint32_t(i));
+	}
+
+	//chunks below this are not worth a job of their own
+	const size_t MinDrawsPerChunk = 256;
+	const size_t chunkSlots = frame._recordCommandBuffers.size() - 1;
+	const size_t chunkCount = std::min(chunkSlots, (drawable.size() + MinDrawsPerChunk - 1) / MinDrawsPerChunk);
+
+	//the chunks keep the order of the objects, the primary executes them in that order
+	assets::JobGroup recordGroup;
+	outCommandBuffers.resize(chunkCount);
+	for (size_t chunk = 0; chunk < chunkCount; chunk++)
+	{
+		size_t begin = drawable.size() * chunk / chunkCount;
+		size_t end = drawable.size() * (chunk + 1) / chunkCount;
+
+		VkCommandBuffer cmd = frame._recordCommandBuffers[chunk];
+		outCommandBuffers[chunk] = cmd;
+
+		_recordJobs->run(recordGroup, [&, cmd, begin, end]() {
+			record_draws(cmd, inheritance, first, visible, drawable.data() + begin, end - begin, globalOffset);
+		});
 	}
+	_recordJobs->wait(recordGroup);
+}
+
+void VulkanEngine::record_draws(VkCommandBuffer cmd, const VkCommandBufferInheritanceInfo& inheritance, RenderObject* first, const uint32_t* visible, const uint32_t* slots, size_t count, uint32_t globalOffset)
+{
+	VkCommandBufferBeginInfo beginInfo = vkinit::command_buffer_begin_info(
+		VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT, &inheritance);
+	VK_CHECK(vkBeginCommandBuffer(cmd, &beginInfo));
+
+	FrameData& frame = get_current_frame();
+
+	//every mesh lives in the geometry pool, one vertex buffer bind for all of them. secondaries start without
+	//any state, every chunk binds its own
+	VkBuffer vertexBuffer = _geometryPool.vertex_buffer();
+	VkDeviceSize vertexBufferOffset = 0;
+	vkCmdBindVertexBuffers(cmd, 0, 1, &vertexBuffer, &vertexBufferOffset);
 
 	Mesh* lastMesh = nullptr;
 	Material* lastMaterial = nullptr;
-	for (int i = 0; i < count; i++)
+	VkIndexType lastIndexType = VK_INDEX_TYPE_MAX_ENUM;
+	for (size_t i = 0; i < count; i++)
 	{
-		RenderObject& object = first[i];
+		uint32_t slot = slots[i];
+		RenderObject& object = first[visible[slot]];
+		Mesh* mesh = &object.mesh->mesh;
 
 		if (object.material != lastMaterial)
 		{
-			uint32_t uniform_offset = pad_uniform_buffer_size(sizeof(GPUGlobalData)) * frameIndex;
 			vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, object.material->pipeline);
 			vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, object.material->pipelineLayout,
-				0, 1, &get_current_frame().globalDescriptorSet, 1, &uniform_offset);
+				0, 1, &frame.globalDescriptorSet, 1, &globalOffset);
 			lastMaterial = object.material;
 
 			vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, object.material->pipelineLayout,
-				1, 1, &get_current_frame().objectDescriptorSet, 0, nullptr);
+				1, 1, &frame.objectDescriptorSet, 0, nullptr);
 		}
 
-		glm::mat4 model = object.transform;
-		glm::mat4 mesh_matrix = projection * view * model;
-
-		MeshPushConstants constants;
-		constants.matrix = object.transform;
-		//vkCmdPushConstants(cmd, object.material->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT|VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(MeshPushConstants), &constants);
+		//16 and 32 bit indices are in separate buffers
+		if (mesh->indexType != lastIndexType)
+		{
+			vkCmdBindIndexBuffer(cmd, _geometryPool.index_buffer(mesh->indexType), 0, mesh->indexType);
+			lastIndexType = mesh->indexType;
+		}
 
-		if (object.mesh != lastMesh)
+		if (mesh != lastMesh)
 		{
-			VkDeviceSize offset = 0;
-			vkCmdBindVertexBuffers(cmd, 0, 1, &object.mesh->verticesBuffer.vkbuffer, &offset);
-			lastMesh = object.mesh;
+			lastMesh = mesh;
 
 			if (object.material->textureSet != VK_NULL_HANDLE)
 			{
@@ -703,32 +925,25 @@ void VulkanEngine::draw_objects(VkCommandBuffer cmd, RenderObject *first, int co
 			}
 		}
 
-		vkCmdDraw(cmd, object.mesh->vertices.size(), 1, 0, i);
+		//the instance index picks the object data
+		const GeometryAllocation* geometry = mesh->geometry;
+		vkCmdDrawIndexed(cmd, mesh->indexCount, 1, geometry->indexOffset + mesh->firstIndex, int32_t(geometry->vertexOffset), slot);
 	}
+
+	VK_CHECK(vkEndCommandBuffer(cmd));
 }
 
 void VulkanEngine::init_scene()
 {
 	VkSamplerCreateInfo samplerInfo = vkinit::sampler_create_info(VK_FILTER_NEAREST);
-	VkSampler blockySampler;
-	vkCreateSampler(_logical_device, &samplerInfo, nullptr, &blockySampler);
+	vkCreateSampler(_logical_device, &samplerInfo, nullptr, &_blockySampler);
+	_mainDeletionQueue.push([=]() {
+		vkDestroySampler(_logical_device, _blockySampler, nullptr);
+	});
 
+	//the texture set is written by the first draw after the texture is streamed in
 	Material* texturedMat=	get_material("texturedmesh");
-
-	VkDescriptorSetAllocateInfo allocInfo = {};
-	allocInfo.pNext = nullptr;
-	allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-	allocInfo.descriptorPool = _descriptorPool;
-	allocInfo.descriptorSetCount = 1;
-	allocInfo.pSetLayouts = &_singleTextureSetLayout;
-	vkAllocateDescriptorSets(_logical_device, &allocInfo, &texturedMat->textureSet);
-
-	VkDescriptorImageInfo imageBufferInfo;
-	imageBufferInfo.sampler = blockySampler;
-	imageBufferInfo.imageView = _loadedTextures["empire_diffuse"].imageView;
-	imageBufferInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-	VkWriteDescriptorSet texture1 = vkinit::write_descriptor_image(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, texturedMat->textureSet, &imageBufferInfo, 0);
-	vkUpdateDescriptorSets(_logical_device, 1, &texture1, 0, nullptr);
+	texturedMat->texture = _resourceCache.find_texture("empire_diffuse");
 
 	RenderObject map;
 	map.mesh = get_mesh("empire");
@@ -761,6 +976,57 @@ Buffer VulkanEngine::create_buffer(size_t allocSize, VkBufferUsageFlags usage, V
 	return buffer;
 }
 
+Buffer VulkanEngine::create_device_buffer(size_t allocSize, VkBufferUsageFlags usage)
+{
+	VkBufferCreateInfo create_info = {};
+	create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	create_info.size = allocSize;
+	create_info.usage = usage;
+
+	//written by the upload queue while the frames read from it, handing the whole buffer back and forth
+	//for every upload would serialize the two queues, so both families share it
+	uint32_t families[] = { _graphics_family_index, _transfer_family_index };
+	if (families[0] != families[1])
+	{
+		create_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+		create_info.queueFamilyIndexCount = 2;
+		create_info.pQueueFamilyIndices = families;
+	}
+
+	VmaAllocationCreateInfo vma_create_info = {};
+	vma_create_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+	Buffer buffer;
+
+	VK_CHECK(
+		vmaCreateBuffer(_allocator, &create_info, &vma_create_info, &buffer.vkbuffer, &buffer.allocation, nullptr);
+	);
+
+	return buffer;
+}
+
+Buffer VulkanEngine::create_staging_buffer(size_t allocSize, void** outMapped)
+{
+	VkBufferCreateInfo create_info = {};
+	create_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	create_info.size = allocSize;
+	create_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+	VmaAllocationCreateInfo vma_create_info = {};
+	vma_create_info.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+	vma_create_info.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+	Buffer buffer;
+	VmaAllocationInfo allocationInfo;
+
+	VK_CHECK(
+		vmaCreateBuffer(_allocator, &create_info, &vma_create_info, &buffer.vkbuffer, &buffer.allocation, &allocationInfo);
+	);
+
+	*outMapped = allocationInfo.pMappedData;
+	return buffer;
+}
+
 void VulkanEngine::init_descriptors()
 {
 	descriptoAllocator.init(_logical_device);
@@ -832,12 +1098,12 @@ void VulkanEngine::init_descriptors()
 		vkCreateDescriptorPool(_logical_device, &pool_info, nullptr, &_descriptorPool);
 	}
 
-	const size_t GlobalBufferSize = FRAME_OVERLAP * pad_uniform_buffer_size(sizeof(GPUGlobalData));
-	_globalBuffer = create_buffer(GlobalBufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
-
 	for (int i = 0; i < FRAME_OVERLAP; i++)
 	{
-		//allocating and writing descriptors for set 1
+		//per frame data comes out of the frame allocator, the sets are written when the frame records
+		_frames[i].frameAllocator.init(this);
+
+		//allocating descriptors for set 1
 		{
 			VkDescriptorSetAllocateInfo allocInfo = {};
 			allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
@@ -845,19 +1111,9 @@ void VulkanEngine::init_descriptors()
 			allocInfo.descriptorSetCount = 1;
 			allocInfo.pSetLayouts = &_globalSetLayout;
 			vkAllocateDescriptorSets(_logical_device, &allocInfo, &_frames[i].globalDescriptorSet);
-
-			VkDescriptorBufferInfo globalInfo;
-			globalInfo.buffer = _globalBuffer.vkbuffer;
-			globalInfo.offset = 0;
-			globalInfo.range = sizeof(GPUGlobalData);
-
-			VkWriteDescriptorSet globalWrite = vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
-				_frames[i].globalDescriptorSet, &globalInfo, 0);
-
-			vkUpdateDescriptorSets(_logical_device, 1, &globalWrite, 0, nullptr);
 		}
 
-		//allocating and writing descriptors for set 2
+		//allocating descriptors for set 2
 		{
 			VkDescriptorSetAllocateInfo allocInfo = {};
 			allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
@@ -865,75 +1121,82 @@ void VulkanEngine::init_descriptors()
 			allocInfo.descriptorSetCount = 1;
 			allocInfo.pSetLayouts = &_objectSetLayout;
 			vkAllocateDescriptorSets(_logical_device, &allocInfo, &_frames[i].objectDescriptorSet);
-
-			const int MAX_OBJECTS = 10000;
-			_frames[i].objectBuffer = create_buffer(sizeof(GPUObjectData) * MAX_OBJECTS, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
-
-			VkDescriptorBufferInfo objectBufferInfo;
-			objectBufferInfo.buffer = _frames[i].objectBuffer.vkbuffer;
-			objectBufferInfo.offset = 0;
-			objectBufferInfo.range = MAX_OBJECTS * sizeof(GPUObjectData);
-
-			VkWriteDescriptorSet write = vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
-				_frames[i].objectDescriptorSet, &objectBufferInfo, 0);
-
-			vkUpdateDescriptorSets(_logical_device, 1, &write, 0, nullptr);
 		}
 	}
-}
 
-size_t VulkanEngine::pad_uniform_buffer_size(size_t originalSize)
-{
-	size_t minUboAlignment = _gpuProperties.limits.minUniformBufferOffsetAlignment;
-	size_t alignedSize = originalSize;
-	if (minUboAlignment > 0) {
-		alignedSize = (alignedSize + minUboAlignment - 1) & ~(minUboAlignment - 1);
-	}
-	return alignedSize;
+	_mainDeletionQueue.push([=]() {
+		for (int i = 0; i < FRAME_OVERLAP; i++)
+		{
+			_frames[i].frameAllocator.cleanup();
+		}
+	});
 }
 
 void VulkanEngine::immediate_submit(std::function<void(VkCommandBuffer cmd)>&& function)
 {
-  VkCommandBuffer cmd;
-	VkCommandBufferAllocateInfo cmdAllocInfo = vkinit::command_buffer_allocate_info(_uploadContext.commandPool, 1);
+	//runs on the graphics queue, the upload batches may be on a transfer queue that can not do what these
+	//callers record, like the image barriers of the imgui fonts. rare enough to get a pool and fence of its own
+	VkCommandPool pool;
+	VkCommandPoolCreateInfo poolInfo = vkinit::command_pool_create_info(_graphics_family_index);
+	VK_CHECK(vkCreateCommandPool(_logical_device, &poolInfo, nullptr, &pool));
+
+	VkCommandBuffer cmd;
+	VkCommandBufferAllocateInfo cmdAllocInfo = vkinit::command_buffer_allocate_info(pool, 1);
 	VK_CHECK(vkAllocateCommandBuffers(_logical_device, &cmdAllocInfo, &cmd));
 
 	VkCommandBufferBeginInfo cmdBeginInfo = {};
 	cmdBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 	cmdBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-	cmdBeginInfo.pInheritanceInfo = NULL;
 	VK_CHECK(vkBeginCommandBuffer(cmd, &cmdBeginInfo));
 
 	function(cmd);
 
 	VK_CHECK(vkEndCommandBuffer(cmd));
 
+	VkFence fence;
+	VkFenceCreateInfo fenceInfo = {};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	VK_CHECK(vkCreateFence(_logical_device, &fenceInfo, nullptr, &fence));
+
 	VkSubmitInfo submit = {};
 	submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submit.commandBufferCount =1;
+	submit.commandBufferCount = 1;
 	submit.pCommandBuffers = &cmd;
+	VK_CHECK(vkQueueSubmit(_graphics_queue, 1, &submit, fence));
 
-	//submit command buffer to the queue and execute it.
-	// _uploadFence will now block until the graphic commands finish execution
-	VK_CHECK(vkQueueSubmit(_graphics_queue, 1, &submit, _uploadContext.uploadFence));
+	VK_CHECK(vkWaitForFences(_logical_device, 1, &fence, true, UINT64_MAX));
 
-	vkWaitForFences(_logical_device, 1, &_uploadContext.uploadFence, true, 9999999999);
-	vkResetFences(_logical_device, 1, &_uploadContext.uploadFence);
-
-    //clear the command pool. This will free the command buffer too
-	vkResetCommandPool(_logical_device, _uploadContext.commandPool, 0);
+	vkDestroyFence(_logical_device, fence, nullptr);
+	vkDestroyCommandPool(_logical_device, pool, nullptr);
 }
 
 void VulkanEngine::load_images()
 {
-	Texture lostEmpire;
+	_resourceCache.add_texture("empire_diffuse", "lost_empire-RGBA.tx");
+}
 
-	vkutil::load_image_from_file(*this, "../assets/lost_empire-RGBA.png", lostEmpire.image);
+void VulkanEngine::write_material_texture(Material* material)
+{
+	//written in place, the set was last bound before the texture got evicted, at least FRAME_OVERLAP frames ago
+	if (material->textureSet == VK_NULL_HANDLE)
+	{
+		VkDescriptorSetAllocateInfo allocInfo = {};
+		allocInfo.pNext = nullptr;
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = _descriptorPool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &_singleTextureSetLayout;
+		vkAllocateDescriptorSets(_logical_device, &allocInfo, &material->textureSet);
+	}
 
-	VkImageViewCreateInfo imageinfo = vkinit::imageview_create_info(VK_FORMAT_R8G8B8A8_SRGB, lostEmpire.image.vkimage, VK_IMAGE_ASPECT_COLOR_BIT);
-	vkCreateImageView(_logical_device, &imageinfo, nullptr, &lostEmpire.imageView);
+	VkDescriptorImageInfo imageBufferInfo;
+	imageBufferInfo.sampler = _blockySampler;
+	imageBufferInfo.imageView = material->texture->texture.imageView;
+	imageBufferInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	VkWriteDescriptorSet texture1 = vkinit::write_descriptor_image(VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, material->textureSet, &imageBufferInfo, 0);
+	vkUpdateDescriptorSets(_logical_device, 1, &texture1, 0, nullptr);
 
-	_loadedTextures["empire_diffuse"] = lostEmpire;
+	material->textureVersion = material->texture->version;
 }
 
 void VulkanEngine::init_imgui()
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <deque>
+#include <memory>
 #include <vector>
 #include <vk_mesh.h>
 #include <vk_types.h>
@@ -11,6 +12,15 @@
 
 #include <camera.h>
 #include <vk_descriptors.h>
+#include <asset_archive.h>
+#include <vk_geometry_pool.h>
+#include <vk_frame_allocator.h>
+#include <vk_upload.h>
+#include <vk_streaming.h>
+#include <job_system.h>
+#include <vk_resource_cache.h>
+#include <vk_gpu_driven.h>
+#include <vk_culling.h>
 
 struct MeshPushConstants {
 	glm::vec4 data;
@@ -19,17 +29,16 @@ struct MeshPushConstants {
 
 struct Material {
 	VkDescriptorSet textureSet{VK_NULL_HANDLE};
+	//objects using the material are not drawn while the texture is not resident
+	CachedTexture* texture{ nullptr };
+	//version of the texture written in textureSet
+	uint32_t textureVersion{ 0 };
 	VkPipeline pipeline;
 	VkPipelineLayout pipelineLayout;
 };
 
-struct Texture {
-	Image image;
-	VkImageView imageView;
-};
-
 struct RenderObject {
-	Mesh* mesh;
+	CachedMesh* mesh;
 	Material* material;
 	glm::mat4 transform;
 };
@@ -41,10 +50,16 @@ struct FrameData {
 	VkCommandPool _commandPool;
 	VkCommandBuffer _mainCommandBuffer;
 
+	//one pool and secondary per recording job, the last one is for imgui. a slot is only ever recorded by
+	//one job at a time, so the pools need no locking
+	std::vector<VkCommandPool> _recordPools;
+	std::vector<VkCommandBuffer> _recordCommandBuffers;
+
 	VkDescriptorSet globalDescriptorSet;
 	VkDescriptorSet objectDescriptorSet;
 
-	Buffer objectBuffer;
+	//uniforms and object data written by the frame, reset when its fence signals
+	FrameAllocator frameAllocator;
 };
 
 struct GPUObjectData {
@@ -70,11 +85,6 @@ struct GPUGlobalData {
 	GPUSceneData  scene;
 };
 
-struct UploadContext{
-	VkFence uploadFence;
-	VkCommandPool commandPool;
-};
-
 struct DeletionQueue {
 	std::deque< std::function<void()> > deletors;
 
@@ -109,6 +119,11 @@ public:
 	VkDevice _logical_device;
 	VkSurfaceKHR _surface;
 	VkPhysicalDeviceProperties _gpuProperties;
+	bool _textureCompressionBC{ false };
+	bool _timelineSemaphores{ false };
+	bool _multiDrawIndirect{ false };
+	bool _drawIndirectFirstInstance{ false };
+	bool _drawIndirectCount{ false };
 
 	FrameData _frames[FRAME_OVERLAP];
 	FrameData& get_current_frame();
@@ -125,7 +140,12 @@ public:
 	VkQueue _graphics_queue;
 	uint32_t _graphics_family_index;
 
-	UploadContext _uploadContext;
+	//the graphics queue itself when the gpu has no transfer only queue
+	VkQueue _transfer_queue;
+	uint32_t _transfer_family_index;
+
+	//every copy to the gpu goes through it, batched and without waiting
+	UploadBatcher _uploader;
 
 	VkRenderPass _render_pass;
 	std::vector<VkFramebuffer> _framebuffers;
@@ -143,11 +163,31 @@ public:
 	std::vector<RenderObject> _renderables;
 
 	std::unordered_map <std::string,Material> _materials;
-	std::unordered_map <std::string,Mesh> _meshes;
 
-	Buffer _globalBuffer;
 	Camera camera;
 
+	//packed assets, when the archive is missing assets are read from the loose files
+	assets::AssetArchive _assetArchive;
+
+	//vertices and indices of every mesh, suballocated from a few big buffers
+	GeometryPool _geometryPool;
+
+	//records the draws of a frame into secondary command buffers, the render thread takes part in it
+	std::unique_ptr<assets::JobSystem> _recordJobs;
+
+	AssetStreamer _streamer;
+	//every streamed mesh and texture, the meshes and textures not drawn lately go when over budget
+	ResourceCache _resourceCache;
+
+	//culls and draws the scene on the gpu, the cpu path below is used when the device can not
+	GpuDrivenRenderer _gpuDriven;
+	bool _useGpuDriven{ true };
+
+	//frustum culls the objects the cpu path draws, the visible ones of the frame being recorded
+	FrustumCuller _culler;
+	std::vector<uint32_t> _visibleObjects;
+	VkSampler _blockySampler;
+
 	void init();
 
 	void cleanup();
@@ -157,9 +197,18 @@ public:
 	void run();
 
 	Buffer create_buffer(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage);
+
+	//device local buffer filled by the upload batches, shared with the transfer queue when there is one
+	Buffer create_device_buffer(size_t allocSize, VkBufferUsageFlags usage);
+
+	//host visible transfer source that stays mapped for its whole life, safe to call from any thread
+	Buffer create_staging_buffer(size_t allocSize, void** outMapped);
+
+	//records and submits on the graphics queue and waits for it, only for startup work that needs the result right away
 	void immediate_submit(std::function<void(VkCommandBuffer cmd)>&& function);
 
-	std::unordered_map<std::string, Texture> _loadedTextures;
+	//points the texture set of the material at its current texture, the texture has to be resident
+	void write_material_texture(Material* material);
 
 private:
 
@@ -174,7 +223,6 @@ private:
 	void init_pipeline();
 
 	void load_meshes();
-	void upload_mesh(Mesh& mesh);
 
 	void init_scene();
 	void init_imgui();
@@ -182,11 +230,15 @@ private:
 	Material* create_material(VkPipeline pipeline, VkPipelineLayout layout,const std::string& name);
 	Material* get_material(const std::string& name);
 
-	Mesh* get_mesh(const std::string& name);
+	CachedMesh* get_mesh(const std::string& name);
 
-	void draw_objects(VkCommandBuffer cmd,RenderObject* first, int count);
+	//camera and scene uniforms of the frame, returns the dynamic offset of the global set
+	uint32_t write_global_data();
 
-	size_t pad_uniform_buffer_size(size_t originalSize);
+	//writes the object data of the visible objects and records their draws in parallel, one secondary per chunk.
+	//the object data and instance index of a draw are its position in visible
+	void draw_objects(const VkCommandBufferInheritanceInfo& inheritance, uint32_t globalOffset, RenderObject* first, const uint32_t* visible, size_t count, std::vector<VkCommandBuffer>& outCommandBuffers);
+	void record_draws(VkCommandBuffer cmd, const VkCommandBufferInheritanceInfo& inheritance, RenderObject* first, const uint32_t* visible, const uint32_t* slots, size_t count, uint32_t globalOffset);
 
 	void load_images();
 };
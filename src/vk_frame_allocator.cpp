@@ -0,0 +1,121 @@
+#include <vk_frame_allocator.h>
+
+#include <vk_engine.h>
+
+#include <algorithm>
+
+void FrameAllocator::init(VulkanEngine* engine, VkDeviceSize initialSize)
+{
+	_engine = engine;
+	_blocks.push_back(create_block(initialSize));
+	_head = 0;
+}
+
+void FrameAllocator::cleanup()
+{
+	if (!_engine)
+		return;
+
+	for (Block& block : _blocks)
+		destroy_block(block);
+	_blocks.clear();
+
+	_engine = nullptr;
+}
+
+void FrameAllocator::reset()
+{
+	//the frame outgrew the buffer, one buffer that holds all of it is cheaper than chaining again
+	if (_blocks.size() > 1)
+	{
+		VkDeviceSize total = 0;
+		for (Block& block : _blocks)
+		{
+			total += block.size;
+			destroy_block(block);
+		}
+		_blocks.clear();
+		_blocks.push_back(create_block(total));
+	}
+
+	_head = 0;
+}
+
+FrameAllocation FrameAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment)
+{
+	VkDeviceSize offset = (_head + alignment - 1) & ~(alignment - 1);
+	if (offset + size > _blocks.back().size)
+	{
+		//the buffers already handed out this frame stay alive until the next reset
+		_blocks.push_back(create_block(std::max(_blocks.back().size * 2, size)));
+		offset = 0;
+	}
+	_head = offset + size;
+
+	Block& block = _blocks.back();
+
+	FrameAllocation allocation;
+	allocation.buffer = block.buffer.vkbuffer;
+	allocation.offset = offset;
+	allocation.size = size;
+	allocation.data = block.data + offset;
+	return allocation;
+}
+
+FrameAllocation FrameAllocator::allocate_uniform(VkDeviceSize size)
+{
+	return allocate(size, std::max<VkDeviceSize>(_engine->_gpuProperties.limits.minUniformBufferOffsetAlignment, 16));
+}
+
+FrameAllocation FrameAllocator::allocate_storage(VkDeviceSize size)
+{
+	return allocate(size, std::max<VkDeviceSize>(_engine->_gpuProperties.limits.minStorageBufferOffsetAlignment, 16));
+}
+
+void FrameAllocator::flush()
+{
+	//no-op on host coherent memory, which is what most drivers give for cpu to gpu
+	for (size_t i = 0; i < _blocks.size(); i++)
+	{
+		VkDeviceSize size = i + 1 == _blocks.size() ? _head : VK_WHOLE_SIZE;
+		if (size > 0)
+		{
+			vmaFlushAllocation(_engine->_allocator, _blocks[i].buffer.allocation, 0, size);
+		}
+	}
+}
+
+VkDeviceSize FrameAllocator::capacity() const
+{
+	VkDeviceSize total = 0;
+	for (const Block& block : _blocks)
+		total += block.size;
+	return total;
+}
+
+FrameAllocator::Block FrameAllocator::create_block(VkDeviceSize size)
+{
+	VkBufferCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	createInfo.size = size;
+	createInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+
+	VmaAllocationCreateInfo allocInfo = {};
+	allocInfo.usage = VMA_MEMORY_USAGE_CPU_TO_GPU;
+	allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+	Block block;
+	block.size = size;
+
+	VmaAllocationInfo allocationInfo;
+	VK_CHECK(vmaCreateBuffer(_engine->_allocator, &createInfo, &allocInfo, &block.buffer.vkbuffer, &block.buffer.allocation, &allocationInfo));
+
+	block.data = (char*)allocationInfo.pMappedData;
+	return block;
+}
+
+void FrameAllocator::destroy_block(Block& block)
+{
+	vmaDestroyBuffer(_engine->_allocator, block.buffer.vkbuffer, block.buffer.allocation);
+	block = Block{};
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vk_types.h>
+
+#include <cstdint>
+#include <vector>
+
+class VulkanEngine;
+
+//piece of a frame buffer, written through data and read by the gpu at buffer + offset
+struct FrameAllocation {
+	VkBuffer buffer{ VK_NULL_HANDLE };
+	VkDeviceSize offset{ 0 };
+	VkDeviceSize size{ 0 };
+	void* data{ nullptr };
+};
+
+//linear allocator over persistently mapped cpu to gpu memory for everything written once per frame: uniforms,
+//object data and the like. one per frame in flight, reset once the fence of its frame has signaled.
+//a frame that needs more than the buffer holds gets another buffer twice as big, and the next reset replaces
+//them with a single one big enough for both, so after a few frames nothing grows anymore
+class FrameAllocator {
+public:
+	void init(VulkanEngine* engine, VkDeviceSize initialSize = 1024 * 1024);
+	void cleanup();
+
+	//the gpu has to be done with everything handed out since the last reset
+	void reset();
+
+	//render thread only. alignment has to be a power of two
+	FrameAllocation allocate(VkDeviceSize size, VkDeviceSize alignment);
+
+	//aligned for dynamic and regular uniform and storage buffer descriptors
+	FrameAllocation allocate_uniform(VkDeviceSize size);
+	FrameAllocation allocate_storage(VkDeviceSize size);
+
+	//makes the writes visible to the gpu when the memory is not host coherent, before the frame is submitted
+	void flush();
+
+	VkDeviceSize capacity() const;
+
+private:
+	struct Block {
+		Buffer buffer;
+		VkDeviceSize size{ 0 };
+		char* data{ nullptr };
+	};
+
+	Block create_block(VkDeviceSize size);
+	void destroy_block(Block& block);
+
+	VulkanEngine* _engine{ nullptr };
+
+	//the last one is the one being filled, there is more than one only in frames that outgrew the first
+	std::vector<Block> _blocks;
+	VkDeviceSize _head{ 0 };
+};
@@ -0,0 +1,320 @@
+#include <vk_geometry_pool.h>
+
+#include <vk_engine.h>
+
+#include <algorithm>
+#include <iostream>
+
+void RangeAllocator::reset(uint32_t capacity, uint32_t usedCount)
+{
+	_free.clear();
+	_capacity = capacity;
+	_used = usedCount;
+
+	if (usedCount < capacity)
+		_free[usedCount] = capacity - usedCount;
+}
+
+bool RangeAllocator::allocate(uint32_t count, uint32_t& outOffset)
+{
+	//smallest range that fits, keeps the big ones for big meshes
+	auto best = _free.end();
+	for (auto it = _free.begin(); it != _free.end(); ++it)
+	{
+		if (it->second >= count && (best == _free.end() || it->second < best->second))
+		{
+			best = it;
+			if (it->second == count)
+				break;
+		}
+	}
+
+	if (best == _free.end())
+		return false;
+
+	outOffset = best->first;
+	uint32_t remaining = best->second - count;
+	_free.erase(best);
+	if (remaining > 0)
+		_free[outOffset + count] = remaining;
+
+	_used += count;
+	return true;
+}
+
+void RangeAllocator::free(uint32_t offset, uint32_t count)
+{
+	_used -= count;
+
+	auto it = _free.emplace(offset, count).first;
+
+	//merge with the range right after
+	auto next = std::next(it);
+	if (next != _free.end() && it->first + it->second == next->first)
+	{
+		it->second += next->second;
+		_free.erase(next);
+	}
+
+	//and with the one right before
+	if (it != _free.begin())
+	{
+		auto previous = std::prev(it);
+		if (previous->first + previous->second == it->first)
+		{
+			previous->second += it->second;
+			_free.erase(it);
+		}
+	}
+}
+
+uint32_t RangeAllocator::largest_free() const
+{
+	uint32_t largest = 0;
+	for (auto& [offset, count] : _free)
+		largest = std::max(largest, count);
+	return largest;
+}
+
+void GeometryPool::init(VulkanEngine* engine, const GeometryPoolSettings& settings)
+{
+	_engine = engine;
+
+	const VkBufferUsageFlags copyUsage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	init_pool(_vertices, sizeof(Vertex), settings.vertexCapacity, copyUsage | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
+	init_pool(_indices16, sizeof(uint16_t), settings.index16Capacity, copyUsage | VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+	init_pool(_indices32, sizeof(uint32_t), settings.index32Capacity, copyUsage | VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
+}
+
+void GeometryPool::init_pool(Pool& pool, uint32_t elementSize, uint32_t capacity, VkBufferUsageFlags usage)
+{
+	pool.elementSize = elementSize;
+	pool.usage = usage;
+	pool.ranges.reset(capacity);
+	pool.buffer = _engine->create_device_buffer(size_t(capacity) * elementSize, usage);
+}
+
+void GeometryPool::cleanup()
+{
+	if (!_engine)
+		return;
+
+	VmaAllocator allocator = _engine->_allocator;
+
+	//moves that never got recorded still own the buffers they come from
+	for (Relocation& relocation : _relocations)
+		vmaDestroyBuffer(allocator, relocation.source.vkbuffer, relocation.source.allocation);
+	_relocations.clear();
+
+	for (RetiredBuffer& retired : _retired)
+		vmaDestroyBuffer(allocator, retired.buffer.vkbuffer, retired.buffer.allocation);
+	_retired.clear();
+
+	for (Pool* pool : { &_vertices, &_indices16, &_indices32 })
+	{
+		vmaDestroyBuffer(allocator, pool->buffer.vkbuffer, pool->buffer.allocation);
+		pool->buffer = Buffer{};
+	}
+
+	_deferredFrees.clear();
+	_allocations.clear();
+	_engine = nullptr;
+}
+
+VkBuffer GeometryPool::index_buffer(VkIndexType indexType) const
+{
+	return indexType == VK_INDEX_TYPE_UINT16 ? _indices16.buffer.vkbuffer : _indices32.buffer.vkbuffer;
+}
+
+GeometryAllocation* GeometryPool::allocate(uint32_t vertexCount, uint32_t indexCount, VkIndexType indexType)
+{
+	auto allocation = std::make_unique<GeometryAllocation>();
+	allocation->vertexCount = vertexCount;
+	allocation->indexCount = indexCount;
+	allocation->indexType = indexType;
+
+	if (!allocate_range(_vertices, vertexCount, allocation->vertexOffset))
+		return nullptr;
+
+	if (!allocate_range(index_pool(indexType), indexCount, allocation->indexOffset))
+	{
+		_vertices.ranges.free(allocation->vertexOffset, vertexCount);
+		return nullptr;
+	}
+
+	GeometryAllocation* handle = allocation.get();
+	_allocations[handle] = std::move(allocation);
+	return handle;
+}
+
+bool GeometryPool::allocate_range(Pool& pool, uint32_t count, uint32_t& outOffset)
+{
+	if (pool.ranges.allocate(count, outOffset))
+		return true;
+
+	//there is room, only not in one piece
+	RangeAllocator& ranges = pool.ranges;
+	if (ranges.capacity() - ranges.used() >= count)
+	{
+		relocate(pool, ranges.capacity());
+		return ranges.allocate(count, outOffset);
+	}
+
+	uint64_t capacity = std::max(uint64_t(ranges.capacity()) * 2, uint64_t(ranges.used()) + count);
+	if (capacity > UINT32_MAX)
+	{
+		std::cout << "Geometry pool can not hold " << count << " more elements" << std::endl;
+		return false;
+	}
+
+	relocate(pool, uint32_t(capacity));
+	return ranges.allocate(count, outOffset);
+}
+
+void GeometryPool::free(GeometryAllocation* allocation)
+{
+	//a move that has not run yet would still copy the old data over the range, and uploads on the transfer
+	//queue are not ordered against it, so it stays taken until every frame that moves data has retired
+	if (!_relocations.empty() || !_retired.empty())
+	{
+		_deferredFrees.push_back(allocation);
+		return;
+	}
+
+	release(allocation);
+}
+
+void GeometryPool::release(GeometryAllocation* allocation)
+{
+	auto it = _allocations.find(allocation);
+	if (it == _allocations.end())
+		return;
+
+	_vertices.ranges.free(allocation->vertexOffset, allocation->vertexCount);
+	index_pool(allocation->indexType).ranges.free(allocation->indexOffset, allocation->indexCount);
+	_allocations.erase(it);
+}
+
+void GeometryPool::relocate(Pool& pool, uint32_t capacity)
+{
+	//live ranges of this pool in buffer order, packed at the start of the new buffer
+	std::vector<std::pair<uint32_t*, uint32_t>> live;
+	for (auto& [handle, allocation] : _allocations)
+	{
+		if (&pool == &_vertices)
+			live.push_back({ &allocation->vertexOffset, allocation->vertexCount });
+		else if (&pool == &index_pool(allocation->indexType))
+			live.push_back({ &allocation->indexOffset, allocation->indexCount });
+	}
+	std::sort(live.begin(), live.end(), [](const auto& a, const auto& b) { return *a.first < *b.first; });
+
+	Relocation relocation;
+	relocation.source = pool.buffer;
+	relocation.destination = _engine->create_device_buffer(size_t(capacity) * pool.elementSize, pool.usage);
+
+	uint32_t packed = 0;
+	for (auto& [offset, count] : live)
+	{
+		//ranges that were next to each other stay one copy
+		if (!relocation.copies.empty())
+		{
+			VkBufferCopy& last = relocation.copies.back();
+			if (last.srcOffset + last.size == VkDeviceSize(*offset) * pool.elementSize)
+			{
+				last.size += VkDeviceSize(count) * pool.elementSize;
+				*offset = packed;
+				packed += count;
+				continue;
+			}
+		}
+
+		VkBufferCopy copy;
+		copy.srcOffset = VkDeviceSize(*offset) * pool.elementSize;
+		copy.dstOffset = VkDeviceSize(packed) * pool.elementSize;
+		copy.size = VkDeviceSize(count) * pool.elementSize;
+		relocation.copies.push_back(copy);
+
+		*offset = packed;
+		packed += count;
+	}
+
+	pool.buffer = relocation.destination;
+	pool.ranges.reset(capacity, packed);
+
+	_relocations.push_back(std::move(relocation));
+	_relocationCount++;
+}
+
+void GeometryPool::defragment()
+{
+	for (Pool* pool : { &_vertices, &_indices16, &_indices32 })
+	{
+		const RangeAllocator& ranges = pool->ranges;
+		if (ranges.largest_free() < ranges.capacity() - ranges.used())
+			relocate(*pool, ranges.capacity());
+	}
+}
+
+void GeometryPool::record_relocations(VkCommandBuffer cmd, uint64_t frameNumber)
+{
+	if (_relocations.empty())
+		return;
+
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+
+	for (Relocation& relocation : _relocations)
+	{
+		//uploads submitted before, and the previous move of the same pool, have to land first
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+		if (!relocation.copies.empty())
+		{
+			vkCmdCopyBuffer(cmd, relocation.source.vkbuffer, relocation.destination.vkbuffer, uint32_t(relocation.copies.size()), relocation.copies.data());
+		}
+
+		//frames still in flight may be drawing from it
+		_retired.push_back({ frameNumber, relocation.source });
+	}
+	_relocations.clear();
+
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+}
+
+void GeometryPool::update(uint64_t frameNumber)
+{
+	//called before the fence of this frame is waited on, so only the frames FRAME_OVERLAP + 1 back are known
+	//to be done. the frame that retired a source buffer still copies from it
+	auto done = std::remove_if(_retired.begin(), _retired.end(), [&](const RetiredBuffer& retired) {
+		if (retired.frame + FRAME_OVERLAP >= frameNumber)
+			return false;
+
+		vmaDestroyBuffer(_engine->_allocator, retired.buffer.vkbuffer, retired.buffer.allocation);
+		return true;
+	});
+	_retired.erase(done, _retired.end());
+
+	if (_relocations.empty() && _retired.empty())
+	{
+		for (GeometryAllocation* allocation : _deferredFrees)
+			release(allocation);
+		_deferredFrees.clear();
+	}
+}
+
+GeometryPoolStats GeometryPool::stats() const
+{
+	GeometryPoolStats stats;
+	for (const Pool* pool : { &_vertices, &_indices16, &_indices32 })
+	{
+		stats.usedBytes += size_t(pool->ranges.used()) * pool->elementSize;
+		stats.capacityBytes += size_t(pool->ranges.capacity()) * pool->elementSize;
+	}
+	stats.allocations = uint32_t(_allocations.size());
+	stats.relocations = _relocationCount;
+	return stats;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include <vk_types.h>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+class VulkanEngine;
+
+//ranges of elements in a fixed size buffer. best fit over the free ranges, which merge back with their
+//neighbours when freed
+class RangeAllocator {
+public:
+	//the first usedCount elements are taken, everything after them is free
+	void reset(uint32_t capacity, uint32_t usedCount = 0);
+
+	bool allocate(uint32_t count, uint32_t& outOffset);
+	void free(uint32_t offset, uint32_t count);
+
+	uint32_t capacity() const { return _capacity; }
+	uint32_t used() const { return _used; }
+	uint32_t largest_free() const;
+
+private:
+	//offset to count of every free range
+	std::map<uint32_t, uint32_t> _free;
+	uint32_t _capacity{ 0 };
+	uint32_t _used{ 0 };
+};
+
+//where a mesh lives in the pool. offsets are in elements, ready to be passed as vertexOffset and firstIndex
+struct GeometryAllocation {
+	uint32_t vertexOffset{ 0 };
+	uint32_t vertexCount{ 0 };
+	uint32_t indexOffset{ 0 };
+	uint32_t indexCount{ 0 };
+	VkIndexType indexType{ VK_INDEX_TYPE_UINT32 };
+};
+
+struct GeometryPoolSettings {
+	//initial capacities in elements, a pool that runs out of space is compacted or doubled
+	uint32_t vertexCapacity{ 4 * 1024 * 1024 };
+	uint32_t index16Capacity{ 8 * 1024 * 1024 };
+	uint32_t index32Capacity{ 4 * 1024 * 1024 };
+};
+
+struct GeometryPoolStats {
+	size_t usedBytes{ 0 };
+	size_t capacityBytes{ 0 };
+	uint32_t allocations{ 0 };
+	//every compaction or growth of one of the buffers
+	uint32_t relocations{ 0 };
+};
+
+//every mesh vertex and index in a few big device local buffers: one for the vertices and one per index type,
+//so the whole scene draws with a single vertex buffer bind and at most two index buffer binds.
+//defragmenting or growing a buffer moves the live ranges into a new one with gpu copies recorded at the start
+//of the next frame; allocations are updated in place, so meshes only keep the pointer
+class GeometryPool {
+public:
+	void init(VulkanEngine* engine, const GeometryPoolSettings& settings = {});
+
+	//destroys every buffer, the gpu has to be idle
+	void cleanup();
+
+	//reserves room for a mesh, the caller copies the data in at the returned offsets
+	GeometryAllocation* allocate(uint32_t vertexCount, uint32_t indexCount, VkIndexType indexType);
+
+	//the ranges are reused right away unless a move is in flight, only free what the gpu no longer reads
+	void free(GeometryAllocation* allocation);
+
+	VkBuffer vertex_buffer() const { return _vertices.buffer.vkbuffer; }
+	VkBuffer index_buffer(VkIndexType indexType) const;
+
+	//compacts every buffer that has holes in it
+	void defragment();
+
+	//records the copies of the moves since the last frame, outside of a render pass. the buffers they
+	//come from are destroyed once the frame has retired
+	void record_relocations(VkCommandBuffer cmd, uint64_t frameNumber);
+	bool has_relocations() const { return !_relocations.empty(); }
+
+	//destroys the buffers the gpu is done with
+	void update(uint64_t frameNumber);
+
+	GeometryPoolStats stats() const;
+
+private:
+	struct Pool {
+		Buffer buffer;
+		uint32_t elementSize{ 0 };
+		VkBufferUsageFlags usage{ 0 };
+		RangeAllocator ranges;
+	};
+
+	//moves from one buffer to its replacement, copies have to wait for the previous step
+	struct Relocation {
+		Buffer source;
+		Buffer destination;
+		std::vector<VkBufferCopy> copies;
+	};
+
+	struct RetiredBuffer {
+		uint64_t frame;
+		Buffer buffer;
+	};
+
+	void init_pool(Pool& pool, uint32_t elementSize, uint32_t capacity, VkBufferUsageFlags usage);
+	bool allocate_range(Pool& pool, uint32_t count, uint32_t& outOffset);
+	void release(GeometryAllocation* allocation);
+	void relocate(Pool& pool, uint32_t capacity);
+
+	Pool& index_pool(VkIndexType indexType) { return indexType == VK_INDEX_TYPE_UINT16 ? _indices16 : _indices32; }
+
+	VulkanEngine* _engine{ nullptr };
+
+	Pool _vertices;
+	Pool _indices16;
+	Pool _indices32;
+
+	std::unordered_map<GeometryAllocation*, std::unique_ptr<GeometryAllocation>> _allocations;
+
+	std::vector<Relocation> _relocations;
+	std::vector<GeometryAllocation*> _deferredFrees;
+	std::vector<RetiredBuffer> _retired;
+	uint32_t _relocationCount{ 0 };
+};
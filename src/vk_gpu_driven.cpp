@@ -0,0 +1,473 @@
+#include <vk_gpu_driven.h>
+
+#include <vk_engine.h>
+#include <vk_initializers.h>
+#include <vk_shader.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+
+namespace {
+
+	constexpr uint32_t CullBindingCount = 7;
+	constexpr uint32_t CullGroupSize = 64;
+}
+
+void GpuDrivenRenderer::init(VulkanEngine* engine)
+{
+	_engine = engine;
+	VkDevice device = _engine->_logical_device;
+
+	//everything the culling reads and writes is a storage buffer
+	VkDescriptorSetLayoutBinding bindings[CullBindingCount];
+	for (uint32_t i = 0; i < CullBindingCount; i++)
+		bindings[i] = vkinit::descriptorset_layout_binding(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT, i);
+
+	VkDescriptorSetLayoutCreateInfo setInfo = {};
+	setInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	setInfo.bindingCount = CullBindingCount;
+	setInfo.pBindings = bindings;
+	_cullSetLayout = _engine->descriptorLayoutCache.create_descriptor_layout(&setInfo);
+
+	_frames.resize(FRAME_OVERLAP);
+	for (FrameResources& frame : _frames)
+	{
+		_engine->descriptoAllocator.allocate(&frame.cullSet, _cullSetLayout);
+		_engine->descriptoAllocator.allocate(&frame.objectSet, _engine->_objectSetLayout);
+	}
+
+	ShaderModule cullShader;
+	if (!load_shader_module(device, "../shaders/indirect_cull.comp.spv", &cullShader))
+	{
+		std::cout << "error loading indirect cull shader, drawing from the cpu" << std::endl;
+		return;
+	}
+
+	VkPushConstantRange pushConstants;
+	pushConstants.offset = 0;
+	pushConstants.size = sizeof(CullParams);
+	pushConstants.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+	VkPipelineLayoutCreateInfo layoutInfo = vkinit::pipeline_layout_create_info();
+	layoutInfo.setLayoutCount = 1;
+	layoutInfo.pSetLayouts = &_cullSetLayout;
+	layoutInfo.pushConstantRangeCount = 1;
+	layoutInfo.pPushConstantRanges = &pushConstants;
+	VK_CHECK(vkCreatePipelineLayout(device, &layoutInfo, nullptr, &_cullPipelineLayout));
+
+	VkComputePipelineCreateInfo pipelineInfo = {};
+	pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipelineInfo.stage = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, cullShader.shader);
+	pipelineInfo.layout = _cullPipelineLayout;
+	VK_CHECK(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &_cullPipeline));
+
+	vkDestroyShaderModule(device, cullShader.shader, nullptr);
+}
+
+void GpuDrivenRenderer::cleanup()
+{
+	if (!_engine)
+		return;
+
+	VkDevice device = _engine->_logical_device;
+	VmaAllocator allocator = _engine->_allocator;
+
+	for (Buffer* buffer : { &_objects, &_cullObjects, &_batchData })
+		vmaDestroyBuffer(allocator, buffer->vkbuffer, buffer->allocation);
+
+	for (FrameResources& frame : _frames)
+	{
+		vmaDestroyBuffer(allocator, frame.commands.vkbuffer, frame.commands.allocation);
+		vmaDestroyBuffer(allocator, frame.counts.vkbuffer, frame.counts.allocation);
+		vmaDestroyBuffer(allocator, frame.visibility.vkbuffer, frame.visibility.allocation);
+	}
+	_frames.clear();
+
+	for (RetiredBuffer& retired : _retired)
+		vmaDestroyBuffer(allocator, retired.buffer.vkbuffer, retired.buffer.allocation);
+	_retired.clear();
+
+	vkDestroyPipeline(device, _cullPipeline, nullptr);
+	vkDestroyPipelineLayout(device, _cullPipelineLayout, nullptr);
+
+	_engine = nullptr;
+}
+
+bool GpuDrivenRenderer::supported() const
+{
+	return _cullPipeline != VK_NULL_HANDLE && _engine->_drawIndirectFirstInstance;
+}
+
+void GpuDrivenRenderer::build(const std::vector<RenderObject>& objects)
+{
+	//grouped by material so every batch is one range of commands. the shaders only see the uploaded order
+	std::vector<uint32_t> order(objects.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+		return objects[a].material < objects[b].material;
+	});
+
+	std::vector<GPUObjectData> objectData;
+	std::vector<GPUCullObject> cullObjects;
+	objectData.reserve(objects.size());
+	cullObjects.reserve(objects.size());
+
+	std::unordered_map<CachedMesh*, uint32_t> meshIndices;
+	_meshes.clear();
+	_batches.clear();
+
+	for (uint32_t index : order)
+	{
+		const RenderObject& object = objects[index];
+
+		if (_batches.empty() || _batches.back().material != object.material)
+		{
+			_batches.push_back({ object.material, 0, 0, false });
+		}
+		Batch& batch = _batches.back();
+
+		auto mesh = meshIndices.find(object.mesh);
+		if (mesh == meshIndices.end())
+		{
+			mesh = meshIndices.emplace(object.mesh, uint32_t(_meshes.size())).first;
+			_meshes.push_back(object.mesh);
+		}
+
+		GPUCullObject cullObject = {};
+		cullObject.meshIndex = mesh->second;
+		cullObject.batchIndex = uint32_t(_batches.size() - 1);
+		cullObject.batchSlot = batch.objectCount++;
+		cullObjects.push_back(cullObject);
+
+		GPUObjectData data;
+		data.modelMatrix = object.transform;
+		objectData.push_back(data);
+	}
+
+	//a region per index type in every batch, both as big as the batch
+	std::vector<GPUBatch> batchData;
+	uint32_t commandOffset = 0;
+	for (Batch& batch : _batches)
+	{
+		batch.commandOffset = commandOffset;
+		commandOffset += batch.objectCount * 2;
+
+		GPUBatch data = {};
+		data.commandOffset = batch.commandOffset;
+		data.objectCount = batch.objectCount;
+		batchData.push_back(data);
+	}
+
+	_objectCount = uint32_t(objects.size());
+	_commandCount = commandOffset;
+
+	//the mesh and batch indices of the flags read back from earlier builds mean nothing anymore
+	_buildCount++;
+	_meshSpheres.assign(_meshes.size(), glm::vec4(0.f, 0.f, 0.f, std::numeric_limits<float>::infinity()));
+
+	//frames in flight may still cull with the previous scene
+	for (Buffer* buffer : { &_objects, &_cullObjects, &_batchData })
+		retire(*buffer);
+
+	if (_objectCount == 0)
+		return;
+
+	_objects = upload_buffer(objectData.data(), objectData.size() * sizeof(GPUObjectData), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	_cullObjects = upload_buffer(cullObjects.data(), cullObjects.size() * sizeof(GPUCullObject), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+	_batchData = upload_buffer(batchData.data(), batchData.size() * sizeof(GPUBatch), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT);
+
+	//no wait, the scene is drawn from the first frame after the copies completed
+	_uploadValue = _engine->_uploader.submit();
+
+	_stats.objects = _objectCount;
+	_stats.meshes = uint32_t(_meshes.size());
+	_stats.batches = uint32_t(_batches.size());
+}
+
+bool GpuDrivenRenderer::ready() const
+{
+	return _objectCount > 0 && _uploadValue > 0 && _engine->_uploader.completed() >= _uploadValue;
+}
+
+Buffer GpuDrivenRenderer::upload_buffer(const void* data, size_t size, VkBufferUsageFlags usage)
+{
+	UploadBatcher& uploader = _engine->_uploader;
+
+	Buffer buffer = _engine->create_device_buffer(size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+
+	StagingRegion staging = uploader.allocate_staging(size);
+	memcpy(staging.data, data, size);
+
+	VkBufferCopy copy;
+	copy.srcOffset = staging.offset;
+	copy.dstOffset = 0;
+	copy.size = size;
+	vkCmdCopyBuffer(uploader.command_buffer(), staging.buffer, buffer.vkbuffer, 1, &copy);
+	uploader.release_after_batch(staging);
+
+	return buffer;
+}
+
+Buffer GpuDrivenRenderer::create_readback_buffer(size_t size, const uint32_t** outData)
+{
+	VkBufferCreateInfo createInfo = {};
+	createInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	createInfo.size = size;
+	createInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+	VmaAllocationCreateInfo allocInfo = {};
+	allocInfo.usage = VMA_MEMORY_USAGE_GPU_TO_CPU;
+	allocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+	Buffer buffer;
+	VmaAllocationInfo allocationInfo;
+	VK_CHECK(vmaCreateBuffer(_engine->_allocator, &createInfo, &allocInfo, &buffer.vkbuffer, &buffer.allocation, &allocationInfo));
+
+	*outData = (const uint32_t*)allocationInfo.pMappedData;
+	return buffer;
+}
+
+void GpuDrivenRenderer::retire(Buffer& buffer)
+{
+	if (buffer.vkbuffer != VK_NULL_HANDLE)
+	{
+		_retired.push_back({ uint64_t(_engine->_frameNumber), buffer });
+	}
+	buffer = Buffer{};
+}
+
+void GpuDrivenRenderer::record_culling(VkCommandBuffer cmd)
+{
+	FrameResources& frame = _frames[_engine->_frameNumber % FRAME_OVERLAP];
+	FrameAllocator& frameAllocator = _engine->get_current_frame().frameAllocator;
+
+	//sized to the scene, the previous buffers of this frame are not used anymore once its fence signaled
+	const VkBufferUsageFlags drawUsage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	if (frame.commandCapacity < _commandCount)
+	{
+		retire(frame.commands);
+		frame.commands = _engine->create_buffer(size_t(_commandCount) * sizeof(VkDrawIndexedIndirectCommand), drawUsage, VMA_MEMORY_USAGE_GPU_ONLY);
+		frame.commandCapacity = _commandCount;
+	}
+
+	uint32_t countCount = uint32_t(_batches.size()) * 2;
+	if (frame.countCapacity < countCount)
+	{
+		retire(frame.counts);
+		frame.counts = _engine->create_buffer(size_t(countCount) * sizeof(uint32_t), drawUsage, VMA_MEMORY_USAGE_GPU_ONLY);
+		frame.countCapacity = countCount;
+	}
+
+	const uint32_t meshCount = uint32_t(_meshes.size());
+	uint32_t visibilityCount = meshCount + uint32_t(_batches.size());
+	if (frame.visibilityCapacity < visibilityCount)
+	{
+		retire(frame.visibility);
+		frame.visibility = create_readback_buffer(size_t(visibilityCount) * sizeof(uint32_t), &frame.visibilityData);
+		frame.visibilityCapacity = visibilityCount;
+		frame.visibilityBuild = 0;
+	}
+
+	//the flags this frame's culling wrote last time, its fence has signaled since. without them, right after
+	//a build, everything is used like before
+	const uint32_t* lastVisible = nullptr;
+	if (frame.visibilityBuild == _buildCount)
+	{
+		vmaInvalidateAllocation(_engine->_allocator, frame.visibility.allocation, 0, VK_WHOLE_SIZE);
+		lastVisible = frame.visibilityData;
+	}
+
+	//only what was seen is used, the rest is drawn while it stays resident but ages in the cache
+	ResourceCache& cache = _engine->_resourceCache;
+	auto seen = [&](uint32_t index) {
+		return !lastVisible || lastVisible[index] != 0;
+	};
+
+	//residency and position in the geometry pool change from frame to frame, so the mesh table is written
+	//every frame
+	FrameAllocation meshTable = frameAllocator.allocate_storage(sizeof(GPUMeshData) * _meshes.size());
+	GPUMeshData* meshData = (GPUMeshData*)meshTable.data;
+	for (uint32_t i = 0; i < meshCount; i++)
+	{
+		GPUMeshData& data = meshData[i];
+		data = {};
+
+		CachedMesh* cached = _meshes[i];
+		bool resident = seen(i) ? cache.use(cached) : cached->residency == Residency::Resident;
+		if (resident)
+		{
+			_meshSpheres[i] = cached->mesh.boundingSphere;
+		}
+
+		//evicted meshes are still culled, coming into view is what streams them back in
+		data.sphere = _meshSpheres[i];
+		if (!resident)
+			continue;
+
+		const Mesh& mesh = cached->mesh;
+		data.vertexOffset = mesh.geometry->vertexOffset;
+		data.indexType = mesh.indexType == VK_INDEX_TYPE_UINT16 ? 0 : 1;
+		data.lodCount = mesh.lodCount;
+		data.resident = 1;
+		for (uint32_t lod = 0; lod < mesh.lodCount; lod++)
+		{
+			data.lods[lod].firstIndex = mesh.geometry->indexOffset + mesh.lods[lod].firstIndex;
+			data.lods[lod].indexCount = mesh.lods[lod].indexCount;
+			data.lods[lod].error = mesh.lods[lod].error;
+		}
+	}
+
+	for (uint32_t batchIndex = 0; batchIndex < uint32_t(_batches.size()); batchIndex++)
+	{
+		Batch& batch = _batches[batchIndex];
+		Material* material = batch.material;
+		if (material->texture)
+		{
+			batch.drawable = seen(meshCount + batchIndex) ? cache.use(material->texture) : material->texture->residency == Residency::Resident;
+		}
+		else
+		{
+			batch.drawable = true;
+		}
+
+		if (batch.drawable && material->texture && material->textureVersion != material->texture->version)
+		{
+			_engine->write_material_texture(material);
+		}
+	}
+
+	//both sets of this frame are only used by this frame
+	{
+		VkDescriptorBufferInfo infos[CullBindingCount] = {
+			{ _objects.vkbuffer, 0, VK_WHOLE_SIZE },
+			{ _cullObjects.vkbuffer, 0, VK_WHOLE_SIZE },
+			{ _batchData.vkbuffer, 0, VK_WHOLE_SIZE },
+			{ meshTable.buffer, meshTable.offset, meshTable.size },
+			{ frame.commands.vkbuffer, 0, VK_WHOLE_SIZE },
+			{ frame.counts.vkbuffer, 0, VK_WHOLE_SIZE },
+			{ frame.visibility.vkbuffer, 0, VK_WHOLE_SIZE }
+		};
+
+		VkWriteDescriptorSet writes[CullBindingCount + 1];
+		for (uint32_t i = 0; i < CullBindingCount; i++)
+			writes[i] = vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame.cullSet, &infos[i], i);
+		writes[CullBindingCount] = vkinit::write_descriptor_buffer(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, frame.objectSet, &infos[0], 0);
+
+		vkUpdateDescriptorSets(_engine->_logical_device, CullBindingCount + 1, writes, 0, nullptr);
+	}
+
+	const bool compact = _engine->_drawIndirectCount;
+
+	VkMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+
+	if (compact)
+	{
+		vkCmdFillBuffer(cmd, frame.counts.vkbuffer, 0, VK_WHOLE_SIZE, 0);
+	}
+	vkCmdFillBuffer(cmd, frame.visibility.vkbuffer, 0, VK_WHOLE_SIZE, 0);
+
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	Camera& camera = _engine->camera;
+
+	CullParams params = {};
+	camera.get_frustum_planes(params.planes);
+	glm::vec3 cameraPosition = glm::inverse(camera.get_view())[3];
+	float pixelsPerUnit = _engine->_windowExtent.height * 0.5f / std::tan(glm::radians(camera.fovy) * 0.5f);
+	params.cameraPosition = glm::vec4(cameraPosition, pixelsPerUnit);
+	params.objectCount = _objectCount;
+	params.lodThreshold = lodThreshold;
+	params.compact = compact ? 1 : 0;
+	params.meshCount = meshCount;
+
+	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _cullPipeline);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, _cullPipelineLayout, 0, 1, &frame.cullSet, 0, nullptr);
+	vkCmdPushConstants(cmd, _cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullParams), &params);
+	vkCmdDispatch(cmd, (_objectCount + CullGroupSize - 1) / CullGroupSize, 1, 1);
+
+	//the flags are read on the host once the fence of the frame signaled
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	frame.visibilityBuild = _buildCount;
+}
+
+void GpuDrivenRenderer::record_draws(VkCommandBuffer cmd, VkDescriptorSet globalSet, uint32_t globalOffset)
+{
+	FrameResources& frame = _frames[_engine->_frameNumber % FRAME_OVERLAP];
+	GeometryPool& pool = _engine->_geometryPool;
+
+	VkBuffer vertexBuffer = pool.vertex_buffer();
+	VkDeviceSize vertexBufferOffset = 0;
+	vkCmdBindVertexBuffers(cmd, 0, 1, &vertexBuffer, &vertexBufferOffset);
+
+	const VkIndexType indexTypes[] = { VK_INDEX_TYPE_UINT16, VK_INDEX_TYPE_UINT32 };
+	const uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+
+	_stats.drawCalls = 0;
+	for (size_t batchIndex = 0; batchIndex < _batches.size(); batchIndex++)
+	{
+		const Batch& batch = _batches[batchIndex];
+		if (!batch.drawable)
+			continue;
+
+		Material* material = batch.material;
+		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, material->pipeline);
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, material->pipelineLayout, 0, 1, &globalSet, 1, &globalOffset);
+		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, material->pipelineLayout, 1, 1, &frame.objectSet, 0, nullptr);
+		if (material->textureSet != VK_NULL_HANDLE)
+		{
+			vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, material->pipelineLayout, 2, 1, &material->textureSet, 0, nullptr);
+		}
+
+		for (uint32_t type = 0; type < 2; type++)
+		{
+			vkCmdBindIndexBuffer(cmd, pool.index_buffer(indexTypes[type]), 0, indexTypes[type]);
+
+			uint32_t firstCommand = batch.commandOffset + type * batch.objectCount;
+			VkDeviceSize offset = VkDeviceSize(firstCommand) * stride;
+
+			if (_engine->_drawIndirectCount)
+			{
+				VkDeviceSize countOffset = (batchIndex * 2 + type) * sizeof(uint32_t);
+				vkCmdDrawIndexedIndirectCount(cmd, frame.commands.vkbuffer, offset, frame.counts.vkbuffer, countOffset, batch.objectCount, stride);
+				_stats.drawCalls++;
+			}
+			else if (_engine->_multiDrawIndirect)
+			{
+				vkCmdDrawIndexedIndirect(cmd, frame.commands.vkbuffer, offset, batch.objectCount, stride);
+				_stats.drawCalls++;
+			}
+			else
+			{
+				//one command per call without multi draw, still no cpu culling or lod work
+				for (uint32_t i = 0; i < batch.objectCount; i++)
+				{
+					vkCmdDrawIndexedIndirect(cmd, frame.commands.vkbuffer, offset + VkDeviceSize(i) * stride, 1, stride);
+				}
+				_stats.drawCalls += batch.objectCount;
+			}
+		}
+	}
+}
+
+void GpuDrivenRenderer::update(uint64_t frameNumber)
+{
+	auto done = std::remove_if(_retired.begin(), _retired.end(), [&](const RetiredBuffer& retired) {
+		if (retired.frame + FRAME_OVERLAP > frameNumber)
+			return false;
+
+		vmaDestroyBuffer(_engine->_allocator, retired.buffer.vkbuffer, retired.buffer.allocation);
+		return true;
+	});
+	_retired.erase(done, _retired.end());
+}
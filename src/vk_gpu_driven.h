@@ -0,0 +1,156 @@
+#pragma once
+
+#include <vk_types.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+class VulkanEngine;
+struct RenderObject;
+struct Material;
+struct CachedMesh;
+
+struct GpuDrivenStats {
+	uint32_t objects{ 0 };
+	uint32_t meshes{ 0 };
+	uint32_t batches{ 0 };
+	//indirect draw calls recorded last frame, independent of how many objects they draw
+	uint32_t drawCalls{ 0 };
+};
+
+//draws the scene without touching the objects on the cpu. the object transforms and which mesh and material
+//each one uses are uploaded once, a compute shader frustum culls every object, picks its detail level and
+//writes its VkDrawIndexedIndirectCommand, and the frame issues one indirect draw per material batch and index
+//type. the per frame cpu work only grows with the number of meshes and materials. the culling also flags
+//every mesh and batch with an object in the frustum, and only those are used in the resource cache once
+//the frame has retired, so what the camera has not seen for a while can be evicted
+class GpuDrivenRenderer {
+public:
+	void init(VulkanEngine* engine);
+
+	//destroys every buffer, the gpu has to be idle
+	void cleanup();
+
+	//needs the object index as first instance of an indirect draw
+	bool supported() const;
+
+	//uploads the scene, again every time the objects change. drawing starts once the upload completed
+	void build(const std::vector<RenderObject>& objects);
+	bool ready() const;
+
+	//outside of a render pass: writes the mesh table of the frame and dispatches the culling
+	void record_culling(VkCommandBuffer cmd);
+
+	//inside the render pass, after record_culling
+	void record_draws(VkCommandBuffer cmd, VkDescriptorSet globalSet, uint32_t globalOffset);
+
+	//destroys the buffers of older builds once the frames using them have retired
+	void update(uint64_t frameNumber);
+
+	const GpuDrivenStats& stats() const { return _stats; }
+
+	//in pixels, how far a simplified level can be off before a finer one is picked
+	float lodThreshold{ 1.f };
+
+private:
+	//layouts shared with indirect_cull.comp
+	struct GPUCullObject {
+		uint32_t meshIndex;
+		uint32_t batchIndex;
+		uint32_t batchSlot;
+		uint32_t pad;
+	};
+
+	struct GPUBatch {
+		uint32_t commandOffset;
+		uint32_t objectCount;
+		uint32_t pad[2];
+	};
+
+	struct GPUMeshLod {
+		uint32_t firstIndex;
+		uint32_t indexCount;
+		float error;
+		uint32_t pad;
+	};
+
+	struct GPUMeshData {
+		glm::vec4 sphere;
+		uint32_t vertexOffset;
+		uint32_t indexType;
+		uint32_t lodCount;
+		uint32_t resident;
+		GPUMeshLod lods[8];
+	};
+
+	struct CullParams {
+		glm::vec4 planes[6];
+		glm::vec4 cameraPosition;
+		uint32_t objectCount;
+		float lodThreshold;
+		uint32_t compact;
+		uint32_t meshCount;
+	};
+
+	//objects sharing a material, their commands are contiguous
+	struct Batch {
+		Material* material;
+		uint32_t commandOffset;
+		uint32_t objectCount;
+		//the texture of the material is resident this frame
+		bool drawable;
+	};
+
+	//what the compute shader writes, one set per frame in flight
+	struct FrameResources {
+		Buffer commands;
+		Buffer counts;
+		uint32_t commandCapacity{ 0 };
+		uint32_t countCapacity{ 0 };
+		VkDescriptorSet cullSet{ VK_NULL_HANDLE };
+		//set 1 of the material pipelines, pointing at the uploaded transforms
+		VkDescriptorSet objectSet{ VK_NULL_HANDLE };
+		//a flag per mesh followed by one per batch, set by the culling when an object is in the frustum.
+		//host visible, read back the next time the frame is recorded
+		Buffer visibility;
+		const uint32_t* visibilityData{ nullptr };
+		uint32_t visibilityCapacity{ 0 };
+		//the build the flags were written for, 0 while there are none
+		uint64_t visibilityBuild{ 0 };
+	};
+
+	struct RetiredBuffer {
+		uint64_t frame;
+		Buffer buffer;
+	};
+
+	Buffer upload_buffer(const void* data, size_t size, VkBufferUsageFlags usage);
+	Buffer create_readback_buffer(size_t size, const uint32_t** outData);
+	void retire(Buffer& buffer);
+
+	VulkanEngine* _engine{ nullptr };
+
+	VkDescriptorSetLayout _cullSetLayout{ VK_NULL_HANDLE };
+	VkPipelineLayout _cullPipelineLayout{ VK_NULL_HANDLE };
+	VkPipeline _cullPipeline{ VK_NULL_HANDLE };
+
+	//uploaded once per build
+	Buffer _objects;
+	Buffer _cullObjects;
+	Buffer _batchData;
+	uint64_t _uploadValue{ 0 };
+	uint64_t _buildCount{ 0 };
+
+	std::vector<CachedMesh*> _meshes;
+	//bounds of every mesh, kept when it is evicted so it is still culled. infinite until it was resident once
+	std::vector<glm::vec4> _meshSpheres;
+	std::vector<Batch> _batches;
+	uint32_t _objectCount{ 0 };
+	uint32_t _commandCount{ 0 };
+
+	std::vector<FrameResources> _frames;
+	std::vector<RetiredBuffer> _retired;
+
+	GpuDrivenStats _stats;
+};
@@ -24,6 +24,17 @@ VkCommandBufferAllocateInfo vkinit::command_buffer_allocate_info(VkCommandPool p
 	return info;
 }
 
+VkCommandBufferBeginInfo vkinit::command_buffer_begin_info(VkCommandBufferUsageFlags flags /*= 0*/, const VkCommandBufferInheritanceInfo* inheritance /*= nullptr*/)
+{
+	VkCommandBufferBeginInfo info = {};
+	info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	info.pNext = nullptr;
+
+	info.flags = flags;
+	info.pInheritanceInfo = inheritance;
+	return info;
+}
+
 VkAttachmentDescription vkinit::attachment_description_create(VkFormat imageFormat)
 {
 	VkAttachmentDescription attachment = {	.format =  imageFormat,
@@ -250,6 +261,11 @@ VkSamplerCreateInfo vkinit::sampler_create_info(VkFilter filters, VkSamplerAddre
 	info.addressModeV = samplerAdressMode;
 	info.addressModeW = samplerAdressMode;
 
+	//sample across the whole mip chain, images without mips only have level 0
+	info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+	info.minLod = 0.f;
+	info.maxLod = VK_LOD_CLAMP_NONE;
+
 	return info;
 }
 VkWriteDescriptorSet vkinit::write_descriptor_image(VkDescriptorType type, VkDescriptorSet dstSet, VkDescriptorImageInfo* imageInfo, uint32_t binding)
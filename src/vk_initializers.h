@@ -9,6 +9,8 @@ namespace vkinit
 
 	VkCommandBufferAllocateInfo command_buffer_allocate_info(VkCommandPool pool, uint32_t count = 1, VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
 
+	VkCommandBufferBeginInfo command_buffer_begin_info(VkCommandBufferUsageFlags flags = 0, const VkCommandBufferInheritanceInfo* inheritance = nullptr);
+
 	VkAttachmentDescription attachment_description_create(VkFormat imageFormat);
 
 	VkRenderPassCreateInfo render_pass_create_info(std::vector<VkAttachmentDescription> &attachments, std::vector<VkSubpassDescription> &subpasses);
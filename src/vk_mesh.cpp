@@ -7,6 +7,9 @@
 #include <mesh_asset.h>
 
 #include <cstdint>
+#include <algorithm>
+
+static_assert(sizeof(Vertex) == sizeof(assets::Vertex_P32N8C8V16), "engine vertex has to match the packed asset vertex");
 
 VertexInputDescription Vertex::get_vertex_description()
 {
@@ -28,19 +31,19 @@ VertexInputDescription Vertex::get_vertex_description()
 	VkVertexInputAttributeDescription normalAttribute = {};
 	normalAttribute.binding = 0;
 	normalAttribute.location = 1;
-	normalAttribute.format = VK_FORMAT_R32G32B32_SFLOAT;
+	normalAttribute.format = VK_FORMAT_R8G8B8A8_SNORM;
 	normalAttribute.offset = offsetof(Vertex, normal);
 
 	VkVertexInputAttributeDescription colorAttribute = {};
 	colorAttribute.binding = 0;
 	colorAttribute.location = 2;
-	colorAttribute.format = VK_FORMAT_R32G32B32_SFLOAT;
+	colorAttribute.format = VK_FORMAT_R8G8B8A8_UNORM;
 	colorAttribute.offset = offsetof(Vertex, color);
 
 	VkVertexInputAttributeDescription uvAttribute = {};
 	uvAttribute.binding = 0;
 	uvAttribute.location = 3;
-	uvAttribute.format = VK_FORMAT_R32G32_SFLOAT;
+	uvAttribute.format = VK_FORMAT_R16G16_SFLOAT;
 	uvAttribute.offset = offsetof(Vertex, uv);
 
 	description.attributes.push_back(positionAttribute);
@@ -51,56 +54,51 @@ VertexInputDescription Vertex::get_vertex_description()
 	return description;
 }
 
-bool Mesh::load_mesh(const char* filename)
+bool Mesh::load_header(const assets::AssetView& file, assets::MeshInfo& outInfo)
 {
-	assets::AssetFile file;
-	assets::MeshInfo info;
+	outInfo = assets::read_mesh_info(file);
 
-	bool loaded = assets::load_binaryfile(filename, file);
-	if (!loaded)
+	if (outInfo.indexSize != 2 && outInfo.indexSize != 4)
 	{
-		std::cout << "Error when loading mesh " << filename << std::endl;;
+		std::cout << "Unsupported index size " << int(outInfo.indexSize) << std::endl;
 		return false;
 	}
 
-	info = read_mesh_info(&file);
-
-	//TODO when using index drawing change this
-	std::vector<char> vertexBuffer;
-	std::vector<char> indexBuffer;
-
-	vertexBuffer.resize(info.vertexBuferSize);
-	indexBuffer.resize(info.indexBuferSize);
-
-	assets::unpack_mesh(&info, file.binaryBlob.data(), file.binaryBlob.size(), vertexBuffer.data(), indexBuffer.data());
-
-	uint32_t indexCount  = indexBuffer.size() / sizeof(uint32_t);
-	uint32_t vertexCount = vertexBuffer.size() / sizeof(assets::Vertex_f32_PNCV);
-
-	uint32_t* unpacked_indices = (uint32_t*)indexBuffer.data();
-	vertices.resize(indexCount);
-	assets::Vertex_f32_PNCV* unpackedVertices = (assets::Vertex_f32_PNCV*)vertexBuffer.data();
-
-	for (int i = 0; i < indexCount; i++)
+	//nothing to draw, and vulkan buffers can not be empty
+	if (outInfo.vertexCount == 0 || outInfo.lods[0].indexCount == 0)
 	{
-		Vertex new_vert;
-		new_vert.position.x = unpackedVertices[ unpacked_indices[i] ].position[0];
-		new_vert.position.y = unpackedVertices[ unpacked_indices[i] ].position[1];
-		new_vert.position.z = unpackedVertices[ unpacked_indices[i] ].position[2];
+		std::cout << "Mesh has no triangles" << std::endl;
+		return false;
+	}
 
-		new_vert.normal.x = unpackedVertices[ unpacked_indices[i] ].normal[0];
-		new_vert.normal.y = unpackedVertices[ unpacked_indices[i] ].normal[1];
-		new_vert.normal.z = unpackedVertices[ unpacked_indices[i] ].normal[2];
+	vertexCount = outInfo.vertexCount;
+	indexBufferCount = outInfo.indexBuferSize / uint32_t(outInfo.indexSize);
+	vertexBufferSize = size_t(vertexCount) * sizeof(Vertex);
+	indexBufferSize = outInfo.indexBuferSize;
 
-		new_vert.color.x = unpackedVertices[ unpacked_indices[i] ].color[0];
-		new_vert.color.y = unpackedVertices[ unpacked_indices[i] ].color[1];
-		new_vert.color.z = unpackedVertices[ unpacked_indices[i] ].color[2];
+	//meshes with up to 65536 vertices are baked with 16 bit indices
+	indexType = outInfo.indexSize == 2 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
 
-		new_vert.uv.x = unpackedVertices[ unpacked_indices[i] ].uv[0];
-		new_vert.uv.y = unpackedVertices[ unpacked_indices[i] ].uv[0];
+	//the full detail level comes first, the simplified ones follow it in the index buffer
+	firstIndex = outInfo.lods[0].indexOffset;
+	indexCount = outInfo.lods[0].indexCount;
 
-		vertices.push_back(new_vert);
+	lodCount = std::min(std::max(outInfo.lodCount, 1u), MaxLods);
+	for (uint32_t i = 0; i < lodCount; i++)
+	{
+		lods[i].firstIndex = outInfo.lods[i].indexOffset;
+		lods[i].indexCount = outInfo.lods[i].indexCount;
+		lods[i].error = outInfo.lods[i].error;
 	}
 
+	const assets::MeshBounds& bounds = outInfo.bounds;
+	boundingSphere = glm::vec4(bounds.origin[0], bounds.origin[1], bounds.origin[2], bounds.radius);
+
 	return true;
 }
+
+bool Mesh::decode(const assets::AssetView& file, assets::MeshInfo& info, char* vertexDestination, char* indexDestination) const
+{
+	//full precision assets are quantized on the way
+	return assets::unpack_mesh_packed(&info, file.binaryBlob, file.blobSize, (assets::Vertex_P32N8C8V16*)vertexDestination, indexDestination);
+}
@@ -9,6 +9,9 @@
 #include <assimp/scene.h>           // Output data structure
 #include <assimp/postprocess.h>     // Post processing flags
 
+namespace assets { struct AssetView; struct MeshInfo; }
+struct GeometryAllocation;
+
 struct VertexInputDescription {
   std::vector<VkVertexInputBindingDescription>   bindings;
   std::vector<VkVertexInputAttributeDescription> attributes;
@@ -16,19 +19,53 @@ struct VertexInputDescription {
   VkPipelineVertexInputStateCreateFlags flags = 0;
 };
 
+//same layout as assets::Vertex_P32N8C8V16, the attributes are expanded to float by the input assembler
 struct Vertex {
   glm::vec3 position;
-  glm::vec3 normal;
-  glm::vec3 color;
-  glm::vec2 uv;
+  int8_t normal[4];
+  uint8_t color[4];
+  uint16_t uv[2];
 
   static VertexInputDescription get_vertex_description();
 };
 
 struct Mesh {
-  std::vector<Vertex> vertices;
+  VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+
+  //the vertices and indices only live on the gpu
+  uint32_t vertexCount = 0;
+  uint32_t indexBufferCount = 0;
+  size_t vertexBufferSize = 0;
+  size_t indexBufferSize = 0;
+
+  //range of the full detail level in the mesh indices, the one the cpu path draws
+  uint32_t firstIndex = 0;
+  uint32_t indexCount = 0;
+
+  //every detail level from full to coarsest, picked per instance by the gpu driven path
+  struct Lod {
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    //object space distance the simplified surface can be away from the original one
+    float error;
+  };
+  static constexpr uint32_t MaxLods = 8;
+  uint32_t lodCount = 0;
+  Lod lods[MaxLods];
+
+  //object space bounding sphere, center in xyz and radius in w
+  glm::vec4 boundingSphere{ 0.f };
+
+  //where the vertices and indices are in the geometry pool
+  GeometryAllocation* geometry = nullptr;
+
+  //streamed meshes are drawn once their vertices and indices reached the gpu
+  bool resident() const { return geometry != nullptr; }
 
-  Buffer verticesBuffer;
+  //reads the asset header, the sizes and draw range above are valid after it
+  bool load_header(const assets::AssetView& file, assets::MeshInfo& outInfo);
 
-  bool load_mesh(const char* filename);
+  //decodes the asset straight into the gpu layout. The destinations hold vertexBufferSize and indexBufferSize bytes,
+  //they are meant to be mapped staging memory so the data is written once on its way to the gpu
+  bool decode(const assets::AssetView& file, assets::MeshInfo& info, char* vertexDestination, char* indexDestination) const;
 };
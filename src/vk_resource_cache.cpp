@@ -0,0 +1,263 @@
+#include <vk_resource_cache.h>
+
+#include <vk_engine.h>
+#include <vk_initializers.h>
+
+#include <algorithm>
+
+void ResourceCache::init(VulkanEngine* engine, AssetStreamer* streamer, const ResourceCacheSettings& settings)
+{
+	_engine = engine;
+	_streamer = streamer;
+	_settings = settings;
+
+	//a resource still referenced by a frame in flight must never be picked
+	_settings.minIdleFrames = std::max(_settings.minIdleFrames, FRAME_OVERLAP + 1);
+}
+
+void ResourceCache::cleanup()
+{
+	if (!_engine)
+		return;
+
+	for (PendingDestroy& pending : _pendingDestroys)
+		pending.destroy();
+	_pendingDestroys.clear();
+
+	for (auto& [name, entry] : _meshes)
+	{
+		if (entry->residency == Residency::Resident)
+			evict(*entry);
+	}
+
+	for (auto& [name, entry] : _textures)
+	{
+		if (entry->residency == Residency::Resident)
+			evict(*entry);
+	}
+
+	//everything evicted above went through the queue again
+	for (PendingDestroy& pending : _pendingDestroys)
+		pending.destroy();
+	_pendingDestroys.clear();
+
+	_loading.clear();
+	_meshes.clear();
+	_textures.clear();
+	_engine = nullptr;
+}
+
+CachedMesh* ResourceCache::add_mesh(const std::string& name, const std::string& asset)
+{
+	std::unique_ptr<CachedMesh>& entry = _meshes[name];
+	if (!entry)
+	{
+		entry = std::make_unique<CachedMesh>();
+		entry->asset = asset;
+		entry->type = StreamAssetType::Mesh;
+	}
+	return entry.get();
+}
+
+CachedTexture* ResourceCache::add_texture(const std::string& name, const std::string& asset)
+{
+	std::unique_ptr<CachedTexture>& entry = _textures[name];
+	if (!entry)
+	{
+		entry = std::make_unique<CachedTexture>();
+		entry->asset = asset;
+		entry->type = StreamAssetType::Texture;
+	}
+	return entry.get();
+}
+
+CachedMesh* ResourceCache::find_mesh(const std::string& name)
+{
+	auto it = _meshes.find(name);
+	return it == _meshes.end() ? nullptr : it->second.get();
+}
+
+CachedTexture* ResourceCache::find_texture(const std::string& name)
+{
+	auto it = _textures.find(name);
+	return it == _textures.end() ? nullptr : it->second.get();
+}
+
+bool ResourceCache::touch(CacheEntry& entry)
+{
+	entry.lastUsedFrame = _frameNumber;
+
+	if (entry.residency == Residency::Resident)
+	{
+		_stats.hits++;
+		return true;
+	}
+
+	if (entry.residency == Residency::Evicted)
+		_stats.misses++;
+
+	return false;
+}
+
+bool ResourceCache::use(CachedMesh* entry)
+{
+	if (touch(*entry))
+		return true;
+
+	if (entry->residency == Residency::Evicted)
+		request(entry);
+	return false;
+}
+
+bool ResourceCache::use(CachedTexture* entry)
+{
+	if (touch(*entry))
+		return true;
+
+	if (entry->residency == Residency::Evicted)
+		request(entry);
+	return false;
+}
+
+void ResourceCache::request(CachedMesh* entry)
+{
+	entry->residency = Residency::Loading;
+
+	StreamHandle handle = _streamer->request_mesh(entry->asset, [this, entry](Mesh& mesh) {
+		entry->mesh = std::move(mesh);
+
+		//the vertices and indices only live on the gpu, in the geometry pool
+		make_resident(*entry, entry->mesh.vertexBufferSize + entry->mesh.indexBufferSize);
+	});
+
+	_loading.emplace_back(entry, std::move(handle));
+}
+
+void ResourceCache::request(CachedTexture* entry)
+{
+	entry->residency = Residency::Loading;
+
+	StreamHandle handle = _streamer->request_texture(entry->asset, [this, entry](Image& image) {
+		Texture& texture = entry->texture;
+		texture.image = image;
+
+		VkImageViewCreateInfo imageinfo = vkinit::imageview_create_info(image.format, image.vkimage, VK_IMAGE_ASPECT_COLOR_BIT);
+		imageinfo.subresourceRange.levelCount = image.mipLevels;
+		vkCreateImageView(_engine->_logical_device, &imageinfo, nullptr, &texture.imageView);
+
+		entry->version++;
+
+		//the pixels only live on the gpu
+		make_resident(*entry, allocation_size(image.allocation));
+	});
+
+	_loading.emplace_back(entry, std::move(handle));
+}
+
+void ResourceCache::make_resident(CacheEntry& entry, size_t gpuBytes)
+{
+	entry.residency = Residency::Resident;
+	entry.gpuBytes = gpuBytes;
+
+	_stats.gpuBytes += gpuBytes;
+}
+
+size_t ResourceCache::allocation_size(VmaAllocation allocation) const
+{
+	VmaAllocationInfo info;
+	vmaGetAllocationInfo(_engine->_allocator, allocation, &info);
+	return size_t(info.size);
+}
+
+void ResourceCache::evict(CacheEntry& entry)
+{
+	VulkanEngine* engine = _engine;
+	std::function<void()> destroy;
+
+	if (entry.type == StreamAssetType::Mesh)
+	{
+		CachedMesh* cachedMesh = static_cast<CachedMesh*>(&entry);
+		GeometryAllocation* geometry = cachedMesh->mesh.geometry;
+		destroy = [=]() {
+			engine->_geometryPool.free(geometry);
+		};
+
+		//the cpu copy is not read by the gpu, it goes right away
+		cachedMesh->mesh = Mesh{};
+	}
+	else
+	{
+		CachedTexture* cachedTexture = static_cast<CachedTexture*>(&entry);
+		Texture texture = cachedTexture->texture;
+		destroy = [=]() {
+			vkDestroyImageView(engine->_logical_device, texture.imageView, nullptr);
+			vmaDestroyImage(engine->_allocator, texture.image.vkimage, texture.image.allocation);
+		};
+
+		cachedTexture->texture = Texture{};
+	}
+
+	_pendingDestroys.push_back({ _frameNumber, std::move(destroy) });
+
+	_stats.gpuBytes -= entry.gpuBytes;
+	entry.gpuBytes = 0;
+	entry.residency = Residency::Evicted;
+}
+
+void ResourceCache::evict_over_budget()
+{
+	if (_stats.gpuBytes <= _settings.gpuBudget)
+		return;
+
+	std::vector<CacheEntry*> candidates;
+	auto gather = [&](CacheEntry& entry) {
+		if (entry.residency == Residency::Resident && _frameNumber - entry.lastUsedFrame >= _settings.minIdleFrames)
+			candidates.push_back(&entry);
+	};
+
+	for (auto& [name, entry] : _meshes)
+		gather(*entry);
+	for (auto& [name, entry] : _textures)
+		gather(*entry);
+
+	//least recently used first
+	std::sort(candidates.begin(), candidates.end(), [](const CacheEntry* a, const CacheEntry* b) {
+		return a->lastUsedFrame < b->lastUsedFrame;
+	});
+
+	for (CacheEntry* entry : candidates)
+	{
+		if (_stats.gpuBytes <= _settings.gpuBudget)
+			break;
+
+		evict(*entry);
+		_stats.evictions++;
+	}
+}
+
+void ResourceCache::update(uint64_t frameNumber)
+{
+	_frameNumber = frameNumber;
+
+	//the streamer has no callback for failures, find them here so they are not requested every frame
+	for (auto& [entry, handle] : _loading)
+	{
+		if (handle->state == StreamState::Failed && entry->residency == Residency::Loading)
+			entry->residency = Residency::Failed;
+	}
+
+	_loading.erase(std::remove_if(_loading.begin(), _loading.end(), [](const std::pair<CacheEntry*, StreamHandle>& loading) {
+		StreamState state = loading.second->state;
+		return state == StreamState::Ready || state == StreamState::Failed;
+	}), _loading.end());
+
+	evict_over_budget();
+
+	//once FRAME_OVERLAP frames have been recorded after the eviction, the fences of every frame that could
+	//have used the resource have been waited on
+	while (!_pendingDestroys.empty() && _pendingDestroys.front().frame + FRAME_OVERLAP <= _frameNumber)
+	{
+		_pendingDestroys.front().destroy();
+		_pendingDestroys.pop_front();
+	}
+}
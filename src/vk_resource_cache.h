@@ -0,0 +1,120 @@
+#pragma once
+
+#include <vk_types.h>
+#include <vk_mesh.h>
+#include <vk_streaming.h>
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class VulkanEngine;
+
+enum class Residency : uint8_t {
+	Evicted, //nothing in memory, the next use streams it back in
+	Loading, //requested from the streamer
+	Resident,
+	Failed   //the asset could not be loaded, it is never requested again
+};
+
+struct Texture {
+	Image image;
+	VkImageView imageView{ VK_NULL_HANDLE };
+};
+
+struct CacheEntry {
+	std::string asset;
+	StreamAssetType type;
+	Residency residency{ Residency::Evicted };
+	uint64_t lastUsedFrame{ 0 };
+	size_t gpuBytes{ 0 };
+};
+
+struct CachedMesh : CacheEntry {
+	Mesh mesh;
+};
+
+struct CachedTexture : CacheEntry {
+	Texture texture;
+	//bumped every time the texture becomes resident, descriptor sets written with an older one are stale
+	uint32_t version{ 0 };
+};
+
+//resident meshes and textures keep nothing on the cpu, the decoded data is dropped once it is uploaded, so
+//video memory is the only budget
+struct ResourceCacheSettings {
+	size_t gpuBudget{ size_t(1024) * 1024 * 1024 };
+
+	//resources used within this many frames are kept even over budget, never lower than the frames in flight
+	uint32_t minIdleFrames{ 120 };
+};
+
+struct ResourceCacheStats {
+	uint64_t hits{ 0 };
+	uint64_t misses{ 0 };
+	uint64_t evictions{ 0 };
+	size_t gpuBytes{ 0 };
+};
+
+//owns every streamed mesh and texture. entries are registered once by name and keep their address, the
+//resources behind them come and go: whatever has not been used for a while is evicted least recently used
+//first when the budget is exceeded, and streamed back in the next time something uses it
+class ResourceCache {
+public:
+	void init(VulkanEngine* engine, AssetStreamer* streamer, const ResourceCacheSettings& settings = {});
+
+	//destroys every resource, the gpu has to be idle
+	void cleanup();
+
+	//registers a resource, the first use requests it from the streamer
+	CachedMesh* add_mesh(const std::string& name, const std::string& asset);
+	CachedTexture* add_texture(const std::string& name, const std::string& asset);
+
+	CachedMesh* find_mesh(const std::string& name);
+	CachedTexture* find_texture(const std::string& name);
+
+	//marks the resource as used by the frame being recorded, true when it can be drawn with
+	bool use(CachedMesh* entry);
+	bool use(CachedTexture* entry);
+
+	//called once per frame before recording, evicts over budget and destroys what the gpu is done with
+	void update(uint64_t frameNumber);
+
+	const ResourceCacheStats& stats() const { return _stats; }
+
+private:
+	struct PendingDestroy {
+		uint64_t frame;
+		std::function<void()> destroy;
+	};
+
+	bool touch(CacheEntry& entry);
+	void request(CachedMesh* entry);
+	void request(CachedTexture* entry);
+
+	void make_resident(CacheEntry& entry, size_t gpuBytes);
+	void evict(CacheEntry& entry);
+	void evict_over_budget();
+
+	size_t allocation_size(VmaAllocation allocation) const;
+
+	VulkanEngine* _engine{ nullptr };
+	AssetStreamer* _streamer{ nullptr };
+	ResourceCacheSettings _settings;
+	ResourceCacheStats _stats;
+
+	uint64_t _frameNumber{ 0 };
+
+	//unique_ptr keeps the entries in place for the render objects and materials pointing at them
+	std::unordered_map<std::string, std::unique_ptr<CachedMesh>> _meshes;
+	std::unordered_map<std::string, std::unique_ptr<CachedTexture>> _textures;
+
+	//requests in flight, dropped from here once they are ready or failed
+	std::vector<std::pair<CacheEntry*, StreamHandle>> _loading;
+
+	//evicted resources wait here until the frames that could still read them have retired
+	std::deque<PendingDestroy> _pendingDestroys;
+};
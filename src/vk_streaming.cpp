@@ -0,0 +1,314 @@
+#include <vk_streaming.h>
+
+#include <vk_engine.h>
+
+#include <asset_loader.h>
+#include <asset_archive.h>
+#include <mesh_asset.h>
+
+#include <algorithm>
+#include <iostream>
+
+namespace {
+
+	//keeps a single frame from stalling on a huge level load, whatever does not fit goes in the next frames
+	constexpr VkDeviceSize MaxBatchBytes = 64 * 1024 * 1024;
+
+	//block compressed copies need offsets aligned to the 16 byte blocks
+	constexpr VkDeviceSize StagingAlignment = 16;
+
+	VkDeviceSize align_staging(VkDeviceSize size)
+	{
+		return (size + StagingAlignment - 1) & ~(StagingAlignment - 1);
+	}
+}
+
+void AssetStreamer::init(VulkanEngine* engine, uint32_t workerCount)
+{
+	_engine = engine;
+
+	//leave the render thread its own core
+	if (workerCount == 0)
+		workerCount = std::max(2u, std::thread::hardware_concurrency()) - 1;
+
+	//the job system counts the thread that waits on it, the streamer never waits until cleanup
+	_jobs = std::make_unique<assets::JobSystem>(workerCount + 1);
+}
+
+void AssetStreamer::cleanup()
+{
+	if (!_engine)
+		return;
+
+	//queued requests bail out as soon as a worker picks them up
+	_stopping = true;
+	_jobs->wait(_jobGroup);
+	_jobs.reset();
+
+	//resources of finished copies are handed over so they get destroyed with everything else
+	retire_batches(true);
+
+	for (StreamHandle& request : _decoded)
+		_engine->_uploader.release_staging(request->staging);
+	_decoded.clear();
+
+	_engine = nullptr;
+}
+
+StreamHandle AssetStreamer::request_mesh(const std::string& name, std::function<void(Mesh&)>&& onReady)
+{
+	StreamHandle request = std::make_shared<StreamRequest>();
+	request->name = name;
+	request->type = StreamAssetType::Mesh;
+	request->onMeshReady = std::move(onReady);
+	return enqueue(request);
+}
+
+StreamHandle AssetStreamer::request_texture(const std::string& name, std::function<void(Image&)>&& onReady)
+{
+	StreamHandle request = std::make_shared<StreamRequest>();
+	request->name = name;
+	request->type = StreamAssetType::Texture;
+	request->onTextureReady = std::move(onReady);
+	return enqueue(request);
+}
+
+StreamHandle AssetStreamer::enqueue(StreamHandle request)
+{
+	_pendingCount++;
+	_jobs->run(_jobGroup, [this, request]() {
+		decode_request(request);
+	});
+	return request;
+}
+
+bool AssetStreamer::find_asset(const std::string& name, assets::AssetView& outView, assets::MappedAssetFile& outFile, bool& outMapped)
+{
+	outMapped = false;
+
+	//the archive is mapped read only, every worker can look into it at the same time
+	const assets::AssetArchive& archive = _engine->_assetArchive;
+	const assets::ArchiveEntry* entry = archive.entries ? assets::find_entry(archive, name.c_str()) : nullptr;
+	if (entry && assets::read_entry(archive, entry, outView))
+		return true;
+
+	std::string path = std::string{ "../assets/assets_export/" } + name;
+	if (!assets::map_binaryfile(path.c_str(), outFile))
+		return false;
+
+	outView = outFile.view;
+	outMapped = true;
+	return true;
+}
+
+void AssetStreamer::decode_request(StreamHandle request)
+{
+	if (_stopping)
+	{
+		request->state = StreamState::Failed;
+		_pendingCount--;
+		return;
+	}
+
+	assets::AssetView view;
+	assets::MappedAssetFile file;
+	bool mapped = false;
+	bool found = find_asset(request->name, view, file, mapped);
+
+	bool decoded = false;
+	if (request->type == StreamAssetType::Mesh)
+	{
+		decoded = found && decode_mesh(*request, view);
+	}
+	else
+	{
+		decoded = decode_texture(*request, found ? &view : nullptr);
+	}
+
+	if (mapped)
+		assets::unmap_binaryfile(file);
+
+	if (!decoded)
+	{
+		std::cout << "Failed to stream " << request->name << std::endl;
+		request->state = StreamState::Failed;
+		_pendingCount--;
+		return;
+	}
+
+	request->state = StreamState::Decoded;
+
+	std::lock_guard<std::mutex> lock{ _decodedMutex };
+	_decoded.push_back(std::move(request));
+}
+
+bool AssetStreamer::decode_mesh(StreamRequest& request, const assets::AssetView& view)
+{
+	Mesh& mesh = request.mesh;
+	assets::MeshInfo info;
+	if (!mesh.load_header(view, info))
+		return false;
+
+	//the asset decodes right into the memory the gpu copies from, it never exists anywhere else on the cpu
+	const VkDeviceSize indexOffset = align_staging(mesh.vertexBufferSize);
+	UploadBatcher& uploader = _engine->_uploader;
+	request.staging = uploader.allocate_staging(indexOffset + mesh.indexBufferSize);
+
+	if (!mesh.decode(view, info, request.staging.data, request.staging.data + indexOffset))
+	{
+		uploader.release_staging(request.staging);
+		return false;
+	}
+	return true;
+}
+
+bool AssetStreamer::decode_texture(StreamRequest& request, const assets::AssetView* view)
+{
+	vkutil::TextureData& texture = request.texture;
+	UploadBatcher& uploader = _engine->_uploader;
+
+	//every level decodes straight into the staging memory
+	if (view && vkutil::read_texture_asset(*view, _engine->_textureCompressionBC, texture))
+	{
+		request.staging = uploader.allocate_staging(texture.info.textureSize);
+		if (vkutil::decode_texture_asset(*view, texture, request.staging.data))
+			return true;
+
+		uploader.release_staging(request.staging);
+	}
+
+	//assets have not been baked or use a format the gpu can not sample, use the source png without mips
+	std::string sourcePath = std::string{ "../assets/" } + request.name.substr(0, request.name.size() - 3) + ".png";
+	if (!vkutil::decode_texture_file(sourcePath.c_str(), texture))
+		return false;
+
+	request.staging = uploader.allocate_staging(texture.pixels.size());
+	memcpy(request.staging.data, texture.pixels.data(), texture.pixels.size());
+	texture.pixels = std::vector<char>{};
+	return true;
+}
+
+void AssetStreamer::update()
+{
+	retire_batches(false);
+	submit_batch();
+}
+
+void AssetStreamer::submit_batch()
+{
+	std::vector<StreamHandle> requests;
+	{
+		std::lock_guard<std::mutex> lock{ _decodedMutex };
+
+		VkDeviceSize batchSize = 0;
+		size_t taken = 0;
+		for (; taken < _decoded.size(); taken++)
+		{
+			VkDeviceSize size = _decoded[taken]->staging.size;
+			if (taken > 0 && batchSize + size > MaxBatchBytes)
+				break;
+
+			batchSize += size;
+		}
+
+		requests.assign(_decoded.begin(), _decoded.begin() + taken);
+		_decoded.erase(_decoded.begin(), _decoded.begin() + taken);
+	}
+
+	if (requests.empty())
+		return;
+
+	UploadBatcher& uploader = _engine->_uploader;
+	VkCommandBuffer cmd = uploader.command_buffer();
+
+	//every asset is already decoded into staging memory, all that is left is recording the copies
+	for (StreamHandle& request : requests)
+	{
+		StagingRegion& staging = request->staging;
+
+		if (request->type == StreamAssetType::Mesh)
+		{
+			Mesh& mesh = request->mesh;
+			GeometryPool& pool = _engine->_geometryPool;
+			mesh.geometry = pool.allocate(mesh.vertexCount, mesh.indexBufferCount, mesh.indexType);
+			if (!mesh.geometry)
+			{
+				std::cout << "No room for " << request->name << " in the geometry pool" << std::endl;
+				uploader.release_staging(staging);
+				request->state = StreamState::Failed;
+				_pendingCount--;
+				continue;
+			}
+
+			//the pool buffers can change on allocation, fetch them after it
+			VkBufferCopy copy;
+			copy.srcOffset = staging.offset;
+			copy.dstOffset = VkDeviceSize(mesh.geometry->vertexOffset) * sizeof(Vertex);
+			copy.size = mesh.vertexBufferSize;
+			vkCmdCopyBuffer(cmd, staging.buffer, pool.vertex_buffer(), 1, &copy);
+
+			copy.srcOffset = staging.offset + align_staging(mesh.vertexBufferSize);
+			copy.dstOffset = VkDeviceSize(mesh.geometry->indexOffset) * (mesh.indexType == VK_INDEX_TYPE_UINT16 ? 2 : 4);
+			copy.size = mesh.indexBufferSize;
+			vkCmdCopyBuffer(cmd, staging.buffer, pool.index_buffer(mesh.indexType), 1, &copy);
+		}
+		else
+		{
+			vkutil::TextureData& texture = request->texture;
+
+			if (!vkutil::create_texture_image(*_engine, texture, request->image))
+			{
+				std::cout << "Failed to create the image of " << request->name << std::endl;
+				uploader.release_staging(staging);
+				request->state = StreamState::Failed;
+				_pendingCount--;
+				continue;
+			}
+			vkutil::record_texture_upload(uploader, staging, request->image, texture);
+		}
+
+		uploader.release_after_batch(staging);
+		request->state = StreamState::Uploading;
+	}
+
+	//requests that found no room or no image failed above, there is nothing left of them to retire
+	requests.erase(std::remove_if(requests.begin(), requests.end(), [](const StreamHandle& request) {
+		return request->state == StreamState::Failed;
+	}), requests.end());
+
+	//no wait here, the batch is polled by the next frames
+	UploadBatch batch;
+	batch.value = uploader.submit();
+	batch.requests = std::move(requests);
+	_batches.push_back(std::move(batch));
+}
+
+void AssetStreamer::retire_batches(bool wait)
+{
+	UploadBatcher& uploader = _engine->_uploader;
+	if (wait)
+		uploader.wait(uploader.submitted());
+
+	//batches complete in submission order, the first one still in flight ends the search
+	size_t retired = 0;
+	for (; retired < _batches.size(); retired++)
+	{
+		UploadBatch& batch = _batches[retired];
+		if (batch.value > uploader.completed())
+			break;
+
+		for (StreamHandle& request : batch.requests)
+		{
+			request->state = StreamState::Ready;
+
+			if (request->type == StreamAssetType::Mesh && request->onMeshReady)
+				request->onMeshReady(request->mesh);
+			else if (request->type == StreamAssetType::Texture && request->onTextureReady)
+				request->onTextureReady(request->image);
+
+			_pendingCount--;
+		}
+	}
+
+	_batches.erase(_batches.begin(), _batches.begin() + retired);
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include <vk_types.h>
+#include <vk_mesh.h>
+#include <vk_textures.h>
+#include <vk_upload.h>
+#include <job_system.h>
+#include <asset_loader.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+class VulkanEngine;
+
+enum class StreamState : uint8_t {
+	Queued,    //waiting for an io worker
+	Decoded,   //on the cpu, waiting for the next upload batch
+	Uploading, //copy submitted, waiting for its fence
+	Ready,     //published to the renderer
+	Failed
+};
+
+enum class StreamAssetType : uint8_t {
+	Mesh,
+	Texture
+};
+
+struct StreamRequest {
+	std::string name;
+	StreamAssetType type;
+	std::atomic<StreamState> state{ StreamState::Queued };
+
+	//cpu data, filled by the worker that reads and decodes the asset
+	Mesh mesh;
+	vkutil::TextureData texture;
+
+	//staging memory the worker decodes into, released with the upload batch that copies it
+	StagingRegion staging;
+
+	//gpu side, valid once the request is ready
+	Image image;
+
+	//run on the render thread at the frame boundary where the asset becomes usable
+	std::function<void(Mesh&)> onMeshReady;
+	std::function<void(Image&)> onTextureReady;
+};
+
+//shared with the streamer, it can be polled like a future
+using StreamHandle = std::shared_ptr<StreamRequest>;
+
+//loads assets in the background. io workers read and decode the asset files straight into the staging ring
+//of the upload batcher, the render thread records the copies of the decoded ones into one upload batch per
+//frame and publishes them once the batch completed, so neither side ever waits on the other
+class AssetStreamer {
+public:
+	void init(VulkanEngine* engine, uint32_t workerCount = 0);
+
+	//waits for every request in flight, the gpu has to be idle
+	void cleanup();
+
+	StreamHandle request_mesh(const std::string& name, std::function<void(Mesh&)>&& onReady);
+
+	StreamHandle request_texture(const std::string& name, std::function<void(Image&)>&& onReady);
+
+	//called once per frame from the render thread, publishes finished uploads and submits the next batch
+	void update();
+
+	//requests that are not ready or failed yet
+	uint32_t pending_count() const { return _pendingCount; }
+
+private:
+	struct UploadBatch {
+		//value of the upload batch the copies went in
+		uint64_t value;
+		std::vector<StreamHandle> requests;
+	};
+
+	StreamHandle enqueue(StreamHandle request);
+
+	//worker side
+	void decode_request(StreamHandle request);
+	bool decode_mesh(StreamRequest& request, const assets::AssetView& view);
+	bool decode_texture(StreamRequest& request, const assets::AssetView* view);
+	bool find_asset(const std::string& name, assets::AssetView& outView, assets::MappedAssetFile& outFile, bool& outMapped);
+
+	//render thread side
+	void submit_batch();
+	void retire_batches(bool wait);
+
+	VulkanEngine* _engine{ nullptr };
+	std::unique_ptr<assets::JobSystem> _jobs;
+	assets::JobGroup _jobGroup;
+
+	std::mutex _decodedMutex;
+	std::vector<StreamHandle> _decoded;
+
+	std::vector<UploadBatch> _batches;
+
+	std::atomic<uint32_t> _pendingCount{ 0 };
+	std::atomic<bool> _stopping{ false };
+};
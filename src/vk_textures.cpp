@@ -1,116 +1,150 @@
 #include <vk_textures.h>
 #include <iostream>
 
+#include <vk_engine.h>
 #include <vk_initializers.h>
+#include <asset_loader.h>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
-bool vkutil::load_image_from_file(VulkanEngine& engine, const char* file, Image& outImage)
-{
-  int texWidth, texHeight, texChannels;
-	stbi_uc* pixels = stbi_load(file, &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-	if (!pixels) {
-		std::cout << "Failed to load texture file " << file << std::endl;
-		return false;
+namespace {
+
+	VkFormat texture_vk_format(assets::TextureFormat format)
+	{
+		switch (format)
+		{
+			case assets::TextureFormat::RGBA8:
+				return VK_FORMAT_R8G8B8A8_SRGB;
+			case assets::TextureFormat::BC1:
+				return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+			case assets::TextureFormat::BC3:
+				return VK_FORMAT_BC3_SRGB_BLOCK;
+			case assets::TextureFormat::BC7:
+				return VK_FORMAT_BC7_SRGB_BLOCK;
+			default:
+				return VK_FORMAT_UNDEFINED;
+		}
 	}
+}
 
+bool vkutil::read_texture_asset(const assets::AssetView& asset, bool blockCompressionSupported, TextureData& outTexture)
+{
+	outTexture.info = assets::read_texture_info(asset);
+	outTexture.format = texture_vk_format(outTexture.info.textureFormat);
 
+	bool supported = outTexture.format != VK_FORMAT_UNDEFINED
+		&& (blockCompressionSupported || !assets::is_block_compressed(outTexture.info.textureFormat));
 
+	if (!supported || outTexture.info.levelCount == 0)
+	{
+		std::cout << "Unsupported texture asset " << outTexture.info.originalFile << std::endl;
+		return false;
+	}
+	return true;
+}
 
+bool vkutil::decode_texture_asset(const assets::AssetView& asset, TextureData& texture, char* destination)
+{
+	if (!assets::unpack_texture(&texture.info, asset.binaryBlob, asset.blobSize, destination))
+	{
+		std::cout << "Failed to decode texture " << texture.info.originalFile << std::endl;
+		return false;
+	}
+	return true;
+}
 
-  void* pixel_ptr = pixels;
-  VkDeviceSize imageSize = texWidth * texHeight * 4;
-  //the format R8G8B8A8 matches exactly with the pixels loaded from stb_image lib
-  VkFormat image_format = VK_FORMAT_R8G8B8A8_SRGB;
-  //allocate temporary buffer for holding texture data to upload
-  Buffer stagingBuffer = engine.create_buffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+bool vkutil::decode_texture_file(const char* file, TextureData& outTexture)
+{
+	int texWidth, texHeight, texChannels;
+	stbi_uc* pixels = stbi_load(file, &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
+	if (!pixels) {
+		std::cout << "Failed to load texture file " << file << std::endl;
+		return false;
+	}
 
-  //copy data to buffer
-  void* data;
-  vmaMapMemory(engine._allocator, stagingBuffer.allocation, &data);
-  memcpy(data, pixel_ptr, static_cast<size_t>(imageSize));
-  vmaUnmapMemory(engine._allocator, stagingBuffer.allocation);
-  //we no longer need the loaded data, so we can free the pixels as they are now in the staging buffer
-  stbi_image_free(pixels);
+	//the format R8G8B8A8 matches exactly with the pixels loaded from stb_image lib
+	outTexture.info = {};
+	outTexture.info.textureFormat = assets::TextureFormat::RGBA8;
+	outTexture.info.pixelsize[0] = uint32_t(texWidth);
+	outTexture.info.pixelsize[1] = uint32_t(texHeight);
+	outTexture.info.textureSize = uint64_t(texWidth) * texHeight * 4;
+	outTexture.info.originalFile = file;
+	outTexture.info.levelCount = 1;
+	outTexture.info.levels[0].width = uint32_t(texWidth);
+	outTexture.info.levels[0].height = uint32_t(texHeight);
+	outTexture.info.levels[0].offset = 0;
+	outTexture.info.levels[0].size = outTexture.info.textureSize;
+	outTexture.format = VK_FORMAT_R8G8B8A8_SRGB;
+
+	outTexture.pixels.assign((const char*)pixels, (const char*)pixels + outTexture.info.textureSize);
+	stbi_image_free(pixels);
+	return true;
+}
 
-  VkExtent3D imageExtent;
-	imageExtent.width = static_cast<uint32_t>(texWidth);
-	imageExtent.height = static_cast<uint32_t>(texHeight);
+bool vkutil::create_texture_image(VulkanEngine& engine, const TextureData& texture, Image& outImage)
+{
+	VkExtent3D imageExtent;
+	imageExtent.width = texture.info.levels[0].width;
+	imageExtent.height = texture.info.levels[0].height;
 	imageExtent.depth = 1;
 
-	VkImageCreateInfo dimg_info = vkinit::image_create_info(image_format, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, imageExtent);
+	VkImageCreateInfo dimg_info = vkinit::image_create_info(texture.format, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT, imageExtent);
+	dimg_info.mipLevels = texture.info.levelCount;
 
-	Image newImage;
+	outImage.mipLevels = texture.info.levelCount;
+	outImage.format = texture.format;
 
 	VmaAllocationCreateInfo dimg_allocinfo = {};
 	dimg_allocinfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
 
-	//allocate and create the image
-	vmaCreateImage(engine._allocator, &dimg_info, &dimg_allocinfo, &newImage.vkimage, &newImage.allocation, nullptr);
-
-  engine.immediate_submit([&](VkCommandBuffer cmd) {
-		VkImageSubresourceRange range;
-		range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		range.baseMipLevel = 0;
-		range.levelCount = 1;
-		range.baseArrayLayer = 0;
-		range.layerCount = 1;
-
-		VkImageMemoryBarrier imageBarrier_toTransfer = {};
-		imageBarrier_toTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-
-		imageBarrier_toTransfer.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		imageBarrier_toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-		imageBarrier_toTransfer.image = newImage.vkimage;
-		imageBarrier_toTransfer.subresourceRange = range;
-
-		imageBarrier_toTransfer.srcAccessMask = 0;
-		imageBarrier_toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-		//barrier the image into the transfer-receive layout
-		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier_toTransfer);
-
-    VkBufferImageCopy copyRegion = {};
-	copyRegion.bufferOffset = 0;
-	copyRegion.bufferRowLength = 0;
-	copyRegion.bufferImageHeight = 0;
-
-	copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	copyRegion.imageSubresource.mipLevel = 0;
-	copyRegion.imageSubresource.baseArrayLayer = 0;
-	copyRegion.imageSubresource.layerCount = 1;
-	copyRegion.imageExtent = imageExtent;
-
-	//copy the buffer into the image
-	vkCmdCopyBufferToImage(cmd, stagingBuffer.vkbuffer, newImage.vkimage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
-
-  VkImageMemoryBarrier imageBarrier_toReadable = imageBarrier_toTransfer;
-
-	imageBarrier_toReadable.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-	imageBarrier_toReadable.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-
-	imageBarrier_toReadable.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-	imageBarrier_toReadable.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	return vmaCreateImage(engine._allocator, &dimg_info, &dimg_allocinfo, &outImage.vkimage, &outImage.allocation, nullptr) == VK_SUCCESS;
+}
 
-	//barrier the image into the shader readable layout
-	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier_toReadable);
-});
+void vkutil::record_texture_upload(UploadBatcher& uploader, const StagingRegion& staging, const Image& image, const TextureData& texture)
+{
+	VkCommandBuffer cmd = uploader.command_buffer();
+
+	//one region per level, all of them copied in a single command
+	std::vector<VkBufferImageCopy> copyRegions(texture.info.levelCount);
+	for (uint32_t i = 0; i < texture.info.levelCount; i++)
+	{
+		VkBufferImageCopy& copyRegion = copyRegions[i];
+		copyRegion = {};
+		copyRegion.bufferOffset = staging.offset + texture.info.levels[i].offset;
+		copyRegion.bufferRowLength = 0;
+		copyRegion.bufferImageHeight = 0;
+
+		copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		copyRegion.imageSubresource.mipLevel = i;
+		copyRegion.imageSubresource.baseArrayLayer = 0;
+		copyRegion.imageSubresource.layerCount = 1;
+		copyRegion.imageExtent = { texture.info.levels[i].width, texture.info.levels[i].height, 1 };
+	}
 
-engine.immediate_submit([&](VkCommandBuffer cmd) {
-      //transitions and copy commands
-  });
+	VkImageSubresourceRange range;
+	range.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	range.baseMipLevel = 0;
+	range.levelCount = image.mipLevels;
+	range.baseArrayLayer = 0;
+	range.layerCount = 1;
 
+	VkImageMemoryBarrier imageBarrier_toTransfer = {};
+	imageBarrier_toTransfer.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 
-  engine._mainDeletionQueue.push([=]() {
+	imageBarrier_toTransfer.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	imageBarrier_toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	imageBarrier_toTransfer.image = image.vkimage;
+	imageBarrier_toTransfer.subresourceRange = range;
 
-  vmaDestroyImage(engine._allocator, newImage.vkimage, newImage.allocation);
-});
+	imageBarrier_toTransfer.srcAccessMask = 0;
+	imageBarrier_toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
 
-vmaDestroyBuffer(engine._allocator, stagingBuffer.vkbuffer, stagingBuffer.allocation);
+	//barrier the image into the transfer-receive layout
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &imageBarrier_toTransfer);
 
-std::cout << "Texture loaded succesfully " << file << std::endl;
+	vkCmdCopyBufferToImage(cmd, staging.buffer, image.vkimage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, uint32_t(copyRegions.size()), copyRegions.data());
 
-outImage = newImage;
-return true;
+	//into the shader readable layout, and over to the graphics queue when the batch runs on another one
+	uploader.release_image(image.vkimage, range, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 }
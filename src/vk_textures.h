@@ -1,10 +1,37 @@
 #pragma once
 
 #include <vk_types.h>
-#include <vk_engine.h>
+#include <texture_asset.h>
+
+#include <vector>
+
+class VulkanEngine;
+class UploadBatcher;
+struct StagingRegion;
+namespace assets { struct AssetView; }
 
 namespace vkutil {
 
-	bool load_image_from_file(VulkanEngine& engine, const char* file, Image& outImage);
+	//cpu side of a texture, decoded away from the render thread and uploaded later
+	struct TextureData {
+		assets::TextureInfo info;
+		VkFormat format{ VK_FORMAT_UNDEFINED };
+		std::vector<char> pixels;
+	};
+
+	//format and level layout of a baked texture without touching the pixels, fails on formats the gpu can not sample
+	bool read_texture_asset(const assets::AssetView& asset, bool blockCompressionSupported, TextureData& outTexture);
+
+	//decodes every mip level of a texture read with read_texture_asset into destination, info.textureSize bytes
+	bool decode_texture_asset(const assets::AssetView& asset, TextureData& texture, char* destination);
+
+	//source image with a single level, used when the assets have not been baked
+	bool decode_texture_file(const char* file, TextureData& outTexture);
+
+	bool create_texture_image(VulkanEngine& engine, const TextureData& texture, Image& outImage);
+
+	//records the copies of every level out of the staging region into the open batch, the image is ready to be
+	//sampled by the graphics queue once the batch completed
+	void record_texture_upload(UploadBatcher& uploader, const StagingRegion& staging, const Image& image, const TextureData& texture);
 
 }
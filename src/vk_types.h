@@ -11,11 +11,13 @@ do { \
 } while(0);
 
 struct Buffer {
-	VkBuffer vkbuffer;
-	VmaAllocation allocation;
+	VkBuffer vkbuffer{ VK_NULL_HANDLE };
+	VmaAllocation allocation{ VK_NULL_HANDLE };
 };
 
 struct Image {
-	VkImage vkimage;
-	VmaAllocation allocation;
+	VkImage vkimage{ VK_NULL_HANDLE };
+	VmaAllocation allocation{ VK_NULL_HANDLE };
+	uint32_t mipLevels{ 1 };
+	VkFormat format{ VK_FORMAT_R8G8B8A8_SRGB };
 };
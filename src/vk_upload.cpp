@@ -0,0 +1,361 @@
+#include <vk_upload.h>
+
+#include <vk_engine.h>
+#include <vk_initializers.h>
+
+#include <algorithm>
+
+namespace {
+
+	//block compressed copies need offsets aligned to the 16 byte blocks
+	constexpr VkDeviceSize StagingAlignment = 16;
+
+	VkDeviceSize align_staging(VkDeviceSize size)
+	{
+		return (size + StagingAlignment - 1) & ~(StagingAlignment - 1);
+	}
+}
+
+void UploadBatcher::init(VulkanEngine* engine, VkDeviceSize ringSize)
+{
+	_engine = engine;
+
+	//the engine only picks a transfer queue when it has timeline semaphores to wait on it
+	_queue = _engine->_transfer_queue;
+	_familyIndex = _engine->_transfer_family_index;
+	_dedicatedQueue = _familyIndex != _engine->_graphics_family_index;
+
+	VkCommandPoolCreateInfo poolInfo = vkinit::command_pool_create_info(_familyIndex, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+	VK_CHECK(vkCreateCommandPool(_engine->_logical_device, &poolInfo, nullptr, &_commandPool));
+
+	if (_engine->_timelineSemaphores)
+	{
+		VkSemaphoreTypeCreateInfo typeInfo = {};
+		typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+		typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+		typeInfo.initialValue = 0;
+
+		VkSemaphoreCreateInfo semaphoreInfo = {};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		semaphoreInfo.pNext = &typeInfo;
+		VK_CHECK(vkCreateSemaphore(_engine->_logical_device, &semaphoreInfo, nullptr, &_timeline));
+	}
+
+	_ringSize = align_staging(ringSize);
+	_ring = _engine->create_staging_buffer(_ringSize, (void**)&_ringData);
+}
+
+void UploadBatcher::cleanup()
+{
+	if (!_engine)
+		return;
+
+	wait(submit());
+
+	VkDevice device = _engine->_logical_device;
+	for (Batch& batch : _free)
+		vkDestroyFence(device, batch.fence, nullptr);
+	_free.clear();
+	_acquires.clear();
+
+	vkDestroySemaphore(device, _timeline, nullptr);
+	vkDestroyCommandPool(device, _commandPool, nullptr);
+	vmaDestroyBuffer(_engine->_allocator, _ring.vkbuffer, _ring.allocation);
+
+	_spans.clear();
+	_engine = nullptr;
+}
+
+StagingRegion UploadBatcher::allocate_staging(VkDeviceSize size)
+{
+	StagingRegion region;
+	region.size = size;
+
+	{
+		std::lock_guard<std::mutex> lock{ _ringMutex };
+		if (allocate_ring(size, region))
+			return region;
+	}
+
+	//bigger than what is left in the ring, it gets a buffer of its own instead of waiting for room
+	region.dedicated = _engine->create_staging_buffer(size, (void**)&region.data);
+	region.buffer = region.dedicated.vkbuffer;
+	region.offset = 0;
+	return region;
+}
+
+bool UploadBatcher::allocate_ring(VkDeviceSize size, StagingRegion& region)
+{
+	const VkDeviceSize alignedSize = align_staging(size);
+	if (alignedSize > _ringSize)
+		return false;
+
+	//a region never wraps, the end of the buffer is skipped instead
+	uint64_t start = _ringHead;
+	VkDeviceSize offset = start % _ringSize;
+	if (offset + alignedSize > _ringSize)
+	{
+		start += _ringSize - offset;
+		offset = 0;
+	}
+
+	if (start + alignedSize - _ringTail > _ringSize)
+		return false;
+
+	//the skipped end belongs to the span so it is given back with it
+	_spans.push_back({ _ringHead, start + alignedSize, false });
+	region.ringStart = _ringHead;
+	_ringHead = start + alignedSize;
+
+	region.buffer = _ring.vkbuffer;
+	region.offset = offset;
+	region.data = _ringData + offset;
+	return true;
+}
+
+void UploadBatcher::release_staging(StagingRegion& region)
+{
+	if (!region.valid())
+		return;
+
+	if (region.dedicated.vkbuffer != VK_NULL_HANDLE)
+	{
+		vmaDestroyBuffer(_engine->_allocator, region.dedicated.vkbuffer, region.dedicated.allocation);
+	}
+	else
+	{
+		std::lock_guard<std::mutex> lock{ _ringMutex };
+
+		auto span = std::lower_bound(_spans.begin(), _spans.end(), region.ringStart, [](const RingSpan& span, uint64_t start) {
+			return span.start < start;
+		});
+		if (span != _spans.end() && span->start == region.ringStart)
+			span->released = true;
+
+		//regions are released out of order, the tail only moves over the ones released without a gap
+		while (!_spans.empty() && _spans.front().released)
+		{
+			_ringTail = _spans.front().end;
+			_spans.pop_front();
+		}
+	}
+
+	region = StagingRegion{};
+}
+
+VkCommandBuffer UploadBatcher::command_buffer()
+{
+	if (_open.commandBuffer != VK_NULL_HANDLE)
+		return _open.commandBuffer;
+
+	VkDevice device = _engine->_logical_device;
+
+	if (!_free.empty())
+	{
+		_open = std::move(_free.back());
+		_free.pop_back();
+	}
+	else
+	{
+		VkCommandBufferAllocateInfo cmdAllocInfo = vkinit::command_buffer_allocate_info(_commandPool, 1);
+		VK_CHECK(vkAllocateCommandBuffers(device, &cmdAllocInfo, &_open.commandBuffer));
+
+		if (_timeline == VK_NULL_HANDLE)
+		{
+			VkFenceCreateInfo fenceInfo = {};
+			fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+			VK_CHECK(vkCreateFence(device, &fenceInfo, nullptr, &_open.fence));
+		}
+	}
+
+	VkCommandBufferBeginInfo cmdBeginInfo = {};
+	cmdBeginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	cmdBeginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	VK_CHECK(vkBeginCommandBuffer(_open.commandBuffer, &cmdBeginInfo));
+
+	return _open.commandBuffer;
+}
+
+void UploadBatcher::release_after_batch(StagingRegion& region)
+{
+	command_buffer();
+	_open.regions.push_back(region);
+	region = StagingRegion{};
+}
+
+void UploadBatcher::release_image(VkImage image, const VkImageSubresourceRange& range, VkImageLayout oldLayout, VkImageLayout newLayout)
+{
+	VkCommandBuffer cmd = command_buffer();
+
+	VkImageMemoryBarrier barrier = {};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = oldLayout;
+	barrier.newLayout = newLayout;
+	barrier.image = image;
+	barrier.subresourceRange = range;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+	if (!_dedicatedQueue)
+	{
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+		return;
+	}
+
+	//release half of the transfer, the layout change happens once and both halves have to describe it
+	barrier.srcQueueFamilyIndex = _familyIndex;
+	barrier.dstQueueFamilyIndex = _engine->_graphics_family_index;
+	barrier.dstAccessMask = 0;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	_acquires.push_back({ _submitted + 1, barrier });
+}
+
+uint64_t UploadBatcher::record_acquires(VkCommandBuffer cmd, bool waitForSubmitted)
+{
+	//on the graphics queue the batches are ahead of the frames in submit order, their barriers are enough
+	if (!_dedicatedQueue)
+		return 0;
+
+	//only the images of completed batches are taken over, nothing uses the others yet
+	std::vector<VkImageMemoryBarrier> barriers;
+	auto pending = std::remove_if(_acquires.begin(), _acquires.end(), [&](const ImageAcquire& acquire) {
+		if (acquire.value > _completed)
+			return false;
+
+		barriers.push_back(acquire.barrier);
+		return true;
+	});
+	_acquires.erase(pending, _acquires.end());
+
+	if (!barriers.empty())
+	{
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			0, 0, nullptr, 0, nullptr, uint32_t(barriers.size()), barriers.data());
+	}
+
+	//waiting on the completed value never stalls, it only orders the frame after the copies it reads
+	uint64_t value = waitForSubmitted ? _submitted : _completed;
+	if (value <= _graphicsWaited)
+		return 0;
+
+	_graphicsWaited = value;
+	return value;
+}
+
+uint64_t UploadBatcher::submit()
+{
+	if (_open.commandBuffer == VK_NULL_HANDLE)
+		return _submitted;
+
+	//make the copied buffers visible to everything submitted after the batch, images bring their own barriers.
+	//on the transfer queue the timeline semaphore the frames wait on does the same
+	if (!_dedicatedQueue)
+	{
+		VkMemoryBarrier barrier = {};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_UNIFORM_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(_open.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
+	VK_CHECK(vkEndCommandBuffer(_open.commandBuffer));
+
+	_open.value = ++_submitted;
+
+	VkSubmitInfo submit = {};
+	submit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit.commandBufferCount = 1;
+	submit.pCommandBuffers = &_open.commandBuffer;
+
+	VkTimelineSemaphoreSubmitInfo timelineInfo = {};
+	if (_timeline != VK_NULL_HANDLE)
+	{
+		timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timelineInfo.signalSemaphoreValueCount = 1;
+		timelineInfo.pSignalSemaphoreValues = &_open.value;
+
+		submit.pNext = &timelineInfo;
+		submit.signalSemaphoreCount = 1;
+		submit.pSignalSemaphores = &_timeline;
+	}
+
+	//no wait here, the timeline or the fence is polled by the next frames
+	VK_CHECK(vkQueueSubmit(_queue, 1, &submit, _open.fence));
+
+	_inFlight.push_back(std::move(_open));
+	_open = Batch{};
+
+	return _submitted;
+}
+
+void UploadBatcher::update()
+{
+	//batches complete in submit order, the first one still running stops the walk
+	while (!_inFlight.empty() && batch_done(_inFlight.front(), false))
+	{
+		retire(_inFlight.front());
+		_inFlight.pop_front();
+	}
+}
+
+void UploadBatcher::wait(uint64_t value)
+{
+	while (_completed < value && !_inFlight.empty())
+	{
+		batch_done(_inFlight.front(), true);
+		retire(_inFlight.front());
+		_inFlight.pop_front();
+	}
+}
+
+bool UploadBatcher::batch_done(const Batch& batch, bool wait)
+{
+	VkDevice device = _engine->_logical_device;
+
+	if (_timeline == VK_NULL_HANDLE)
+	{
+		if (!wait)
+			return vkGetFenceStatus(device, batch.fence) == VK_SUCCESS;
+
+		VK_CHECK(vkWaitForFences(device, 1, &batch.fence, true, UINT64_MAX));
+		return true;
+	}
+
+	if (!wait)
+	{
+		uint64_t value = 0;
+		VK_CHECK(vkGetSemaphoreCounterValue(device, _timeline, &value));
+		return value >= batch.value;
+	}
+
+	VkSemaphoreWaitInfo waitInfo = {};
+	waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &_timeline;
+	waitInfo.pValues = &batch.value;
+	VK_CHECK(vkWaitSemaphores(device, &waitInfo, UINT64_MAX));
+	return true;
+}
+
+void UploadBatcher::retire(Batch& batch)
+{
+	for (StagingRegion& region : batch.regions)
+		release_staging(region);
+	batch.regions.clear();
+
+	_completed = batch.value;
+
+	if (batch.fence != VK_NULL_HANDLE)
+	{
+		VK_CHECK(vkResetFences(_engine->_logical_device, 1, &batch.fence));
+	}
+	VK_CHECK(vkResetCommandBuffer(batch.commandBuffer, 0));
+	_free.push_back(std::move(batch));
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <vk_types.h>
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+class VulkanEngine;
+
+//cpu written memory a batch copies from. most come out of the staging ring, the ones that do not fit get a
+//buffer of their own
+struct StagingRegion {
+	VkBuffer buffer{ VK_NULL_HANDLE };
+	VkDeviceSize offset{ 0 };
+	VkDeviceSize size{ 0 };
+	char* data{ nullptr };
+
+	//position in the ring, or a dedicated buffer
+	uint64_t ringStart{ 0 };
+	Buffer dedicated;
+
+	bool valid() const { return data != nullptr; }
+};
+
+//records buffer and image copies of many uploads into one command buffer and submits them together.
+//batches are numbered in submit order, nothing waits on the gpu: completed() tells how far the copies got, and
+//the staging memory of a batch is recycled once it has completed.
+//with a transfer only queue and timeline semaphores the batches run on that queue and signal their value on the
+//timeline, the frames wait on it and take over the images uploaded. otherwise they go to the graphics queue
+//with a fence each
+class UploadBatcher {
+public:
+	void init(VulkanEngine* engine, VkDeviceSize ringSize = VkDeviceSize(128) * 1024 * 1024);
+
+	//waits for every batch, then destroys everything
+	void cleanup();
+
+	//safe to call from any thread. the region stays valid until release_staging or until the batch it was
+	//handed to with release_after_batch completed
+	StagingRegion allocate_staging(VkDeviceSize size);
+	void release_staging(StagingRegion& region);
+
+	//render thread side. the open batch is begun on first use
+	VkCommandBuffer command_buffer();
+	void release_after_batch(StagingRegion& region);
+
+	//submits the open batch, if any, and returns the value completed() reaches once its copies are done
+	uint64_t submit();
+
+	//hands an image the open batch wrote to the graphics queue in newLayout, through a queue family ownership
+	//transfer when the batch runs on the transfer queue
+	void release_image(VkImage image, const VkImageSubresourceRange& range, VkImageLayout oldLayout, VkImageLayout newLayout);
+
+	//records the graphics queue side of the ownership transfers of the completed batches. returns the timeline
+	//value the submit of cmd has to wait on, 0 when it has nothing new to wait for. waitForSubmitted is for frames
+	//that overwrite what batches may still be copying into
+	uint64_t record_acquires(VkCommandBuffer cmd, bool waitForSubmitted);
+	VkSemaphore timeline() const { return _timeline; }
+
+	//polls the batches in flight, recycles what they used. called once per frame
+	void update();
+
+	uint64_t completed() const { return _completed; }
+	uint64_t submitted() const { return _submitted; }
+
+	//for the few loads that need their result right away, like the imgui fonts at startup
+	void wait(uint64_t value);
+
+private:
+	struct Batch {
+		uint64_t value{ 0 };
+		VkCommandBuffer commandBuffer{ VK_NULL_HANDLE };
+		VkFence fence{ VK_NULL_HANDLE };
+		std::vector<StagingRegion> regions;
+	};
+
+	struct ImageAcquire {
+		uint64_t value;
+		VkImageMemoryBarrier barrier;
+	};
+
+	struct RingSpan {
+		uint64_t start;
+		uint64_t end;
+		bool released;
+	};
+
+	bool allocate_ring(VkDeviceSize size, StagingRegion& region);
+	bool batch_done(const Batch& batch, bool wait);
+	void retire(Batch& batch);
+
+	VulkanEngine* _engine{ nullptr };
+
+	VkQueue _queue{ VK_NULL_HANDLE };
+	uint32_t _familyIndex{ 0 };
+	bool _dedicatedQueue{ false };
+	VkCommandPool _commandPool{ VK_NULL_HANDLE };
+	//signaled with the value of every batch, fences are only used without it
+	VkSemaphore _timeline{ VK_NULL_HANDLE };
+
+	//images released by the batches that the graphics queue still has to acquire
+	std::vector<ImageAcquire> _acquires;
+	uint64_t _graphicsWaited{ 0 };
+
+	Batch _open;
+	std::deque<Batch> _inFlight;
+	//command buffers and fences of completed batches, reused by the next ones
+	std::vector<Batch> _free;
+
+	uint64_t _submitted{ 0 };
+	uint64_t _completed{ 0 };
+
+	//persistently mapped ring, positions only grow and wrap around the buffer size
+	std::mutex _ringMutex;
+	Buffer _ring;
+	char* _ringData{ nullptr };
+	VkDeviceSize _ringSize{ 0 };
+	uint64_t _ringHead{ 0 };
+	uint64_t _ringTail{ 0 };
+	//allocations in ring order, the tail moves past them once they and everything before are released
+	std::deque<RingSpan> _spans;
+};